@@ -1,5 +1,7 @@
-#pragma once
-
-const int WINDOW_W = 400;
-const int WINDOW_H = 120;
-const int FONT_HEIGHT = 14;
\ No newline at end of file
+#pragma once
+
+const int WINDOW_W = 400;
+const int WINDOW_H = 120;
+const int FONT_HEIGHT = 14;
+// number of samples visible in a chart
+const int DISPLAY_COUNT = WINDOW_W / 2;
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include "device_inventory.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    const char kInventoryMagic[8] = { 'G', 'P', 'U', 'I', 'N', 'V', 'T', 'Y' };
+    // bump when DeviceInventory changes, an old file is then ignored
+    const uint32_t kInventoryVersion = 1;
+
+    vector<DeviceInventory> entries;
+    bool isDirty = false;
+}
+
+bool loadDeviceInventory(const char* path)
+{
+    entries.clear();
+    isDirty = false;
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return false;
+
+    char magic[sizeof(kInventoryMagic)];
+    uint32_t header[3] = {};
+    bool isValid = fread(magic, sizeof(magic), 1, file) == 1 && memcmp(magic, kInventoryMagic, sizeof(magic)) == 0
+        && fread(header, sizeof(header), 1, file) == 1
+        && header[0] == kInventoryVersion && header[1] == sizeof(DeviceInventory);
+    if (isValid)
+    {
+        entries.resize(header[2]);
+        isValid = entries.empty() || fread(entries.data(), sizeof(DeviceInventory), entries.size(), file) == entries.size();
+    }
+    fclose(file);
+
+    if (!isValid)
+    {
+        fprintf(stderr, "[loadDeviceInventory] - %s is stale or damaged, ignored\r\n", path);
+        entries.clear();
+        return false;
+    }
+    for (auto& entry : entries)
+    {
+        // the keys are compared as strings
+        entry.driverVersion[sizeof(entry.driverVersion) - 1] = '\0';
+        entry.busId[sizeof(entry.busId) - 1] = '\0';
+        entry.name[sizeof(entry.name) - 1] = '\0';
+        if (entry.numLinks > NVML_NVLINK_MAX_LINKS)
+            entry.numLinks = NVML_NVLINK_MAX_LINKS;
+    }
+    return true;
+}
+
+bool findDeviceInventory(const char* driverVersion, const char* busId, DeviceInventory* inventory)
+{
+    for (const auto& entry : entries)
+    {
+        if (strcmp(entry.driverVersion, driverVersion) == 0 && strcmp(entry.busId, busId) == 0)
+        {
+            *inventory = entry;
+            return true;
+        }
+    }
+    return false;
+}
+
+void storeDeviceInventory(const DeviceInventory& inventory)
+{
+    isDirty = true;
+    for (auto& entry : entries)
+    {
+        if (strcmp(entry.busId, inventory.busId) == 0)
+        {
+            entry = inventory;
+            return;
+        }
+    }
+    entries.push_back(inventory);
+}
+
+bool saveDeviceInventory(const char* path, const char* driverVersion)
+{
+    if (!isDirty)
+        return true;
+
+    vector<DeviceInventory> current;
+    for (const auto& entry : entries)
+    {
+        if (strcmp(entry.driverVersion, driverVersion) == 0)
+            current.push_back(entry);
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (!file)
+    {
+        fprintf(stderr, "[saveDeviceInventory] - can't open %s\r\n", path);
+        return false;
+    }
+    uint32_t header[3] = { kInventoryVersion, (uint32_t)sizeof(DeviceInventory), (uint32_t)current.size() };
+    bool isWritten = fwrite(kInventoryMagic, sizeof(kInventoryMagic), 1, file) == 1
+        && fwrite(header, sizeof(header), 1, file) == 1
+        && (current.empty() || fwrite(current.data(), sizeof(DeviceInventory), current.size(), file) == current.size());
+    isWritten &= fclose(file) == 0;
+    if (!isWritten)
+    {
+        fprintf(stderr, "[saveDeviceInventory] - can't write %s\r\n", path);
+        // a short file would be rejected by the next load anyway
+        remove(path);
+        return false;
+    }
+    isDirty = false;
+    return true;
+}
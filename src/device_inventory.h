@@ -0,0 +1,40 @@
+#pragma once
+
+#include "../3rdparty/CUDA_SDK/nvml.h"
+#include <stdint.h>
+
+// What NvidiaInfo::setup() asks the driver about a device that only changes with the driver
+// or the board, keyed by the driver version and the PCI bus id. Plain data, stored as is.
+struct DeviceInventory
+{
+    char driverVersion[NVML_SYSTEM_DRIVER_VERSION_BUFFER_SIZE];
+    char busId[NVML_DEVICE_PCI_BUS_ID_BUFFER_SIZE];
+
+    char name[NVML_DEVICE_NAME_BUFFER_SIZE];
+    nvmlBrandType_t brandType;
+    nvmlDeviceArchitecture_t deviceArch;
+    uint32_t numCores;
+    uint32_t busWidth;
+    uint32_t pcieLinkGeneration;
+    uint32_t pcieLinkWidth;
+    uint32_t maxSmClock;
+    uint32_t maxMemClock;
+    unsigned long long supportedThrottleReasons;
+    uint32_t numLinks;
+    uint32_t nvlinkMaxSpeeds[NVML_NVLINK_MAX_LINKS];
+    nvmlPciInfo_t nvlinkPciInfos[NVML_NVLINK_MAX_LINKS];
+};
+
+// The inventory of the previous run, lets a warm start skip the per device static queries.
+// Not thread safe, nvidia_setup() is the only user.
+bool loadDeviceInventory(const char* path);
+
+// false when the device wasn't seen under this driver
+bool findDeviceInventory(const char* driverVersion, const char* busId, DeviceInventory* inventory);
+
+// adds or replaces the entry of inventory.busId
+void storeDeviceInventory(const DeviceInventory& inventory);
+
+// Writes the entries of driverVersion back when one was stored since the load,
+// the ones of other drivers are dropped.
+bool saveDeviceInventory(const char* path, const char* driverVersion);
@@ -1,7 +1,9 @@
-#pragma once
-
-int etw_setup();
-int etw_update();
-int etw_draw(bool show_legends);
-int etw_draw_imgui();
-int etw_cleanup();
+#pragma once
+
+int etw_setup();
+// Starts the trace session, can take a while, meant for the collector thread.
+int etw_start();
+int etw_update();
+int etw_draw(bool show_legends);
+int etw_draw_imgui();
+int etw_cleanup();
@@ -0,0 +1,56 @@
+#include "event_track.h"
+#include <algorithm>
+
+using namespace std;
+
+void EventTrack::add(int64_t timeMs, int severity, const string& text)
+{
+    lock_guard<mutex> guard(lock);
+    if (events.size() >= CAPACITY)
+        events.pop_front();
+    // events can be reported slightly out of order by different threads
+    auto it = upper_bound(events.begin(), events.end(), timeMs,
+        [](int64_t t, const TrackEvent& e) { return t < e.timeMs; });
+    TrackEvent event;
+    event.timeMs = timeMs;
+    event.severity = severity;
+    event.text = text;
+    events.insert(it, move(event));
+}
+
+void EventTrack::query(int64_t beginMs, int64_t endMs, vector<TrackEvent>* out) const
+{
+    out->clear();
+    lock_guard<mutex> guard(lock);
+    auto it = lower_bound(events.begin(), events.end(), beginMs,
+        [](const TrackEvent& e, int64_t t) { return e.timeMs < t; });
+    for (; it != events.end() && it->timeMs <= endMs; ++it)
+        out->push_back(*it);
+}
+
+size_t EventTrack::size() const
+{
+    lock_guard<mutex> guard(lock);
+    return events.size();
+}
+
+void BitmaskTrack::set(int64_t timeMs, uint32_t mask)
+{
+    if (!changes.empty() && (changes.back().mask == mask || changes.back().timeMs > timeMs))
+        return;
+    if (changes.size() >= CAPACITY)
+        changes.pop_front();
+    changes.push_back({ timeMs, mask });
+}
+
+void BitmaskTrack::query(int64_t beginMs, int64_t endMs, vector<Change>* out) const
+{
+    out->clear();
+    // the last change at or before beginMs is still in effect
+    auto it = upper_bound(changes.begin(), changes.end(), beginMs,
+        [](int64_t t, const Change& c) { return t < c.timeMs; });
+    if (it != changes.begin())
+        out->push_back({ beginMs, prev(it)->mask });
+    for (; it != changes.end() && it->timeMs <= endMs; ++it)
+        out->push_back(*it);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum EventSeverity
+{
+    EVENT_INFO,
+    EVENT_WARNING,
+    EVENT_CRITICAL,
+};
+
+struct TrackEvent
+{
+    int64_t timeMs = 0;     // metric time, see getMetricTimeMs()
+    int severity = EVENT_INFO;
+    std::string text;
+};
+
+// Rare, timestamped events of a panel drawn as annotations over its charts, e.g. an XID error.
+// Unlike the series they can come from any thread, the oldest ones are dropped past CAPACITY.
+struct EventTrack
+{
+    static const int CAPACITY = 256;
+
+    void add(int64_t timeMs, int severity, const std::string& text);
+    // the events in [beginMs, endMs], oldest first
+    void query(int64_t beginMs, int64_t endMs, std::vector<TrackEvent>* events) const;
+    size_t size() const;
+
+private:
+    mutable std::mutex lock;
+    std::deque<TrackEvent> events;  // sorted by time
+};
+
+// A bitmask sampled over time, e.g. the clock throttle reasons, kept as its transitions only.
+// Written and read by the collector owning the panel, the oldest changes are dropped past CAPACITY.
+struct BitmaskTrack
+{
+    static const int CAPACITY = 4096;
+
+    struct Change
+    {
+        int64_t timeMs;
+        uint32_t mask;
+    };
+
+    // ignored unless mask differs from the last one
+    void set(int64_t timeMs, uint32_t mask);
+    // the mask in effect at beginMs followed by the changes up to endMs
+    void query(int64_t beginMs, int64_t endMs, std::vector<Change>* changes) const;
+
+    std::deque<Change> changes;     // sorted by time
+};
@@ -1,304 +1,516 @@
-/*
- * MIT License
- *
- * Copyright (c) 2016 Jeremy Main (jmain.jp@gmail.com)
- * Copyright (c) 2019-2020 Vinjn Zhang (vinjn@qq.com)
- *
- * Permission is hereby granted, free of charge, to any person obtaining a copy
- * of this software and associated documentation files (the "Software"), to deal
- * in the Software without restriction, including without limitation the rights
- * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
- * copies of the Software, and to permit persons to whom the Software is
- * furnished to do so, subject to the following conditions:
- *
- * The above copyright notice and this permission notice shall be included in all
- * copies or substantial portions of the Software.
- *
- * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
- * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
- * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
- * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
- * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
- * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
- * SOFTWARE.
- */
-
-#define _HAS_STD_BYTE 0
-#define GPU_PROF_VERSION "1.4"
-
-#include <stdio.h>
-#include <stdint.h>
-#include <vector>
-#include <assert.h>
-#include <memory>
-#include <string>
-
-#include "nvidia_prof.h"
-#include "etw_prof.h"
-#include "system_prof.h"
-#include "metrics_info.h"
-#include "gui_imgui.h"
-
-// TODO: cross-platform
-#include "../build/resource.h"
-
-#include "screen_shot.h"
-
-#include "shlwapi.h"
-
-using namespace std;
-
-#include "../3rdparty/CImg.h"
-using namespace cimg_library;
-
-bool isCimgVisible = false;
-bool isImguiEnabled = false;
-bool isRemoteGuiEnabled = false;
-
-vector<shared_ptr<CImgDisplay>> windows;
-
-bool running = true;
-
-int setup()
-{
-    system_setup();
-    etw_setup();
-    nvidia_setup();
-
-    for (auto& window : windows)
-    {
-        HICON hIcon = LoadIcon(GetModuleHandle("gpuprof.exe"), MAKEINTRESOURCE(IDI_ICON1));
-        SendMessage(window->_window, WM_SETICON, ICON_SMALL, (LPARAM)hIcon);
-        SendMessage(window->_window, WM_SETICON, ICON_BIG, (LPARAM)hIcon);
-    }
-
-    return 0;
-}
-
-int update()
-{
-    system_update();
-    etw_update();
-    nvidia_update();
-
-    if (isImguiEnabled)
-    {
-        if (!updateImgui())
-            return 1;
-    }
-
-    // GUI
-#ifdef WIN32_WITH_THIS
-    SHORT state = GetAsyncKeyState(VK_SPACE);
-    if (state & 1)
-    {
-        // LSB of state indicates it's a "CLICK"
-        isCimgVisible = !isCimgVisible;
-        if (isCimgVisible) window->show();
-        else window->close();
-    }
-#endif
-
-    return 0;
-}
-
-int cleanup()
-{
-    etw_cleanup();
-    nvidia_cleanup();
-
-    if (isImguiEnabled)
-        destroyImgui();
-
-    return 0;
-}
-
-int global_mouse_x = -1;
-int global_mouse_y = -1;
-char exe_folder[MAX_PATH + 1] = "";
-
-void drawCimg()
-{
-    global_mouse_x = -1;
-    global_mouse_y = -1;
-
-    for (auto& window : windows)
-    {
-        auto xm = window->mouse_x();
-        auto ym = window->mouse_y();
-        if (xm >= 0 && ym >= 0)
-        {
-            global_mouse_x = xm;
-            global_mouse_y = ym;
-        }
-    }
-
-    if (global_mouse_x < 0 || global_mouse_y < 0)
-    {
-        global_mouse_x = windows[0]->width() - 1;
-        global_mouse_y = 0;
-    }
-
-    int idx = 0;
-    int x0 = windows[0]->window_x();
-    int y0 = windows[0]->window_y();
-
-    bool force_show_window = false;
-    static bool show_legends = true;
-    bool capture_etl = false;
-    bool space_hit = false;
-
-    for (auto& window : windows)
-    {
-        if (window->is_keyESC()) running = false;
-        if (window->is_keySPACE()) space_hit = true;
-        if (window->is_keyF8()) capture_etl = true;
-
-        window->move(x0, y0 + idx * (WINDOW_H + 32));
-
-        if (idx == 0)
-        {
-            system_draw(show_legends);
-        }
-        else if (idx == 1)
-        {
-            etw_draw(show_legends);
-        }
-        else
-        {
-            nvidia_draw(show_legends);
-        }
-
-        idx++;
-    }
-
-    if (space_hit)
-    {
-        show_legends = !show_legends;
-    }
-
-    for (auto& window : windows)
-    {
-        if (force_show_window)
-            window->show();
-    }
-
-    if (capture_etl)
-    {
-        char buf[256];
-        sprintf(buf, "sudo.exe %s\\etw\\capture.bat", exe_folder);
-        system(buf);
-    }
-}
-
-void drawImgui(bool isRemote)
-{
-    if (isRemote)
-    {
-        updateRemoteImgui();
-        ImGui_ImplCinder_NewFrameGuard();
-    }
-    else
-    {
-        ImGui_SDL_BeginDraw();
-    }
-
-    static bool showImguiDemoWindow = false;
-    if (ImGui::Button("showImguiDemoWindow"))
-        showImguiDemoWindow = !showImguiDemoWindow;
-    ImGui::ShowDemoWindow(&showImguiDemoWindow);
-    static bool showImplotDemoWindow = false;
-    if (ImGui::Button("showImplotDemoWindow"))
-        showImplotDemoWindow = !showImplotDemoWindow;
-    ImPlot::ShowDemoWindow(&showImplotDemoWindow);
-
-    //ImGui::SetNextWindowPos(ImVec2(0, 0));
-    //ImGui::SetNextWindowSize(ImVec2(1024, 768));
-    ImGui::Begin("GpuProf " GPU_PROF_VERSION " from vinjn.con");
-
-    system_draw_imgui();
-    etw_draw_imgui();
-    nvidia_draw_imgui();
-
-    ImGui::End();
-
-    if (isRemote)
-    {
-        ImGui_ImplCinder_PostDraw();
-    }
-    else
-    {
-        ImGui_SDL_EndDraw();
-    }
-}
-
-// Application entry point
-int main(int argc, char* argv[])
-{
-#if 0
-    intel_main(0, NULL);
-#endif
-
-    if (argc >= 2)
-    {
-        char* addr = argv[1];
-        if (strcmp(addr, "-zen") == 0)
-        {
-        }
-        else if (strcmp(addr, "-remote") == 0)
-        {
-            isRemoteGuiEnabled = true;
-
-            createRemoteImgui(addr);
-        }
-        if (strcmp(addr, "-imgui") == 0)
-        {
-            isImguiEnabled = true;
-
-            createImgui();
-        }
-        else
-        {
-            isCimgVisible = true;
-        }
-    }
-    else
-    {
-        isCimgVisible = true;
-    }
-
-    GetModuleFileNameA(NULL, exe_folder, MAX_PATH);
-    PathRemoveFileSpecA(exe_folder);
-
-    //gdiscreen();
-
-    printf("GpuProf %s from vinjn.com\n", GPU_PROF_VERSION);
-
-    if (setup() != 0)
-        return -1;
-
-    while (running)
-    {
-        if (update() != 0)
-            break;
-
-        if (isCimgVisible)
-        {
-            drawCimg();
-        }
-        if (isRemoteGuiEnabled)
-        {
-            drawImgui(true);
-        }
-        if (isImguiEnabled)
-        {
-            drawImgui(false);
-        }
-        ::Sleep(100);
-    }
-
-    cleanup();
-
-    return 0;
-}
-
+/*
+ * MIT License
+ *
+ * Copyright (c) 2016 Jeremy Main (jmain.jp@gmail.com)
+ * Copyright (c) 2019-2020 Vinjn Zhang (vinjn@qq.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _HAS_STD_BYTE 0
+#define GPU_PROF_VERSION "1.4"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <assert.h>
+#include <memory>
+#include <string>
+#include <atomic>
+#include <mutex>
+
+#include "nvidia_prof.h"
+#include "etw_prof.h"
+#include "system_prof.h"
+#include "metrics_info.h"
+#include "gui_imgui.h"
+#include "scheduler.h"
+#include "recorder.h"
+#include "self_profile.h"
+#include "util_win32.h"
+
+// TODO: cross-platform
+#include "../build/resource.h"
+
+#include "screen_shot.h"
+
+#include "shlwapi.h"
+#include <timeapi.h>
+#pragma comment(lib, "winmm")
+
+using namespace std;
+
+#include "../3rdparty/CImg.h"
+using namespace cimg_library;
+
+bool isCimgVisible = false;
+bool isImguiEnabled = false;
+bool isRemoteGuiEnabled = false;
+// -headless, collectors and the recorder only
+bool isHeadless = false;
+const char* recordPath = nullptr;
+// NVML tape to write, tape to replay instead of the driver, or number of synthetic GPUs
+const char* nvmlRecordPath = nullptr;
+const char* nvmlReplayPath = nullptr;
+int nvmlFakeDevices = 0;
+
+vector<shared_ptr<CImgDisplay>> windows;
+// windows of the collectors that start in the background, taken over by drawCimg()
+mutex newWindowsLock;
+vector<shared_ptr<CImgDisplay>> newWindows;
+
+void addWindow(shared_ptr<CImgDisplay> window)
+{
+    lock_guard<mutex> lock(newWindowsLock);
+    newWindows.push_back(window);
+}
+
+void setWindowIcon(CImgDisplay& window)
+{
+    HICON hIcon = LoadIcon(GetModuleHandle("gpuprof.exe"), MAKEINTRESOURCE(IDI_ICON1));
+    SendMessage(window._window, WM_SETICON, ICON_SMALL, (LPARAM)hIcon);
+    SendMessage(window._window, WM_SETICON, ICON_BIG, (LPARAM)hIcon);
+}
+
+atomic<bool> running(true);
+
+// sampling period of each collector, the renderer ticks on its own clock
+const int kSystemPeriodMs = 1000;       // PDH rates are averaged over the period anyway
+const int kEtwPeriodMs = 16;            // drains the present events about once per frame
+const int kEtwHeadlessPeriodMs = 100;   // the fps is averaged over the present history, 10 Hz is plenty for the file
+const int kNvidiaPeriodMs = 100;
+const int kNvidiaPowerPeriodMs = 20;
+const int kRenderPeriodMs = 33;
+const int kRecorderPeriodMs = 1000;
+const int kSelfProfilePeriodMs = 250;
+
+// one thread per collector so a slow source never holds up the others,
+// they hand their data to the renderer through MetricsInfo snapshots
+Scheduler systemCollector("system collector");
+Scheduler etwCollector("etw collector");
+Scheduler nvidiaCollector("nvidia collector");
+Scheduler renderer("renderer");
+Scheduler recorder("recorder");
+Scheduler* const schedulers[] = { &systemCollector, &etwCollector, &nvidiaCollector, &renderer, &recorder };
+
+int render();
+
+// NVML and the ETW session take seconds to come up on big machines, they are started on their
+// collector threads by main(), the UI and the system collector don't wait for them
+int setup()
+{
+    system_setup();
+    etw_setup();
+
+    // a failing collector keeps its schedule, only the renderer can stop the loop
+    systemCollector.add("system", kSystemPeriodMs, [] { system_update(); return 0; });
+    etwCollector.add("etw", isHeadless ? kEtwHeadlessPeriodMs : kEtwPeriodMs, [] { etw_update(); return 0; });
+    nvidiaCollector.add("nvidia", kNvidiaPeriodMs, [] { nvidia_update(); return 0; });
+    nvidiaCollector.add("nvidia power", kNvidiaPowerPeriodMs, [] { nvidia_update_power(); return 0; });
+    renderer.add("render", kRenderPeriodMs, render);
+    recorder.add("flush", kRecorderPeriodMs, [] { recorder_update(); return running ? 0 : 1; });
+    recorder.add("self profile", kSelfProfilePeriodMs, self_profile_update);
+
+    for (auto& window : windows)
+        setWindowIcon(*window);
+
+    return 0;
+}
+
+int update()
+{
+    if (isImguiEnabled)
+    {
+        if (!updateImgui())
+            return 1;
+    }
+
+    // GUI
+#ifdef WIN32_WITH_THIS
+    SHORT state = GetAsyncKeyState(VK_SPACE);
+    if (state & 1)
+    {
+        // LSB of state indicates it's a "CLICK"
+        isCimgVisible = !isCimgVisible;
+        if (isCimgVisible) window->show();
+        else window->close();
+    }
+#endif
+
+    return 0;
+}
+
+int cleanup()
+{
+    systemCollector.stop();
+    etwCollector.stop();
+    nvidiaCollector.stop();
+    recorder.stop();
+
+    system_cleanup();
+    etw_cleanup();
+    nvidia_cleanup();
+
+    if (isImguiEnabled)
+        destroyImgui();
+
+    recorder_cleanup();
+
+    return 0;
+}
+
+int global_mouse_x = -1;
+int global_mouse_y = -1;
+
+// time window shown by the charts, PAGEUP / PAGEDOWN in CImg windows
+const int64_t kViewSpansMs[] =
+{
+    MetricsInfo::DISPLAY_COUNT * MetricSeries::RAW_PERIOD_MS,
+    60 * 1000,
+    10 * 60 * 1000,
+    60 * 60 * 1000,
+    6 * 60 * 60 * 1000,
+    24 * 60 * 60 * 1000,
+};
+int view_span_idx = 0;
+// read by the collectors when they publish
+atomic<int64_t> global_view_span_ms(kViewSpansMs[0]);
+char exe_folder[MAX_PATH + 1] = "";
+
+void drawCimg()
+{
+    PROFILE_ZONE("drawCimg");
+    global_mouse_x = -1;
+    global_mouse_y = -1;
+
+    {
+        lock_guard<mutex> lock(newWindowsLock);
+        for (auto& window : newWindows)
+        {
+            setWindowIcon(*window);
+            windows.push_back(window);
+        }
+        newWindows.clear();
+    }
+
+    for (auto& window : windows)
+    {
+        auto xm = window->mouse_x();
+        auto ym = window->mouse_y();
+        if (xm >= 0 && ym >= 0)
+        {
+            global_mouse_x = xm;
+            global_mouse_y = ym;
+        }
+    }
+
+    if (global_mouse_x < 0 || global_mouse_y < 0)
+    {
+        global_mouse_x = windows[0]->width() - 1;
+        global_mouse_y = 0;
+    }
+
+    int idx = 0;
+    int x0 = windows[0]->window_x();
+    int y0 = windows[0]->window_y();
+
+    bool force_show_window = false;
+    static bool show_legends = true;
+    bool capture_etl = false;
+    bool space_hit = false;
+    bool zoom_in = false;
+    bool zoom_out = false;
+
+    for (auto& window : windows)
+    {
+        if (window->is_keyESC()) running = false;
+        if (window->is_keySPACE()) space_hit = true;
+        if (window->is_keyF8()) capture_etl = true;
+        if (window->is_keyPAGEUP()) zoom_out = true;
+        if (window->is_keyPAGEDOWN()) zoom_in = true;
+
+        window->move(x0, y0 + idx * (WINDOW_H + 32));
+
+        if (idx == 0)
+        {
+            system_draw(show_legends);
+        }
+        else if (idx == 1)
+        {
+            etw_draw(show_legends);
+        }
+        else
+        {
+            nvidia_draw(show_legends);
+        }
+
+        idx++;
+    }
+
+    if (space_hit)
+    {
+        show_legends = !show_legends;
+    }
+
+    if (zoom_out && view_span_idx + 1 < _countof(kViewSpansMs))
+        view_span_idx++;
+    if (zoom_in && view_span_idx > 0)
+        view_span_idx--;
+    global_view_span_ms = kViewSpansMs[view_span_idx];
+
+    for (auto& window : windows)
+    {
+        if (force_show_window)
+            window->show();
+    }
+
+    if (capture_etl)
+    {
+        char buf[256];
+        sprintf(buf, "sudo.exe %s\\etw\\capture.bat", exe_folder);
+        system(buf);
+    }
+}
+
+void drawImgui(bool isRemote)
+{
+    PROFILE_ZONE("drawImgui");
+    if (isRemote)
+    {
+        updateRemoteImgui();
+        ImGui_ImplCinder_NewFrameGuard();
+    }
+    else
+    {
+        ImGui_SDL_BeginDraw();
+    }
+
+    static bool showImguiDemoWindow = false;
+    if (ImGui::Button("showImguiDemoWindow"))
+        showImguiDemoWindow = !showImguiDemoWindow;
+    ImGui::ShowDemoWindow(&showImguiDemoWindow);
+    static bool showImplotDemoWindow = false;
+    if (ImGui::Button("showImplotDemoWindow"))
+        showImplotDemoWindow = !showImplotDemoWindow;
+    ImPlot::ShowDemoWindow(&showImplotDemoWindow);
+
+    //ImGui::SetNextWindowPos(ImVec2(0, 0));
+    //ImGui::SetNextWindowSize(ImVec2(1024, 768));
+    ImGui::Begin("GpuProf " GPU_PROF_VERSION " from vinjn.con");
+
+    char spanName[32];
+    MetricsInfo::formatSpan(spanName, kViewSpansMs[view_span_idx]);
+    if (ImGui::BeginCombo("Time span", spanName))
+    {
+        for (int i = 0; i < _countof(kViewSpansMs); i++)
+        {
+            MetricsInfo::formatSpan(spanName, kViewSpansMs[i]);
+            if (ImGui::Selectable(spanName, i == view_span_idx))
+                view_span_idx = i;
+        }
+        ImGui::EndCombo();
+    }
+    global_view_span_ms = kViewSpansMs[view_span_idx];
+
+    system_draw_imgui();
+    etw_draw_imgui();
+    nvidia_draw_imgui();
+
+    MetricsInfo::drawHistoryStatsImgui();
+    for (auto scheduler : schedulers)
+        scheduler->drawStatsImgui();
+    self_profile_draw_imgui();
+
+    ImGui::End();
+
+    if (isRemote)
+    {
+        ImGui_ImplCinder_PostDraw();
+    }
+    else
+    {
+        ImGui_SDL_EndDraw();
+    }
+}
+
+int render()
+{
+    if (update() != 0)
+        return 1;
+
+    if (isCimgVisible)
+    {
+        drawCimg();
+    }
+    if (isRemoteGuiEnabled)
+    {
+        drawImgui(true);
+    }
+    if (isImguiEnabled)
+    {
+        drawImgui(false);
+    }
+
+    return running ? 0 : 1;
+}
+
+BOOL WINAPI onConsoleCtrl(DWORD type)
+{
+    // Ctrl+C and friends end a headless run cleanly so the recording is complete
+    running = false;
+    recorder.stop();
+    return TRUE;
+}
+
+// Application entry point
+int main(int argc, char* argv[])
+{
+#if 0
+    intel_main(0, NULL);
+#endif
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-headless") == 0)
+        {
+            isHeadless = true;
+            MetricsInfo::isPublishEnabled = false;
+        }
+        else if (i + 1 >= argc)
+        {
+            // the options below take a value
+        }
+        else if (strcmp(argv[i], "-record") == 0)
+        {
+            // every sample is appended to this file, gpuprof.csv by default with -headless
+            recordPath = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "-nvml-record") == 0)
+        {
+            // every NVML call and its results
+            nvmlRecordPath = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "-nvml-replay") == 0)
+        {
+            // a tape of -nvml-record instead of nvml.dll
+            nvmlReplayPath = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "-nvml-fake") == 0)
+        {
+            // synthetic GPUs instead of nvml.dll
+            nvmlFakeDevices = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-history") == 0)
+        {
+            // number of samples kept per metric, 200 by default
+            MetricsInfo::historyCapacity = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-retention") == 0)
+        {
+            // hours of compressed raw samples kept per metric, 8 by default
+            CompressedHistory::retentionMs = (int64_t)(atof(argv[i + 1]) * 3600 * 1000);
+        }
+    }
+
+    if (isHeadless)
+    {
+        // no window, no SDL context
+    }
+    else if (argc >= 2)
+    {
+        char* addr = argv[1];
+        if (strcmp(addr, "-zen") == 0)
+        {
+        }
+        else if (strcmp(addr, "-remote") == 0)
+        {
+            isRemoteGuiEnabled = true;
+
+            createRemoteImgui(addr);
+        }
+        if (strcmp(addr, "-imgui") == 0)
+        {
+            isImguiEnabled = true;
+
+            createImgui();
+        }
+        else
+        {
+            isCimgVisible = true;
+        }
+    }
+    else
+    {
+        isCimgVisible = true;
+    }
+
+    GetModuleFileNameA(NULL, exe_folder, MAX_PATH);
+    PathRemoveFileSpecA(exe_folder);
+
+    //gdiscreen();
+
+    printf("GpuProf %s from vinjn.com\n", GPU_PROF_VERSION);
+
+    if (isHeadless && !recordPath)
+        recordPath = "gpuprof.csv";
+    // opened before setup() so the collectors get their recording queues
+    if (recordPath && recorder_setup(recordPath) != 0)
+        return -1;
+
+    if (isHeadless)
+        SetPriorityClass(GetCurrentProcess(), BELOW_NORMAL_PRIORITY_CLASS);
+
+    if (setup() != 0)
+        return -1;
+
+    // 1 ms sleep granularity, the default 15.6 ms tick would swallow the short periods
+    timeBeginPeriod(1);
+    systemCollector.start();
+    etwCollector.start([] { etw_start(); });
+    nvidiaCollector.start([] { nvidia_setup(); });
+    if (isHeadless)
+    {
+        printf("Recording to %s, Ctrl+C to stop\n", recordPath);
+        SetConsoleCtrlHandler(onConsoleCtrl, TRUE);
+        recorder.run();
+    }
+    else
+    {
+        // also drains the self profiling rings
+        recorder.start();
+        renderer.run();
+    }
+
+    cleanup();
+    timeEndPeriod(1);
+
+    for (auto scheduler : schedulers)
+    {
+        printf("%s\n", scheduler->name.c_str());
+        scheduler->printStats();
+    }
+
+    auto usage = getProcessUsage();
+    printf("gpuprof: %.2f%% of one core (%.1f s cpu in %.1f s), rss %.1f MB, peak %.1f MB\n",
+        usage.cpuSeconds * 100 / (std::max)(usage.wallSeconds, 1e-3), usage.cpuSeconds, usage.wallSeconds,
+        usage.rssBytes / 1048576.0, usage.peakRssBytes / 1048576.0);
+
+    return 0;
+}
+
@@ -1,206 +1,208 @@
-#include <winsock2.h>
-#include "gui_imgui.h"
-#include "../3rdparty/imgui_remote/imgui_remote.h"
-#include "backends/imgui_impl_sdl.h"
-#include "backends/imgui_impl_sdlrenderer.h"
-#include "SDL.h"
-#include "implot/implot.h"
-
-#pragma comment(lib, "Ws2_32")
-#pragma comment(lib, "shlwapi")
-#pragma comment(lib, "SDL2")
-#pragma comment(lib, "SDL2main")
-
-static bool sTriggerNewFrame = false;
-static INT64 g_TicksPerSecond = 0;
-static INT64 g_Time = 0;
-ImGuiContext* imguiCtx = NULL;
-
-namespace
-{
-    SDL_Window* window;
-    SDL_Renderer* renderer;
-}
-
-bool createImgui()
-{
-    // Setup SDL
-// (Some versions of SDL before <2.0.10 appears to have performance/stalling issues on a minority of Windows systems,
-// depending on whether SDL_INIT_GAMECONTROLLER is enabled or disabled.. updating to latest version of SDL is recommended!)
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_GAMECONTROLLER) != 0)
-    {
-        printf("Error: %s\n", SDL_GetError());
-        return false;
-    }
-
-    // Setup window
-    SDL_WindowFlags window_flags = (SDL_WindowFlags)(SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI);
-    window = SDL_CreateWindow("GpuProf", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 1280, 720, window_flags);
-
-    // Setup SDL_Renderer instance
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_PRESENTVSYNC | SDL_RENDERER_ACCELERATED);
-    if (renderer == NULL)
-    {
-        SDL_Log("Error creating SDL_Renderer!");
-        return false;
-    }
-    //SDL_RendererInfo info;
-    //SDL_GetRendererInfo(renderer, &info);
-    //SDL_Log("Current SDL_Renderer: %s", info.name);
-
-    // Setup Dear ImGui context
-    IMGUI_CHECKVERSION();
-    imguiCtx = ImGui::CreateContext();
-    ImGuiIO& io = ImGui::GetIO(); (void)io;
-    //io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;     // Enable Keyboard Controls
-    //io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;      // Enable Gamepad Controls
-
-    // Setup Dear ImGui style
-    ImGui::StyleColorsDark();
-    //ImGui::StyleColorsLight();
-
-    // Setup Platform/Renderer backends
-    ImGui_ImplSDL2_InitForSDLRenderer(window, renderer);
-    ImGui_ImplSDLRenderer_Init(renderer);
-
-    ImPlot::CreateContext();
-
-    return true;
-}
-
-bool updateImgui()
-{
-// Poll and handle events (inputs, window resize, etc.)
-// You can read the io.WantCaptureMouse, io.WantCaptureKeyboard flags to tell if dear imgui wants to use your inputs.
-// - When io.WantCaptureMouse is true, do not dispatch mouse input data to your main application, or clear/overwrite your copy of the mouse data.
-// - When io.WantCaptureKeyboard is true, do not dispatch keyboard input data to your main application, or clear/overwrite your copy of the keyboard data.
-// Generally you may always pass all inputs to dear imgui, and hide them from your application based on those two flags.
-    SDL_Event event;
-    while (SDL_PollEvent(&event))
-    {
-        ImGui_ImplSDL2_ProcessEvent(&event);
-        if (event.type == SDL_QUIT)
-            return false;
-        if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_ESCAPE)
-            return false;
-        if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_CLOSE && event.window.windowID == SDL_GetWindowID(window))
-            return false;
-    }
-    return true;
-}
-
-void ImGui_SDL_BeginDraw()
-{
-    // Start the Dear ImGui frame
-    ImGui_ImplSDLRenderer_NewFrame();
-    ImGui_ImplSDL2_NewFrame();
-    ImGui::NewFrame();
-}
-
-void ImGui_SDL_EndDraw()
-{
-    // Rendering
-    ImGui::Render();
-    SDL_SetRenderDrawColor(renderer, 122, 122, 122, 122);
-    SDL_RenderClear(renderer);
-    ImGui_ImplSDLRenderer_RenderDrawData(ImGui::GetDrawData());
-    SDL_RenderPresent(renderer);
-}
-
-void destroyImgui()
-{
-    // Cleanup
-    ImPlot::DestroyContext();
-
-    ImGui_ImplSDLRenderer_Shutdown();
-    ImGui_ImplSDL2_Shutdown();
-    ImGui::DestroyContext();
-
-    SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
-    SDL_Quit();
-}
-
-bool createRemoteImgui(const char* address, int port)
-{
-    imguiCtx = ImGui::CreateContext();
-    ImGui::StyleColorsDark();
-    ImGuiIO& io = ImGui::GetIO();
-    io.Fonts->AddFontDefault();
-    unsigned char* pixels;
-    int width, height;
-    io.Fonts->GetTexDataAsAlpha8(&pixels, &width, &height);
-
-    ImGui::RemoteInit(address, port);
-    sTriggerNewFrame = true;
-
-    ::QueryPerformanceFrequency((LARGE_INTEGER*)&g_TicksPerSecond);
-    ::QueryPerformanceCounter((LARGE_INTEGER*)&g_Time);
-
-    return true;
-}
-
-void updateRemoteImgui()
-{
-    ImGui::RemoteUpdate();
-    ImGui::RemoteInput input;
-    if (ImGui::RemoteGetInput(input))
-    {
-        ImGuiIO& io = ImGui::GetIO();
-        for (int i = 0; i < 256; i++)
-            io.KeysDown[i] = input.KeysDown[i];
-        io.KeyCtrl = input.KeyCtrl;
-        io.KeyShift = input.KeyShift;
-        io.MousePos = input.MousePos;
-        io.MouseDown[0] = (input.MouseButtons & 1);
-        io.MouseDown[1] = (input.MouseButtons & 2) != 0;
-        io.MouseWheel += input.MouseWheelDelta;
-        // Keyboard mapping. ImGui will use those indices to peek into the io.KeyDown[] array.
-        io.KeyMap[ImGuiKey_Tab] = ImGuiKey_Tab;
-        io.KeyMap[ImGuiKey_LeftArrow] = ImGuiKey_LeftArrow;
-        io.KeyMap[ImGuiKey_RightArrow] = ImGuiKey_RightArrow;
-        io.KeyMap[ImGuiKey_UpArrow] = ImGuiKey_UpArrow;
-        io.KeyMap[ImGuiKey_DownArrow] = ImGuiKey_DownArrow;
-        io.KeyMap[ImGuiKey_Home] = ImGuiKey_Home;
-        io.KeyMap[ImGuiKey_End] = ImGuiKey_End;
-        io.KeyMap[ImGuiKey_Delete] = ImGuiKey_Delete;
-        io.KeyMap[ImGuiKey_Backspace] = ImGuiKey_Backspace;
-        io.KeyMap[ImGuiKey_Enter] = 13;
-        io.KeyMap[ImGuiKey_Escape] = 27;
-        io.KeyMap[ImGuiKey_A] = 'a';
-        io.KeyMap[ImGuiKey_C] = 'c';
-        io.KeyMap[ImGuiKey_V] = 'v';
-        io.KeyMap[ImGuiKey_X] = 'x';
-        io.KeyMap[ImGuiKey_Y] = 'y';
-        io.KeyMap[ImGuiKey_Z] = 'z';
-    }
-}
-
-void ImGui_ImplCinder_NewFrameGuard() {
-    if (!sTriggerNewFrame)
-        return;
-
-    ImGuiIO& io = ImGui::GetIO();
-    IM_ASSERT(io.Fonts->IsBuilt()); // Font atlas needs to be built, call renderer _NewFrame() function e.g. ImGui_ImplOpenGL3_NewFrame() 
-
-    // Setup display size
-    io.DisplaySize = { 1024, 768 };
-
-    // Setup time step
-    INT64 current_time;
-    ::QueryPerformanceCounter((LARGE_INTEGER*)&current_time);
-    io.DeltaTime = (float)(current_time - g_Time) / g_TicksPerSecond;
-    g_Time = current_time;
-
-    ImGui::NewFrame();
-
-    sTriggerNewFrame = false;
-}
-
-void ImGui_ImplCinder_PostDraw()
-{
-    ImGui::Render();
-    auto draw_data = ImGui::GetDrawData();
-    ImGui::RemoteDraw(draw_data->CmdLists, draw_data->CmdListsCount);
-    sTriggerNewFrame = true;
-}
+#include <winsock2.h>
+#include "gui_imgui.h"
+#include "../3rdparty/imgui_remote/imgui_remote.h"
+#include "backends/imgui_impl_sdl.h"
+#include "backends/imgui_impl_sdlrenderer.h"
+#include "SDL.h"
+#include "implot/implot.h"
+#include "self_profile.h"
+
+#pragma comment(lib, "Ws2_32")
+#pragma comment(lib, "shlwapi")
+#pragma comment(lib, "SDL2")
+#pragma comment(lib, "SDL2main")
+
+static bool sTriggerNewFrame = false;
+static INT64 g_TicksPerSecond = 0;
+static INT64 g_Time = 0;
+ImGuiContext* imguiCtx = NULL;
+
+namespace
+{
+    SDL_Window* window;
+    SDL_Renderer* renderer;
+}
+
+bool createImgui()
+{
+    // Setup SDL
+// (Some versions of SDL before <2.0.10 appears to have performance/stalling issues on a minority of Windows systems,
+// depending on whether SDL_INIT_GAMECONTROLLER is enabled or disabled.. updating to latest version of SDL is recommended!)
+    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_GAMECONTROLLER) != 0)
+    {
+        printf("Error: %s\n", SDL_GetError());
+        return false;
+    }
+
+    // Setup window
+    SDL_WindowFlags window_flags = (SDL_WindowFlags)(SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI);
+    window = SDL_CreateWindow("GpuProf", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 1280, 720, window_flags);
+
+    // Setup SDL_Renderer instance
+    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_PRESENTVSYNC | SDL_RENDERER_ACCELERATED);
+    if (renderer == NULL)
+    {
+        SDL_Log("Error creating SDL_Renderer!");
+        return false;
+    }
+    //SDL_RendererInfo info;
+    //SDL_GetRendererInfo(renderer, &info);
+    //SDL_Log("Current SDL_Renderer: %s", info.name);
+
+    // Setup Dear ImGui context
+    IMGUI_CHECKVERSION();
+    imguiCtx = ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO(); (void)io;
+    //io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;     // Enable Keyboard Controls
+    //io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;      // Enable Gamepad Controls
+
+    // Setup Dear ImGui style
+    ImGui::StyleColorsDark();
+    //ImGui::StyleColorsLight();
+
+    // Setup Platform/Renderer backends
+    ImGui_ImplSDL2_InitForSDLRenderer(window, renderer);
+    ImGui_ImplSDLRenderer_Init(renderer);
+
+    ImPlot::CreateContext();
+
+    return true;
+}
+
+bool updateImgui()
+{
+// Poll and handle events (inputs, window resize, etc.)
+// You can read the io.WantCaptureMouse, io.WantCaptureKeyboard flags to tell if dear imgui wants to use your inputs.
+// - When io.WantCaptureMouse is true, do not dispatch mouse input data to your main application, or clear/overwrite your copy of the mouse data.
+// - When io.WantCaptureKeyboard is true, do not dispatch keyboard input data to your main application, or clear/overwrite your copy of the keyboard data.
+// Generally you may always pass all inputs to dear imgui, and hide them from your application based on those two flags.
+    SDL_Event event;
+    while (SDL_PollEvent(&event))
+    {
+        ImGui_ImplSDL2_ProcessEvent(&event);
+        if (event.type == SDL_QUIT)
+            return false;
+        if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_ESCAPE)
+            return false;
+        if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_CLOSE && event.window.windowID == SDL_GetWindowID(window))
+            return false;
+    }
+    return true;
+}
+
+void ImGui_SDL_BeginDraw()
+{
+    // Start the Dear ImGui frame
+    ImGui_ImplSDLRenderer_NewFrame();
+    ImGui_ImplSDL2_NewFrame();
+    ImGui::NewFrame();
+}
+
+void ImGui_SDL_EndDraw()
+{
+    // Rendering
+    ImGui::Render();
+    SDL_SetRenderDrawColor(renderer, 122, 122, 122, 122);
+    SDL_RenderClear(renderer);
+    ImGui_ImplSDLRenderer_RenderDrawData(ImGui::GetDrawData());
+    SDL_RenderPresent(renderer);
+}
+
+void destroyImgui()
+{
+    // Cleanup
+    ImPlot::DestroyContext();
+
+    ImGui_ImplSDLRenderer_Shutdown();
+    ImGui_ImplSDL2_Shutdown();
+    ImGui::DestroyContext();
+
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+}
+
+bool createRemoteImgui(const char* address, int port)
+{
+    imguiCtx = ImGui::CreateContext();
+    ImGui::StyleColorsDark();
+    ImGuiIO& io = ImGui::GetIO();
+    io.Fonts->AddFontDefault();
+    unsigned char* pixels;
+    int width, height;
+    io.Fonts->GetTexDataAsAlpha8(&pixels, &width, &height);
+
+    ImGui::RemoteInit(address, port);
+    sTriggerNewFrame = true;
+
+    ::QueryPerformanceFrequency((LARGE_INTEGER*)&g_TicksPerSecond);
+    ::QueryPerformanceCounter((LARGE_INTEGER*)&g_Time);
+
+    return true;
+}
+
+void updateRemoteImgui()
+{
+    ImGui::RemoteUpdate();
+    ImGui::RemoteInput input;
+    if (ImGui::RemoteGetInput(input))
+    {
+        ImGuiIO& io = ImGui::GetIO();
+        for (int i = 0; i < 256; i++)
+            io.KeysDown[i] = input.KeysDown[i];
+        io.KeyCtrl = input.KeyCtrl;
+        io.KeyShift = input.KeyShift;
+        io.MousePos = input.MousePos;
+        io.MouseDown[0] = (input.MouseButtons & 1);
+        io.MouseDown[1] = (input.MouseButtons & 2) != 0;
+        io.MouseWheel += input.MouseWheelDelta;
+        // Keyboard mapping. ImGui will use those indices to peek into the io.KeyDown[] array.
+        io.KeyMap[ImGuiKey_Tab] = ImGuiKey_Tab;
+        io.KeyMap[ImGuiKey_LeftArrow] = ImGuiKey_LeftArrow;
+        io.KeyMap[ImGuiKey_RightArrow] = ImGuiKey_RightArrow;
+        io.KeyMap[ImGuiKey_UpArrow] = ImGuiKey_UpArrow;
+        io.KeyMap[ImGuiKey_DownArrow] = ImGuiKey_DownArrow;
+        io.KeyMap[ImGuiKey_Home] = ImGuiKey_Home;
+        io.KeyMap[ImGuiKey_End] = ImGuiKey_End;
+        io.KeyMap[ImGuiKey_Delete] = ImGuiKey_Delete;
+        io.KeyMap[ImGuiKey_Backspace] = ImGuiKey_Backspace;
+        io.KeyMap[ImGuiKey_Enter] = 13;
+        io.KeyMap[ImGuiKey_Escape] = 27;
+        io.KeyMap[ImGuiKey_A] = 'a';
+        io.KeyMap[ImGuiKey_C] = 'c';
+        io.KeyMap[ImGuiKey_V] = 'v';
+        io.KeyMap[ImGuiKey_X] = 'x';
+        io.KeyMap[ImGuiKey_Y] = 'y';
+        io.KeyMap[ImGuiKey_Z] = 'z';
+    }
+}
+
+void ImGui_ImplCinder_NewFrameGuard() {
+    if (!sTriggerNewFrame)
+        return;
+
+    ImGuiIO& io = ImGui::GetIO();
+    IM_ASSERT(io.Fonts->IsBuilt()); // Font atlas needs to be built, call renderer _NewFrame() function e.g. ImGui_ImplOpenGL3_NewFrame() 
+
+    // Setup display size
+    io.DisplaySize = { 1024, 768 };
+
+    // Setup time step
+    INT64 current_time;
+    ::QueryPerformanceCounter((LARGE_INTEGER*)&current_time);
+    io.DeltaTime = (float)(current_time - g_Time) / g_TicksPerSecond;
+    g_Time = current_time;
+
+    ImGui::NewFrame();
+
+    sTriggerNewFrame = false;
+}
+
+void ImGui_ImplCinder_PostDraw()
+{
+    ImGui::Render();
+    auto draw_data = ImGui::GetDrawData();
+    PROFILE_ZONE("RemoteDraw");
+    ImGui::RemoteDraw(draw_data->CmdLists, draw_data->CmdListsCount);
+    sTriggerNewFrame = true;
+}
@@ -0,0 +1,150 @@
+#include "metric_registry.h"
+#include <stdio.h>
+#include <assert.h>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    struct MetricEntry
+    {
+        MetricKey key;
+        MetricSeries series;
+        int refCount = 0;
+    };
+
+    // Handles index a fixed table so lookups never race with a registration.
+    const int MAX_METRICS = 4096;
+    unique_ptr<MetricEntry> entries[MAX_METRICS];
+    int entryCount = 0;
+    vector<MetricHandle> freeHandles;
+    // released but maybe still queued for the recorder
+    vector<MetricHandle> releasedHandles;
+    bool isReuseDeferred = false;
+    unordered_map<string, MetricHandle> handleByKey;
+    mutex registryMutex;
+
+    string makeKey(const char* source, int device, const string& name, const char* unit)
+    {
+        return string(source) + '\x1f' + to_string(device) + '\x1f' + name + '\x1f' + unit;
+    }
+}
+
+MetricHandle registerMetric(const char* source, int device, const string& name, const char* unit)
+{
+    lock_guard<mutex> lock(registryMutex);
+
+    auto key = makeKey(source, device, name, unit);
+    auto it = handleByKey.find(key);
+    if (it != handleByKey.end())
+    {
+        entries[it->second]->refCount++;
+        return it->second;
+    }
+
+    MetricHandle handle = INVALID_METRIC;
+    if (!freeHandles.empty())
+    {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+    }
+    else if (entryCount < MAX_METRICS)
+    {
+        handle = entryCount++;
+    }
+    else
+    {
+        fprintf(stderr, "[registerMetric] - too many metrics, %s is dropped\r\n", name.c_str());
+        return INVALID_METRIC;
+    }
+
+    auto entry = make_unique<MetricEntry>();
+    entry->key.source = source;
+    entry->key.device = device;
+    entry->key.name = name;
+    entry->key.unit = unit;
+    entry->refCount = 1;
+    entries[handle] = move(entry);
+    handleByKey[key] = handle;
+
+    return handle;
+}
+
+void releaseMetric(MetricHandle handle)
+{
+    lock_guard<mutex> lock(registryMutex);
+
+    if (handle < 0 || handle >= entryCount || !entries[handle])
+        return;
+
+    auto& entry = entries[handle];
+    if (--entry->refCount > 0)
+        return;
+
+    const auto& k = entry->key;
+    handleByKey.erase(makeKey(k.source.c_str(), k.device, k.name, k.unit.c_str()));
+    entry.reset();
+    if (isReuseDeferred)
+        releasedHandles.push_back(handle);
+    else
+        freeHandles.push_back(handle);
+}
+
+void deferMetricReuse(bool isDeferred)
+{
+    lock_guard<mutex> lock(registryMutex);
+    isReuseDeferred = isDeferred;
+    if (!isDeferred)
+    {
+        freeHandles.insert(freeHandles.end(), releasedHandles.begin(), releasedHandles.end());
+        releasedHandles.clear();
+    }
+}
+
+vector<MetricHandle> takeReleasedMetrics()
+{
+    lock_guard<mutex> lock(registryMutex);
+    vector<MetricHandle> handles;
+    handles.swap(releasedHandles);
+    return handles;
+}
+
+void recycleMetrics(const vector<MetricHandle>& handles)
+{
+    lock_guard<mutex> lock(registryMutex);
+    freeHandles.insert(freeHandles.end(), handles.begin(), handles.end());
+}
+
+const MetricKey& getMetricKey(MetricHandle handle)
+{
+    assert(handle >= 0 && handle < entryCount && entries[handle]);
+    return entries[handle]->key;
+}
+
+MetricSeries& getMetricSeries(MetricHandle handle)
+{
+    assert(handle >= 0 && handle < entryCount && entries[handle]);
+    return entries[handle]->series;
+}
+
+int getMetricCount()
+{
+    lock_guard<mutex> lock(registryMutex);
+    return entryCount - (int)freeHandles.size() - (int)releasedHandles.size();
+}
+
+vector<MetricHandle> getMetricHandles()
+{
+    lock_guard<mutex> lock(registryMutex);
+    vector<MetricHandle> handles;
+    for (int i = 0; i < entryCount; i++)
+    {
+        if (entries[i])
+            handles.push_back(i);
+    }
+    return handles;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "metric_series.h"
+
+// Dense index of a registered series, stable until releaseMetric().
+typedef int MetricHandle;
+const MetricHandle INVALID_METRIC = -1;
+
+struct MetricKey
+{
+    std::string source;     // collector, e.g. "gpu", "system" or "fps"
+    int device = -1;        // gpu index or pid, -1 when it doesn't apply
+    std::string name;
+    std::string unit;
+};
+
+// Series are interned by (source, device, name, unit), registering the same key twice
+// returns the same handle. Storage is only allocated for registered series.
+MetricHandle registerMetric(const char* source, int device, const std::string& name, const char* unit);
+void releaseMetric(MetricHandle handle);
+
+// While recording, a released handle is held back until the recorder wrote every sample queued under it,
+// otherwise they would land in the file after the declaration of the series reusing the handle.
+void deferMetricReuse(bool isDeferred);
+// the handles released so far, the recorder passes them to recycleMetrics() once they are flushed
+std::vector<MetricHandle> takeReleasedMetrics();
+void recycleMetrics(const std::vector<MetricHandle>& handles);
+
+const MetricKey& getMetricKey(MetricHandle handle);
+MetricSeries& getMetricSeries(MetricHandle handle);
+int getMetricCount();
+std::vector<MetricHandle> getMetricHandles();
@@ -0,0 +1,357 @@
+#include "metric_series.h"
+#include "simd_reduce.h"
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+    const int64_t kTierBucketMs[MetricSeries::TIER_COUNT] = { 1000, 10 * 1000, 60 * 1000 };
+    // 20 minutes, 3 hours and 24 hours
+    const int kTierCapacity[MetricSeries::TIER_COUNT] = { 1200, 1080, 1440 };
+}
+
+int64_t getMetricTimeMs()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void MetricBucket::add(float value)
+{
+    if (count == 0)
+    {
+        min = max = value;
+    }
+    else
+    {
+        min = std::min(min, value);
+        max = std::max(max, value);
+    }
+    sum += value;
+    count++;
+}
+
+void MetricBucket::merge(const MetricBucket& other)
+{
+    if (other.count == 0)
+        return;
+    if (count == 0)
+    {
+        *this = other;
+        return;
+    }
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+    sum += other.sum;
+    count += other.count;
+}
+
+void MetricTier::setup(int64_t bucketMs_, int capacity)
+{
+    bucketMs = bucketMs_;
+    buckets.assign(capacity, MetricBucket());
+    head = 0;
+    count = 0;
+    headStart = 0;
+}
+
+void MetricTier::add(int64_t timeMs, float value)
+{
+    int64_t start = timeMs - timeMs % bucketMs;
+    if (count == 0)
+    {
+        headStart = start;
+        count = 1;
+    }
+    else if (start > headStart)
+    {
+        // close the open bucket and skip the periods without samples
+        int64_t steps = std::min<int64_t>((start - headStart) / bucketMs, (int64_t)buckets.size());
+        for (int64_t i = 0; i < steps; i++)
+        {
+            head = (head + 1) % buckets.size();
+            buckets[head] = MetricBucket();
+        }
+        count = (int)std::min<int64_t>(count + steps, buckets.size());
+        headStart = start;
+    }
+    buckets[head].add(value);
+}
+
+void MetricTier::reset()
+{
+    std::fill(buckets.begin(), buckets.end(), MetricBucket());
+    head = 0;
+    count = 0;
+    headStart = 0;
+}
+
+void MetricSeries::setCapacity(int capacity)
+{
+    values.assign(std::max(capacity, 1), 0.0f);
+    deltas.assign(values.size(), 0);
+    longDeltas.clear();
+    head = 0;
+    count = 0;
+    hasEvicted = false;
+    newestTime = oldestTime = 0;
+    for (int i = 0; i < TIER_COUNT; i++)
+        tiers[i].setup(kTierBucketMs[i], kTierCapacity[i]);
+}
+
+void MetricSeries::grow(int newCapacity)
+{
+    if (newCapacity <= capacity())
+        return;
+    std::vector<float> newValues(newCapacity, 0.0f);
+    std::vector<uint16_t> newDeltas(newCapacity, 0);
+    // oldest first, from slot 0
+    int start = head - count;
+    if (start < 0)
+        start += capacity();
+    for (int i = 0; i < count; i++)
+    {
+        int idx = (start + i) % capacity();
+        newValues[i] = values[idx];
+        newDeltas[i] = deltas[idx];
+    }
+    for (auto& gap : longDeltas)
+        gap.first = (gap.first - start + capacity()) % capacity();
+    values.swap(newValues);
+    deltas.swap(newDeltas);
+    head = count;
+}
+
+void MetricSeries::push(float value, int64_t timeMs)
+{
+    if (count > 0 && timeMs < newestTime)
+        timeMs = newestTime;
+    int64_t delta = count > 0 ? timeMs - newestTime : 0;
+
+    if (count == 0)
+        oldestTime = timeMs;
+    else if (count == capacity())
+    {
+        // the oldest sample is overwritten, the next one becomes the oldest
+        int next = head + 1 == capacity() ? 0 : head + 1;
+        oldestTime = capacity() == 1 ? timeMs : oldestTime + deltaAt(next);
+        hasEvicted = true;
+    }
+    if (count < capacity())
+        count++;
+    newestTime = timeMs;
+
+    // the slot is reused, so is its long gap, always the oldest one
+    if (deltas[head] == LONG_DELTA && !longDeltas.empty() && longDeltas.front().first == head)
+        longDeltas.erase(longDeltas.begin());
+    values[head] = value;
+    if (delta >= LONG_DELTA)
+    {
+        // a stall or a quarantine, the gap keeps its real length
+        deltas[head] = LONG_DELTA;
+        longDeltas.emplace_back(head, delta);
+    }
+    else
+    {
+        deltas[head] = (uint16_t)delta;
+    }
+    head++;
+    if (head == capacity())
+        head = 0;
+
+    for (auto& tier : tiers)
+        tier.add(timeMs, value);
+    sketch.add(value, timeMs);
+    archive.append(timeMs, value);
+}
+
+void MetricSeries::reset()
+{
+    std::fill(values.begin(), values.end(), 0.0f);
+    std::fill(deltas.begin(), deltas.end(), 0);
+    longDeltas.clear();
+    head = 0;
+    count = 0;
+    hasEvicted = false;
+    newestTime = oldestTime = 0;
+    for (auto& tier : tiers)
+        tier.reset();
+    sketch.reset();
+    archive.reset();
+}
+
+int64_t MetricSeries::deltaAt(int idx) const
+{
+    if (deltas[idx] != LONG_DELTA)
+        return deltas[idx];
+    for (const auto& gap : longDeltas)
+    {
+        if (gap.first == idx)
+            return gap.second;
+    }
+    return LONG_DELTA;
+}
+
+float MetricSeries::latest(int i, int n) const
+{
+    int age = n - 1 - i; // 0 is the newest sample
+    if (age < 0 || age >= count)
+        return 0;
+    int idx = head - 1 - age;
+    if (idx < 0)
+        idx += capacity();
+    return values[idx];
+}
+
+void MetricSeries::copyLatest(float* dst, int n) const
+{
+    int valid = std::min(n, count);
+    int padding = n - valid;
+    if (padding > 0)
+        memset(dst, 0, padding * sizeof(float));
+    dst += padding;
+
+    int begin = head - valid;
+    if (begin < 0)
+    {
+        // [begin + capacity, capacity) followed by [0, head)
+        int tail = -begin;
+        memcpy(dst, values.data() + capacity() - tail, tail * sizeof(float));
+        memcpy(dst + tail, values.data(), head * sizeof(float));
+    }
+    else
+    {
+        memcpy(dst, values.data() + begin, valid * sizeof(float));
+    }
+}
+
+void MetricSeries::resample(float* dst, int n, int64_t spanMs, int64_t nowMs) const
+{
+    std::vector<MetricBucket> points(n);
+    int64_t begin = nowMs - spanMs;
+    auto column = [&](int64_t t)
+    {
+        return (int)std::min<int64_t>(std::max<int64_t>((t - begin) * n / spanMs, 0), n - 1);
+    };
+
+    // the raw ring is exact as long as it reaches back far enough, or holds everything so far
+    bool rawCovers = oldestTime <= begin || !hasEvicted;
+    if (rawCovers && spanMs <= tiers[0].span())
+    {
+        int idx = head;
+        int64_t t = newestTime;
+        for (int age = 0; age < count && t >= begin; age++)
+        {
+            idx = idx == 0 ? capacity() - 1 : idx - 1;
+            if (t <= nowMs)
+                points[column(t)].add(values[idx]);
+            t -= deltaAt(idx);
+        }
+    }
+    else
+    {
+        const MetricTier* tier = &tiers[TIER_COUNT - 1];
+        for (const auto& t : tiers)
+        {
+            if (t.span() >= spanMs)
+            {
+                tier = &t;
+                break;
+            }
+        }
+
+        for (int age = 0; age < tier->count; age++)
+        {
+            int64_t start = tier->headStart - age * tier->bucketMs;
+            if (start < begin)
+                break;
+            int idx = tier->head - age;
+            if (idx < 0)
+                idx += (int)tier->buckets.size();
+            points[column(start)].merge(tier->buckets[idx]);
+        }
+    }
+
+    // sample and hold, collectors slower than the point spacing leave empty points
+    float last = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (points[i].count > 0)
+            last = points[i].avg();
+        dst[i] = last;
+    }
+}
+
+WindowStats MetricSeries::query(int64_t beginMs, int64_t endMs) const
+{
+    WindowStats stats;
+    double weighted = 0;
+    double plain = 0;
+
+    if (count > 0 && (oldestTime <= beginMs || !hasEvicted))
+    {
+        // the walk back finds the window in the ring and weighs the samples, it needs the deltas,
+        // min / max / sum then come from reduceSpan over the at most two contiguous parts
+        int idx = head;
+        int64_t t = newestTime;
+        int newestIdx = -1;
+        int oldestIdx = -1;
+        for (int age = 0; age < count && t >= beginMs; age++)
+        {
+            idx = idx == 0 ? capacity() - 1 : idx - 1;
+            if (t <= endMs)
+            {
+                int64_t weight = t - std::max(t - deltaAt(idx), beginMs);
+                weighted += (double)values[idx] * weight;
+                stats.durationMs += weight;
+                if (newestIdx < 0)
+                    newestIdx = idx;
+                oldestIdx = idx;
+                stats.count++;
+            }
+            t -= deltaAt(idx);
+        }
+
+        if (stats.count > 0)
+        {
+            SpanStats span;
+            if (oldestIdx <= newestIdx)
+            {
+                span = reduceSpan(values.data() + oldestIdx, stats.count);
+            }
+            else
+            {
+                span = reduceSpan(values.data() + oldestIdx, capacity() - oldestIdx);
+                span.merge(reduceSpan(values.data(), newestIdx + 1));
+            }
+            stats.min = span.min;
+            stats.max = span.max;
+            plain = span.sum;
+        }
+    }
+    else
+    {
+        // the sample before the window is unknown, the first one covers from beginMs
+        int64_t prev = beginMs;
+        archive.forEach(beginMs, endMs, [&](int64_t t, float v)
+        {
+            int64_t weight = t - std::max(prev, beginMs);
+            if (stats.count == 0)
+                stats.min = stats.max = v;
+            stats.min = std::min(stats.min, v);
+            stats.max = std::max(stats.max, v);
+            weighted += (double)v * weight;
+            plain += v;
+            stats.durationMs += weight;
+            stats.count++;
+            prev = t;
+        });
+    }
+
+    if (stats.durationMs > 0)
+        stats.mean = float(weighted / stats.durationMs);
+    else if (stats.count > 0)
+        stats.mean = float(plain / stats.count);
+    return stats;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+#include "quantile_sketch.h"
+#include "series_block.h"
+
+// Milliseconds from a monotonic clock, used to stamp samples.
+int64_t getMetricTimeMs();
+
+// Aggregate of the samples that fell into one time bucket.
+struct MetricBucket
+{
+    float min = 0;
+    float max = 0;
+    float sum = 0;
+    int count = 0;
+
+    void add(float value);
+    void merge(const MetricBucket& other);
+    float avg() const { return count > 0 ? sum / count : 0; }
+};
+
+// Ring of fixed duration buckets, the newest one is still open.
+struct MetricTier
+{
+    int64_t bucketMs = 0;
+    std::vector<MetricBucket> buckets;
+    int head = 0;           // position of the open bucket
+    int count = 0;          // number of buckets in use, including the open one
+    int64_t headStart = 0;  // start time of the open bucket
+
+    void setup(int64_t bucketMs, int capacity);
+    void add(int64_t timeMs, float value);
+    void reset();
+
+    int64_t span() const { return bucketMs * (int64_t)buckets.size(); }
+};
+
+// Time weighted statistics of the samples in a time window.
+struct WindowStats
+{
+    float min = 0;
+    float max = 0;
+    float mean = 0;
+    int64_t durationMs = 0; // time covered by the samples
+    int count = 0;
+};
+
+// Fixed capacity ring buffer of timestamped samples, push() is O(1) regardless of the capacity.
+// Every sample also feeds a pyramid of coarser tiers so hours of history stay in bounded memory,
+// a quantile sketch and a compressed archive of the raw samples.
+struct MetricSeries
+{
+    static const int TIER_COUNT = 3;
+    // nominal sampling period, only used to size the default view
+    static const int RAW_PERIOD_MS = 100;
+    // escape in deltas, the gap was too long for 16 bits and is kept in longDeltas
+    static const uint16_t LONG_DELTA = 0xFFFF;
+
+    std::vector<float> values;
+    std::vector<uint16_t> deltas;   // ms since the previous sample
+    // ring slot and length of the gaps of LONG_DELTA ms or more, oldest first, a handful at most
+    std::vector<std::pair<int, int64_t>> longDeltas;
+    int head = 0;                   // next write position
+    int count = 0;                  // number of valid samples
+    bool hasEvicted = false;        // samples were overwritten, the ring no longer holds everything so far
+    int64_t newestTime = 0;         // timestamp of the newest sample
+    int64_t oldestTime = 0;         // timestamp of the oldest sample still in the ring
+
+    // 1s, 10s and 1min buckets
+    MetricTier tiers[TIER_COUNT];
+    // p50 / p95 / p99 over the session and the last minute
+    MetricSketch sketch;
+    // every raw sample of the retention window, compressed
+    CompressedHistory archive;
+
+    void setCapacity(int capacity);
+    // a longer ring keeping every sample, smaller capacities are ignored
+    void grow(int capacity);
+    int capacity() const { return (int)values.size(); }
+
+    void push(float value, int64_t timeMs);
+    void reset();
+
+    // ms between the sample in slot idx and the previous one
+    int64_t deltaAt(int idx) const;
+
+    // i-th sample of the last n, 0 is the oldest one; zero when not filled yet
+    float latest(int i, int n) const;
+    float back() const { return count > 0 ? values[(head + capacity() - 1) % capacity()] : 0; }
+    // mean interval between the samples of the ring, the effective sampling period
+    float samplePeriodMs() const { return count > 1 ? float(newestTime - oldestTime) / (count - 1) : 0; }
+
+    // Copies the last n samples into dst in chronological order, zero-padded in front.
+    // The ring is split at the wrap-around point so it costs at most two memcpy.
+    void copyLatest(float* dst, int n) const;
+
+    // Fills n points evenly spaced in time over the last spanMs milliseconds before nowMs,
+    // points without a sample hold the previous value.
+    // Short spans come from the raw ring, longer ones from the finest tier that covers them,
+    // so the cost is bounded by the tier capacity whatever the span.
+    void resample(float* dst, int n, int64_t spanMs, int64_t nowMs) const;
+
+    // Stats over [beginMs, endMs], every sample weighted by the time since the previous one
+    // so uneven sampling does not bias the mean. Windows older than the raw ring are decoded
+    // from the archive.
+    WindowStats query(int64_t beginMs, int64_t endMs) const;
+};
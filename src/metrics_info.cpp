@@ -1,133 +1,525 @@
-#include "../3rdparty/CImg.h"
-#include "metrics_info.h"
-#include "../3rdparty/imgui/imgui.h"
-
-using namespace cimg_library;
-using namespace std;
-
-MetaType kMetricMetas[METRIC_COUNT] =
-{
-    {"SM", "%"},
-    {"RAM", "%"},
-    {"MEM", "%"},
-    {"PCIE", "%"},
-    {"TEMP", "C"},
-    {"POWER", "W"},
-    {"ENC", "%"},
-    {"DEC", "%"},
-    {"PCIE RX", "%"},
-    {"SM CLK", "%"},
-    {"MEM CLK", "%"},
-    {"NVLK TX", "%"},
-    {"NVLK RX", "%"},
-
-    {"CPU", "%"},
-    {"RAM", "%"},
-    {"DISK R", "%"},
-    {"DISK W", "%"},
-    {"NET R", "%"},
-    {"NET W", "%"},
-
-    {"", ""},
-    {"", ""},
-    {"", ""},
-    {"", ""},
-    {"", ""},
-    {"", ""},
-};
-
-const size_t COLOR_COUNT = _countof(colors);
-
-void MetricsInfo::addMetric(MetricType type, float value)
-{
-    metrics_sum[type] -= metrics[type][0];
-    metrics_sum[type] += value;
-
-    if (valid_element_count[type] < MetricsInfo::HISTORY_COUNT)
-        valid_element_count[type]++;
-    metrics_avg[type] = metrics_sum[type] / valid_element_count[type];
-    for (int i = 0; i < HISTORY_COUNT - 1; i++)
-        metrics[type][i] = metrics[type][i + 1];
-    metrics[type][HISTORY_COUNT - 1] = value;
-}
-
-extern int global_mouse_x;
-extern int global_mouse_y;
-
-void MetricsInfo::draw(shared_ptr<CImgDisplay> window, CImg<unsigned char>& img, int beginMetricId, int endMetricId, bool show_legends)
-{
-    const int plotType = 1;
-    const int vertexType = 1;
-    const float alpha = 0.5f;
-
-    unsigned int hatch = 0xF0F0F0F0;
-
-    // metrics charts
-    for (int k = beginMetricId; k <= endMetricId; k++)
-    {
-        CImg<float> plot(metrics[k], MetricsInfo::HISTORY_COUNT, 1);
-        img.draw_graph(plot, colors[(k - beginMetricId) % COLOR_COUNT], alpha, plotType, vertexType, 102, 0);
-    }
-
-    const float kMargin = 0.4;
-    // avg summary
-    if (show_legends)
-    {
-        for (int k = beginMetricId; k <= endMetricId; k++)
-        {
-            img.draw_text(FONT_HEIGHT * kMargin, FONT_HEIGHT * (k - beginMetricId + kMargin),
-                "%s: %.1f%s\n",
-			    colors[(k - beginMetricId) % COLOR_COUNT], 0, 1, FONT_HEIGHT,
-                kMetricMetas[k].name.c_str(),
-                metrics_avg[k],
-                kMetricMetas[k].suffix.c_str());
-        }
-    }
-
-    // point tooltip
-    if (global_mouse_x >= 0 && global_mouse_y >= 0)
-    {
-        auto value_idx = global_mouse_x / 2;
-        if (show_legends)
-        {
-            for (int k = beginMetricId; k <= endMetricId; k++)
-            {
-                img.draw_text(window->window_width() - 60, FONT_HEIGHT * (k - beginMetricId + kMargin),
-                    "|%.1f%s\n",
-                    colors[(k - beginMetricId) % COLOR_COUNT], 0, 1, FONT_HEIGHT,
-                    metrics[k][value_idx],
-                    kMetricMetas[k].suffix.c_str()
-                );
-            }
-        }
-        img.draw_line(global_mouse_x, 0, global_mouse_x, window->height() - 1, colors[0], 0.5f, hatch = cimg::rol(hatch));
-    }
-}
-
-void MetricsInfo::resetMetric(MetricType type)
-{
-    valid_element_count[type] = 0;
-    metrics_sum[type] = 0;
-    metrics_avg[type] = 0;
-    for (int k = 0; k < MetricsInfo::HISTORY_COUNT; k++)
-    {
-        metrics[type][k] = 0;
-    }
-}
-
-void MetricsInfo::drawImgui(const char* panelName, int beginMetricId, int endMetricId)
-{
-    for (int k = beginMetricId; k <= endMetricId; k++)
-    {
-        char label[128];
-        sprintf(label, "%s - %s", panelName, kMetricMetas[k].name.c_str());
-        char overlay[32];
-        sprintf(overlay, "avg %.1f%s", metrics_avg[k], kMetricMetas[k].suffix.c_str());
-        ImGui::PlotLines(label, metrics[k], MetricsInfo::HISTORY_COUNT, 0, overlay, 0.0f, 30, ImVec2(0, 60));
-        //img.draw_text(window->window_width() - 100, FONT_HEIGHT * (k - beginMetricId + 1),
-        //    absoluteValue ? "|%.1f\n" : "|%.1f%%\n",
-        //    colors[k % COLOR_COUNT], 0, 1, FONT_HEIGHT,
-        //    metrics[k][value_idx]);
-    }
-    //img.draw_line(global_mouse_x, 0, global_mouse_x, window->height() - 1, colors[0], 0.5f, hatch = cimg::rol(hatch));
-}
+#include "../3rdparty/CImg.h"
+#include "metrics_info.h"
+#include "recorder.h"
+#include "self_profile.h"
+#include "../3rdparty/imgui/imgui.h"
+#include <chrono>
+
+using namespace cimg_library;
+using namespace std;
+
+const size_t COLOR_COUNT = _countof(colors);
+
+// p50, p95, p99 and p99.9
+const float kQuantiles[] = { 0.5f, 0.95f, 0.99f, 0.999f };
+// the legend average covers the default view
+const int64_t kAverageWindowMs = (int64_t)DISPLAY_COUNT * MetricSeries::RAW_PERIOD_MS;
+
+int MetricsInfo::historyCapacity = MetricsInfo::DISPLAY_COUNT;
+bool MetricsInfo::isPublishEnabled = true;
+
+MetricsInfo::MetricsInfo() : snapshots(make_unique<SnapshotBuffer<MetricsSnapshot>>()), events(make_unique<EventTrack>())
+{
+}
+
+MetricHandle MetricsInfo::addSeries(const char* source, int device, const string& name, const char* unit)
+{
+    auto handle = registerMetric(source, device, name, unit);
+    if (handle == INVALID_METRIC)
+        return handle;
+    handles.push_back(handle);
+
+    if (!recording)
+        recording = recorder_add_queue();
+    if (recording)
+        recording->declare(handle, getMetricKey(handle));
+    return handle;
+}
+
+void MetricsInfo::removeSeries(MetricHandle handle)
+{
+    auto it = find(handles.begin(), handles.end(), handle);
+    if (it == handles.end())
+        return;
+    handles.erase(it);
+    releaseMetric(handle);
+}
+
+int MetricsInfo::indexOf(MetricHandle handle) const
+{
+    auto it = find(handles.begin(), handles.end(), handle);
+    return it == handles.end() || handle == INVALID_METRIC ? -1 : int(it - handles.begin());
+}
+
+void MetricsInfo::addMetric(MetricHandle handle, float value)
+{
+    addMetric(handle, value, getMetricTimeMs());
+}
+
+void MetricsInfo::addMetric(MetricHandle handle, float value, int64_t timeMs)
+{
+    if (handle == INVALID_METRIC)
+        return;
+    auto& s = getMetricSeries(handle);
+    if (s.capacity() == 0)
+        s.setCapacity((std::max)(historyCapacity, DISPLAY_COUNT));
+    s.push(value, timeMs);
+    // a series sampled faster than RAW_PERIOD_MS gets a ring covering the default view at its own rate,
+    // resample() would fall back to the 1 s tier otherwise
+    const int64_t defaultSpanMs = (int64_t)DISPLAY_COUNT * MetricSeries::RAW_PERIOD_MS;
+    if (s.count == s.capacity() && s.capacity() < MAX_HISTORY_CAPACITY && s.newestTime - s.oldestTime < defaultSpanMs)
+    {
+        float periodMs = (std::max)(s.samplePeriodMs(), 1.0f);
+        // a tenth more, the period wanders a bit
+        int needed = int(defaultSpanMs / periodMs * 1.1f) + 1;
+        s.grow((std::min)(needed, MAX_HISTORY_CAPACITY));
+    }
+    if (recording)
+        recording->push(handle, timeMs, value);
+}
+
+void MetricsInfo::addEvent(int64_t timeMs, int severity, const string& text)
+{
+    events->add(timeMs, severity, text);
+}
+
+int MetricsInfo::addBandTrack(const string& name, const vector<string>& bitNames, MetricHandle below)
+{
+    BandTrack band;
+    band.name = name;
+    band.bitNames = bitNames;
+    band.below = below;
+    bandTracks.push_back(move(band));
+    return (int)bandTracks.size() - 1;
+}
+
+void MetricsInfo::setBands(int track, uint32_t mask)
+{
+    if (track >= 0 && track < (int)bandTracks.size())
+        bandTracks[track].track.set(getMetricTimeMs(), mask);
+}
+
+void MetricsInfo::addGap(int64_t beginMs, int64_t endMs)
+{
+    if (!gaps.empty() && gaps.back().beginMs == beginMs)
+    {
+        gaps.back().endMs = max(gaps.back().endMs, endMs);
+        return;
+    }
+    gaps.push_back({ beginMs, endMs });
+    if (gaps.size() > MAX_GAPS)
+        gaps.pop_front();
+}
+
+extern int global_mouse_x;
+extern int global_mouse_y;
+extern atomic<int64_t> global_view_span_ms;
+
+namespace
+{
+    // totals over all panels for the history stats
+    atomic<int64_t> totalArchiveSamples;
+    atomic<int64_t> totalArchiveBytes;
+    // info, warning, critical
+    const uint8_t eventColors[][3] =
+    {
+        { 150, 150, 150 },
+        { 230, 160, 30 },
+        { 235, 45, 45 },
+    };
+
+    const uint8_t* getEventColor(int severity)
+    {
+        return eventColors[min(max(severity, 0), (int)_countof(eventColors) - 1)];
+    }
+
+    // shade of the gaps
+    const uint8_t kGapColor[3] = { 200, 60, 200 };
+
+    // one per bit of a band track
+    const uint8_t bandColors[][3] =
+    {
+        { 120, 120, 120 },
+        { 70, 130, 220 },
+        { 240, 150, 30 },
+        { 220, 40, 40 },
+        { 170, 90, 210 },
+        { 240, 220, 40 },
+        { 150, 20, 20 },
+        { 230, 60, 200 },
+        { 40, 190, 180 },
+    };
+
+    const uint8_t* getBandColor(int bit)
+    {
+        return bandColors[bit % _countof(bandColors)];
+    }
+
+    const float kBandRowHeight = 5;
+
+    // bumped by the "Measure decode" button, every panel decodes its archive on its next publish
+    atomic<int> decodeRequest;
+    atomic<int64_t> decodedSamples;
+    atomic<int64_t> decodeNs;
+}
+
+bool MetricsInfo::isDefaultSpan()
+{
+    return global_view_span_ms == (int64_t)DISPLAY_COUNT * MetricSeries::RAW_PERIOD_MS;
+}
+
+void MetricsInfo::publish()
+{
+    if (!isPublishEnabled)
+        return;
+    PROFILE_ZONE("MetricsInfo::publish");
+    auto& snapshot = snapshots->writeBuffer();
+    auto now = getMetricTimeMs();
+    int64_t spanMs = global_view_span_ms;
+    snapshot.epoch = ++epoch;
+    snapshot.spanMs = spanMs;
+    snapshot.series.resize(handles.size());
+
+    int64_t samples = 0;
+    int64_t bytes = 0;
+    for (size_t k = 0; k < handles.size(); k++)
+    {
+        const auto& key = getMetricKey(handles[k]);
+        const auto& s = getMetricSeries(handles[k]);
+        auto& dst = snapshot.series[k];
+        dst.name = key.name;
+        dst.unit = key.unit;
+        dst.avg = s.query(now - kAverageWindowMs, now).mean;
+        dst.periodMs = s.samplePeriodMs();
+        s.sketch.windowQuantiles(kQuantiles, dst.quantiles, 4, MetricSketch::WINDOW_MS);
+        s.sketch.sessionQuantiles(kQuantiles, dst.sessionQuantiles, 4);
+        s.resample(dst.points, DISPLAY_COUNT, spanMs, now);
+        dst.visible = reduceSpan(dst.points, DISPLAY_COUNT);
+        samples += s.archive.sampleCount();
+        bytes += s.archive.bytes();
+    }
+    events->query(now - spanMs, now, &visibleEvents);
+    snapshot.events.resize(visibleEvents.size());
+    for (size_t k = 0; k < visibleEvents.size(); k++)
+    {
+        auto& dst = snapshot.events[k];
+        dst.x = float(visibleEvents[k].timeMs - (now - spanMs)) / spanMs;
+        dst.severity = visibleEvents[k].severity;
+        dst.text = visibleEvents[k].text;
+    }
+
+    snapshot.bands.resize(bandTracks.size());
+    for (size_t b = 0; b < bandTracks.size(); b++)
+    {
+        const auto& src = bandTracks[b];
+        auto& dst = snapshot.bands[b];
+        dst.name = src.name;
+        dst.bitNames = src.bitNames;
+        auto it = find(handles.begin(), handles.end(), src.below);
+        dst.below = it == handles.end() ? -1 : int(it - handles.begin());
+        dst.mask = src.track.changes.empty() ? 0 : src.track.changes.back().mask;
+        dst.visibleBits = 0;
+        dst.spans.clear();
+        src.track.query(now - spanMs, now, &visibleChanges);
+        uint32_t namedBits = src.bitNames.size() >= 32 ? ~0u : (1u << src.bitNames.size()) - 1;
+        for (size_t c = 0; c < visibleChanges.size(); c++)
+        {
+            auto mask = visibleChanges[c].mask & namedBits;
+            float x0 = float(visibleChanges[c].timeMs - (now - spanMs)) / spanMs;
+            float x1 = c + 1 < visibleChanges.size() ? float(visibleChanges[c + 1].timeMs - (now - spanMs)) / spanMs : 1.0f;
+            dst.visibleBits |= mask;
+            for (int bit = 0; bit < (int)src.bitNames.size(); bit++)
+            {
+                if (mask & (1u << bit))
+                    dst.spans.push_back({ x0, x1, bit });
+            }
+        }
+    }
+
+    snapshot.gaps.clear();
+    for (const auto& gap : gaps)
+    {
+        if (gap.endMs < now - spanMs || gap.beginMs > now)
+            continue;
+        float x0 = float(max(gap.beginMs, now - spanMs) - (now - spanMs)) / spanMs;
+        float x1 = float(min(gap.endMs, now) - (now - spanMs)) / spanMs;
+        snapshot.gaps.push_back({ x0, x1, gap.endMs - gap.beginMs });
+    }
+
+    totalArchiveSamples += samples - archiveSamples;
+    totalArchiveBytes += bytes - archiveBytes;
+    archiveSamples = samples;
+    archiveBytes = bytes;
+
+    int request = decodeRequest;
+    if (request != decodeRequestSeen)
+    {
+        decodeRequestSeen = request;
+        int64_t decoded = 0;
+        double checksum = 0;
+        auto t0 = chrono::steady_clock::now();
+        for (auto handle : handles)
+        {
+            getMetricSeries(handle).archive.forEach(INT64_MIN, INT64_MAX, [&](int64_t, float v)
+            {
+                checksum += v;
+                decoded++;
+            });
+        }
+        decodeNs += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - t0).count();
+        decodedSamples += decoded;
+        (void)checksum;
+    }
+
+    snapshots->publish();
+}
+
+void MetricsInfo::draw(shared_ptr<CImgDisplay> window, CImg<unsigned char>& img, int beginIdx, int endIdx, bool show_legends)
+{
+    PROFILE_ZONE("MetricsInfo::draw");
+    const auto& snapshot = snapshots->read();
+    const auto& series = snapshot.series;
+    int last = (int)series.size() - 1;
+    endIdx = endIdx < 0 ? last : min(endIdx, last);
+
+    const int plotType = 1;
+    const int vertexType = 1;
+    const float alpha = 0.5f;
+
+    unsigned int hatch = 0xF0F0F0F0;
+
+    // metrics charts
+    for (int k = beginIdx; k <= endIdx; k++)
+    {
+        // percentages keep a fixed scale, anything above 100 is scaled to fit
+        CImg<float> plot(series[k].points, DISPLAY_COUNT, 1);
+        float ymax = max(102.0f, series[k].visible.max * 1.02f);
+        img.draw_graph(plot, colors[(k - beginIdx) % COLOR_COUNT], alpha, plotType, vertexType, ymax, 0);
+    }
+
+    // no data
+    for (const auto& gap : snapshot.gaps)
+    {
+        int x0 = int(gap.x0 * (img.width() - 1));
+        int x1 = max(int(gap.x1 * (img.width() - 1)), x0 + 1);
+        img.draw_rectangle(x0, 0, x1, img.height() - 1, kGapColor, 0.3f);
+    }
+
+    // event annotations, labelled from the bottom so they stay clear of the legends
+    int row = 0;
+    for (const auto& e : snapshot.events)
+    {
+        int x = int(e.x * (img.width() - 1));
+        img.draw_line(x, 0, x, img.height() - 1, getEventColor(e.severity), 0.8f);
+        if (show_legends)
+        {
+            img.draw_text(x + 2, img.height() - FONT_HEIGHT * (2 + row % 3), "%s",
+                getEventColor(e.severity), 0, 1, FONT_HEIGHT, e.text.c_str());
+            row++;
+        }
+    }
+
+    const float kMargin = 0.4;
+    // avg and last minute p95 / p99
+    if (show_legends)
+    {
+        for (int k = beginIdx; k <= endIdx; k++)
+        {
+            const auto& s = series[k];
+            img.draw_text(FONT_HEIGHT * kMargin, FONT_HEIGHT * (k - beginIdx + kMargin),
+                "%s: %.1f%s  p95 %.1f  p99 %.1f\n",
+			    colors[(k - beginIdx) % COLOR_COUNT], 0, 1, FONT_HEIGHT,
+                s.name.c_str(),
+                s.avg,
+                s.unit.c_str(),
+                s.quantiles[1], s.quantiles[2]);
+        }
+    }
+
+    // point tooltip
+    if (global_mouse_x >= 0 && global_mouse_y >= 0)
+    {
+        auto value_idx = min(global_mouse_x / 2, DISPLAY_COUNT - 1);
+        if (show_legends)
+        {
+            for (int k = beginIdx; k <= endIdx; k++)
+            {
+                img.draw_text(window->window_width() - 60, FONT_HEIGHT * (k - beginIdx + kMargin),
+                    "|%.1f%s\n",
+                    colors[(k - beginIdx) % COLOR_COUNT], 0, 1, FONT_HEIGHT,
+                    series[k].points[value_idx],
+                    series[k].unit.c_str()
+                );
+            }
+        }
+        img.draw_line(global_mouse_x, 0, global_mouse_x, window->height() - 1, colors[0], 0.5f, hatch = cimg::rol(hatch));
+    }
+
+    if (show_legends && snapshot.spanMs != (int64_t)DISPLAY_COUNT * MetricSeries::RAW_PERIOD_MS)
+    {
+        char spanName[32];
+        formatSpan(spanName, snapshot.spanMs);
+        img.draw_text(FONT_HEIGHT * kMargin, window->height() - FONT_HEIGHT * (1 + kMargin),
+            "last %s", colors[0], 0, 1, FONT_HEIGHT, spanName);
+    }
+}
+
+void MetricsInfo::formatSpan(char* buf, int64_t spanMs)
+{
+    if (spanMs >= 3600 * 1000)
+        sprintf(buf, "%dh", int(spanMs / (3600 * 1000)));
+    else if (spanMs >= 60 * 1000)
+        sprintf(buf, "%dmin", int(spanMs / (60 * 1000)));
+    else
+        sprintf(buf, "%ds", int(spanMs / 1000));
+}
+
+void MetricsInfo::resetMetric(MetricHandle handle)
+{
+    if (handle != INVALID_METRIC)
+        getMetricSeries(handle).reset();
+}
+
+namespace
+{
+    void drawBandsImgui(const BandSnapshot& band, float innerX, float innerWidth)
+    {
+        // one row per bit that shows up in the visible span
+        int rowOf[32];
+        int rows = 0;
+        for (int bit = 0; bit < 32; bit++)
+            rowOf[bit] = band.visibleBits & (1u << bit) ? rows++ : -1;
+        if (rows == 0)
+            return;
+
+        auto top = ImGui::GetCursorScreenPos();
+        ImGui::Dummy(ImVec2(innerX + innerWidth - top.x, rows * kBandRowHeight));
+        auto drawList = ImGui::GetWindowDrawList();
+        for (const auto& span : band.spans)
+        {
+            auto c = getBandColor(span.bit);
+            float y = top.y + rowOf[span.bit] * kBandRowHeight;
+            drawList->AddRectFilled(ImVec2(innerX + span.x0 * innerWidth, y),
+                ImVec2(innerX + span.x1 * innerWidth, y + kBandRowHeight - 1), IM_COL32(c[0], c[1], c[2], 255));
+        }
+
+        if (ImGui::IsItemHovered())
+        {
+            ImGui::BeginTooltip();
+            ImGui::Text("%s", band.name.c_str());
+            for (int bit = 0; bit < (int)band.bitNames.size() && bit < 32; bit++)
+            {
+                if (rowOf[bit] < 0)
+                    continue;
+                auto c = getBandColor(bit);
+                ImGui::TextColored(ImVec4(c[0] / 255.0f, c[1] / 255.0f, c[2] / 255.0f, 1), "%s%s",
+                    band.bitNames[bit].c_str(), band.mask & (1u << bit) ? "  (now)" : "");
+            }
+            ImGui::EndTooltip();
+        }
+    }
+}
+
+void MetricsInfo::drawImgui(const char* panelName, int beginIdx, int endIdx)
+{
+    PROFILE_ZONE("MetricsInfo::drawImgui");
+    const auto& snapshot = snapshots->read();
+    const auto& series = snapshot.series;
+    int last = (int)series.size() - 1;
+    endIdx = endIdx < 0 ? last : min(endIdx, last);
+    const float kPlotHeight = 60;
+    for (int k = beginIdx; k <= endIdx; k++)
+    {
+        const auto& s = series[k];
+        char label[128];
+        snprintf(label, sizeof(label), "%s - %s", panelName, s.name.c_str());
+        char overlay[128];
+        snprintf(overlay, sizeof(overlay), "avg %.1f%s  p50 %.1f  p95 %.1f  p99 %.1f  p99.9 %.1f  every %.0f ms",
+            s.avg, s.unit.c_str(), s.quantiles[0], s.quantiles[1], s.quantiles[2], s.quantiles[3], s.periodMs);
+        float scaleMax = max(s.visible.max * 1.1f, 1.0f);
+        float plotWidth = ImGui::CalcItemWidth();
+        ImGui::PlotLines(label, s.points, DISPLAY_COUNT, 0, overlay, 0.0f, scaleMax, ImVec2(0, kPlotHeight));
+
+        // the event annotations over the plot frame
+        auto frameMin = ImGui::GetItemRectMin();
+        auto padding = ImGui::GetStyle().FramePadding;
+        float innerX = frameMin.x + padding.x;
+        float innerWidth = plotWidth - padding.x * 2;
+        float hoveredX = ImGui::GetIO().MousePos.x;
+        auto drawList = ImGui::GetWindowDrawList();
+        for (const auto& gap : snapshot.gaps)
+        {
+            drawList->AddRectFilled(ImVec2(innerX + gap.x0 * innerWidth, frameMin.y + padding.y),
+                ImVec2(max(innerX + gap.x1 * innerWidth, innerX + gap.x0 * innerWidth + 1), frameMin.y + kPlotHeight - padding.y),
+                IM_COL32(kGapColor[0], kGapColor[1], kGapColor[2], 70));
+        }
+        for (const auto& e : snapshot.events)
+        {
+            auto c = getEventColor(e.severity);
+            float x = innerX + e.x * innerWidth;
+            drawList->AddLine(ImVec2(x, frameMin.y + padding.y), ImVec2(x, frameMin.y + kPlotHeight - padding.y),
+                IM_COL32(c[0], c[1], c[2], 220), 1.5f);
+        }
+
+        if (ImGui::IsItemHovered())
+        {
+            ImGui::BeginTooltip();
+            ImGui::Text("visible  min %.1f  max %.1f  mean %.1f  stddev %.1f\n"
+                "session  p50 %.1f  p95 %.1f  p99 %.1f  p99.9 %.1f\n"
+                "sampled every %.1f ms",
+                s.visible.min, s.visible.max, s.visible.mean(), s.visible.stddev(),
+                s.sessionQuantiles[0], s.sessionQuantiles[1], s.sessionQuantiles[2], s.sessionQuantiles[3],
+                s.periodMs);
+            for (const auto& gap : snapshot.gaps)
+            {
+                if (hoveredX >= innerX + gap.x0 * innerWidth && hoveredX <= innerX + gap.x1 * innerWidth)
+                    ImGui::TextColored(ImVec4(kGapColor[0] / 255.0f, kGapColor[1] / 255.0f, kGapColor[2] / 255.0f, 1),
+                        "no data, the source didn't answer for %.1f s", gap.durationMs / 1000.0f);
+            }
+            // the events under the mouse
+            for (const auto& e : snapshot.events)
+            {
+                if (fabsf(innerX + e.x * innerWidth - hoveredX) > 4)
+                    continue;
+                auto c = getEventColor(e.severity);
+                ImGui::TextColored(ImVec4(c[0] / 255.0f, c[1] / 255.0f, c[2] / 255.0f, 1), "%s", e.text.c_str());
+            }
+            ImGui::EndTooltip();
+        }
+
+        for (const auto& band : snapshot.bands)
+        {
+            if (band.below == k)
+                drawBandsImgui(band, innerX, innerWidth);
+        }
+    }
+}
+
+void MetricsInfo::drawHistoryStatsImgui()
+{
+    if (!ImGui::CollapsingHeader("History"))
+        return;
+
+    int64_t samples = totalArchiveSamples;
+    int64_t bytes = totalArchiveBytes;
+    ImGui::Text("%d series, %lld samples in %.1f KB", getMetricCount(), (long long)samples, bytes / 1024.0f);
+    ImGui::Text("reduction kernel: %s", getReduceKernelName());
+    if (bytes > 0)
+    {
+        // raw arrays take 4 bytes per float, 12 with a 64-bit timestamp
+        ImGui::Text("%.2f bytes/sample, %.1fx smaller than float arrays, %.1fx with timestamps",
+            double(bytes) / samples, 4.0 * samples / bytes, 12.0 * samples / bytes);
+    }
+
+    if (ImGui::Button("Measure decode"))
+    {
+        decodedSamples = 0;
+        decodeNs = 0;
+        decodeRequest++;
+    }
+    if (decodeNs > 0)
+    {
+        ImGui::SameLine();
+        ImGui::Text("%.1f M samples/s", decodedSamples * 1e3 / decodeNs);
+    }
+}
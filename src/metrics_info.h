@@ -1,77 +1,181 @@
-#pragma once
-
-#include "def.h"
-#include <memory>
-#include <string>
-#include "../3rdparty/CImg.h"
-
-enum MetricType
-{
-    METRIC_SM_SOL,
-    METRIC_FB_USAGE,
-    METRIC_MEM_SOL,
-    METRIC_PCIE_SOL,
-    METRIC_GPU_TEMPERATURE,
-    METRIC_GPU_POWER,
-    METRIC_NVENC_SOL,
-    METRIC_NVDEC_SOL,
-    METRIC_PCIE_RX,
-    METRIC_SM_CLK,
-    METRIC_MEM_CLK,
-    METRIC_NVLINK_TX,
-    METRIC_NVLINK_RX,
-
-    METRIC_CPU_SOL,
-    METRIC_SYS_MEM_SOL,
-    METRIC_DISK_READ_SOL,
-    METRIC_DISK_WRITE_SOL,
-    METRIC_NET_READ_SOL,
-    METRIC_NET_WRITE_SOL,
-
-    METRIC_FPS_0,
-    METRIC_FPS_1,
-    METRIC_FPS_2,
-    METRIC_FPS_3,
-    METRIC_FPS_4,
-    METRIC_FPS_5,
-
-    METRIC_COUNT,
-};
-
-const uint8_t colors[][3] =
-{
-    { 255,255,255 },
-    { 195,38,114 },
-    { 69,203,209},
-    { 138,226,36 },
-    { 174,122,169 },
-    { 200,122,10 },
-    { 122,200,10 },
-    { 10,122,200 },
-    { 122,122,122 },
-    { 200,122,10 },
-    { 10,122,200 },
-};
-
-struct MetaType
-{
-    std::string name;
-    std::string suffix;
-};
-extern MetaType kMetricMetas[METRIC_COUNT];
-
-struct MetricsInfo
-{
-    static const int HISTORY_COUNT = WINDOW_W / 2;
-    float metrics[METRIC_COUNT][HISTORY_COUNT] = {};
-    float metrics_sum[METRIC_COUNT] = {};
-    float metrics_avg[METRIC_COUNT] = {};
-    int valid_element_count[METRIC_COUNT] = {};
-
-    void addMetric(MetricType type, float value);
-    void resetMetric(MetricType type);
-
-    void draw(std::shared_ptr<cimg_library::CImgDisplay> window, cimg_library::CImg<unsigned char>& img, 
-        int beginMetricId, int endMetricId, bool draw_legends = true);
-    void drawImgui(const char* panelName, int beginMetricId, int endMetricId);
-};
+#pragma once
+
+#include "def.h"
+#include <memory>
+#include <string>
+#include "../3rdparty/CImg.h"
+#include <vector>
+#include <deque>
+#include <atomic>
+#include "metric_registry.h"
+#include "snapshot.h"
+#include "simd_reduce.h"
+#include "event_track.h"
+
+struct SampleQueue;
+
+const uint8_t colors[][3] =
+{
+    { 255,255,255 },
+    { 195,38,114 },
+    { 69,203,209},
+    { 138,226,36 },
+    { 174,122,169 },
+    { 200,122,10 },
+    { 122,200,10 },
+    { 10,122,200 },
+    { 122,122,122 },
+    { 200,122,10 },
+    { 10,122,200 },
+};
+
+// What the renderers need from one series, built by the collector that owns it.
+struct SeriesSnapshot
+{
+    std::string name;
+    std::string unit;
+    // time weighted average of the last 20 seconds
+    float avg = 0;
+    // effective sampling period
+    float periodMs = 0;
+    // p50, p95, p99 and p99.9 over the last minute and over the session
+    float quantiles[4] = {};
+    float sessionQuantiles[4] = {};
+    // the visible time span resampled to one point per chart column
+    float points[DISPLAY_COUNT] = {};
+    // min / max / mean / stddev of points, also used for autoscaling
+    SpanStats visible;
+};
+
+// An event of the panel placed on its charts, x in [0, 1] across the visible time span.
+struct EventMarker
+{
+    float x = 0;
+    int severity = EVENT_INFO;
+    std::string text;
+};
+
+// The bits of a band track set at some point of the visible time span, x0 and x1 as in EventMarker.
+struct BandSpan
+{
+    float x0 = 0;
+    float x1 = 0;
+    int bit = 0;
+};
+
+// A stretch of the visible time span without samples because the source stopped answering,
+// x0 and x1 as in EventMarker.
+struct GapSpan
+{
+    float x0 = 0;
+    float x1 = 0;
+    int64_t durationMs = 0;     // the whole gap, part of it can be out of view
+};
+
+struct BandSnapshot
+{
+    std::string name;
+    std::vector<std::string> bitNames;
+    int below = -1;             // position of the series the bands are drawn under
+    uint32_t mask = 0;          // the latest one
+    uint32_t visibleBits = 0;   // every bit with a span
+    std::vector<BandSpan> spans;
+};
+
+struct MetricsSnapshot
+{
+    uint64_t epoch = 0;
+    int64_t spanMs = 0;
+    std::vector<SeriesSnapshot> series;
+    std::vector<EventMarker> events;
+    std::vector<BandSnapshot> bands;
+    std::vector<GapSpan> gaps;
+};
+
+// A panel of series drawn together, the series themselves live in the metric registry.
+// The collector owning the panel writes samples and publish()es a snapshot, renderers
+// only ever read the latest published snapshot so collectors can run on their own thread.
+struct MetricsInfo
+{
+    static const int DISPLAY_COUNT = ::DISPLAY_COUNT;
+    // number of samples kept per series, can be changed with -history before setup()
+    static int historyCapacity;
+    // the rings of the fast series grow up to this to cover the default view
+    static const int MAX_HISTORY_CAPACITY = 16 * DISPLAY_COUNT;
+    // cleared by -headless, nobody reads the snapshots then and publish() does nothing
+    static bool isPublishEnabled;
+
+    // in drawing order, owned by the collector
+    std::vector<MetricHandle> handles;
+    std::unique_ptr<SnapshotBuffer<MetricsSnapshot>> snapshots;
+    uint64_t epoch = 0;
+    // annotations, written by any thread
+    std::unique_ptr<EventTrack> events;
+    std::vector<TrackEvent> visibleEvents;
+
+    // a bitmask drawn as one row of colored bands per bit, under the chart of a series
+    struct BandTrack
+    {
+        std::string name;
+        std::vector<std::string> bitNames;
+        MetricHandle below = INVALID_METRIC;
+        BitmaskTrack track;
+    };
+    std::vector<BandTrack> bandTracks;
+    std::vector<BitmaskTrack::Change> visibleChanges;
+
+    // time ranges without samples, written by the collector owning the panel, oldest dropped past MAX_GAPS
+    static const int MAX_GAPS = 256;
+    struct Gap
+    {
+        int64_t beginMs;
+        int64_t endMs;
+    };
+    std::deque<Gap> gaps;
+
+    // contribution of this panel to the history stats
+    int64_t archiveSamples = 0;
+    int64_t archiveBytes = 0;
+    int decodeRequestSeen = 0;
+
+    // every sample also goes to the recorder when one is open
+    std::shared_ptr<SampleQueue> recording;
+
+    MetricsInfo();
+
+    MetricHandle addSeries(const char* source, int device, const std::string& name, const char* unit);
+    void removeSeries(MetricHandle handle);
+    int size() const { return (int)handles.size(); }
+    // position of the series in the panel, as draw() takes it, -1 when it isn't registered
+    int indexOf(MetricHandle handle) const;
+
+    void addMetric(MetricHandle handle, float value);
+    // a sample taken at timeMs, e.g. read back from a driver side buffer
+    void addMetric(MetricHandle handle, float value, int64_t timeMs);
+    void resetMetric(MetricHandle handle);
+    // thread safe, shows up on the charts with the next publish()
+    void addEvent(int64_t timeMs, int severity, const std::string& text);
+
+    // returns the track index for setBands(), bitNames[k] names bit k
+    int addBandTrack(const std::string& name, const std::vector<std::string>& bitNames, MetricHandle below);
+    void setBands(int track, uint32_t mask);
+
+    // the source didn't answer from beginMs to endMs, shaded over every chart of the panel.
+    // Extends the last gap when it starts at the same time, so an ongoing one can grow tick by tick.
+    void addGap(int64_t beginMs, int64_t endMs);
+
+    // collector side, makes the samples added so far visible to the renderers
+    void publish();
+
+    // renderer side, beginIdx and endIdx are positions in the panel, both inclusive, -1 is the last one
+    void draw(std::shared_ptr<cimg_library::CImgDisplay> window, cimg_library::CImg<unsigned char>& img, 
+        int beginIdx, int endIdx, bool draw_legends = true);
+    void drawImgui(const char* panelName, int beginIdx, int endIdx);
+
+    // true when the charts show the raw samples, i.e. the last DISPLAY_COUNT ticks
+    static bool isDefaultSpan();
+    static void formatSpan(char* buf, int64_t spanMs);
+
+    // compression ratio and decode throughput of the archived history
+    static void drawHistoryStatsImgui();
+};
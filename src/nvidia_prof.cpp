@@ -1,699 +1,2139 @@
-#include "nvidia_prof.h"
-#include <stdio.h>
-#include <assert.h>
-#include <string>
-#include <inttypes.h>
-#include "util_win32.h"
-#include <memory>
-#include <vector>
-
-#include "../3rdparty/CImg.h"
-#include "metrics_info.h"
-using namespace cimg_library;
-using namespace std;
-
-#include "../3rdparty/CUDA_SDK/nvml.h"
-
-//#define NV_PERF_ENABLE_INSTRUMENTATION
-
-#ifdef NV_PERF_ENABLE_INSTRUMENTATION
-#ifdef _WIN32
-// Suppress redifinition warnings
-//#undef APIENTRY
-// undef min and max from windows.h
-#define NOMINMAX
-#endif
-#include "windows-desktop-x64/nvperf_host_impl.h"
-#include "../3rdparty/NvPerfUtility/include/NvPerfReportGenerator.h"
-#include "../3rdparty/NvPerfUtility/include/NvPerfPeriodicSamplerGpu.h"
-#include "../3rdparty/NvPerfUtility/include/NvPerfOpenGL.h"
-
-//nv::perf::profiler::ReportGeneratorOpenGL m_nvperf;
-double m_nvperfWarmupTime = 0.5; // Wait 0.5s to allow the clock to stabalize before begining to profile
-NVPW_Device_ClockStatus m_clockStatus = NVPW_DEVICE_CLOCK_STATUS_UNKNOWN; // Used to restore clock state when exiting
-
-using namespace nv::perf;
-using namespace nv::perf::sampler;
-
-size_t nsightDeviceIndex = -1;
-
-size_t GetCompatibleGpuDeviceIndex()
-{
-    NVPW_GetDeviceCount_Params getDeviceCountParams = { NVPW_GetDeviceCount_Params_STRUCT_SIZE };
-    NVPA_Status nvpaStatus = NVPW_GetDeviceCount(&getDeviceCountParams);
-    if (nvpaStatus)
-    {
-        NV_PERF_LOG_ERR(50, "Failed NVPW_GetDeviceCount: %u\n", nvpaStatus);
-        return size_t(~0);
-    }
-
-    for (size_t deviceIndex = 0; deviceIndex < getDeviceCountParams.numDevices; ++deviceIndex)
-    {
-        if (GpuPeriodicSamplerIsGpuSupported(deviceIndex))
-        {
-            return deviceIndex;
-        }
-    }
-    return size_t(~0);
-}
-
-#endif
-
-// display information about the calling function and related error
-void ShowErrorDetails(const nvmlReturn_t nvRetVal, const char* pFunctionName);
-
-#define CHECK_NVML(nvRetValue, func) \
-            if (NVML_SUCCESS != nvRetValue) \
-            { \
-                if (nvRetValue != NVML_ERROR_NO_PERMISSION && nvRetValue != NVML_ERROR_NOT_SUPPORTED) \
-                { \
-                    ShowErrorDetails(nvRetValue, #func); \
-                } \
-            }
-
-#define ENTRY(func) decltype(func)  *_##func = NULL;
-#include "../3rdparty/CUDA_SDK/nvml.def"
-#undef ENTRY(func)
-
-bool LoadNVML()
-{
-    // Load the NVML DLL using the default NVML DLL install path
-    // NOTE: This DLL is included in the NVIDIA driver installation by default
-    static HINSTANCE hDLLhandle = NULL;
-    if (hDLLhandle) return true;
-
-    const char* nvmlFilenames[] =
-    {
-        "C:\\Program Files\\NVIDIA Corporation\\NVSMI\\NVML.DLL",
-        "C:\\Windows\\System32\\nvml.dll"
-    };
-    for (auto file : nvmlFilenames)
-    {
-        hDLLhandle = LoadLibraryA(file);
-        if (hDLLhandle) break;
-    }
-
-    // if the DLL can not be found, exit
-    if (NULL == hDLLhandle)
-    {
-        printf("NVML DLL is not installed or not found at the default path.\r\n");
-        return false;
-    }
-
-#define ENTRY(func) _##func = (decltype(func)*)GetProcAddress(hDLLhandle, #func);
-#include "../3rdparty/CUDA_SDK/nvml.def"
-#undef ENTRY(func)
-
-    return true;
-}
-
-int getUInt(nvmlDevice_t device, int fieldId, uint32_t* value)
-{
-    nvmlFieldValue_t fieldValue = {};
-    fieldValue.fieldId = fieldId;
-    nvmlReturn_t nvRetValue = NVML_ERROR_UNKNOWN;
-    nvRetValue = _nvmlDeviceGetFieldValues(device, 1, &fieldValue);
-    *value = 0;
-    CHECK_NVML(nvRetValue, nvmlDeviceGetFieldValues);
-    *value = fieldValue.value.uiVal;
-
-    return 0;
-}
-
-// display information about the calling function and related error
-void ShowErrorDetails(const nvmlReturn_t nvRetVal, const char* pFunctionName)
-{
-    auto pErrorDescription = _nvmlErrorString(nvRetVal);
-    fprintf(stderr, "[%s] - %s\r\n", pFunctionName, pErrorDescription);
-}
-
-struct ProcInfo
-{
-    unsigned int pid;
-    std::string exeName;
-    PROCESSENTRY32 cpuStats;
-    nvmlAccountingStats_t gpuStats;
-};
-
-struct NvidiaInfo
-{
-    shared_ptr<CImgDisplay> window;
-
-    uint32_t deviceId = 0;
-    nvmlDevice_t handle = NULL;
-    nvmlPciInfo_t pciInfo;
-    uint32_t numCores = 0;
-    uint32_t busWidth = 0;
-    uint32_t pcieLinkWidth = 0;
-    uint32_t pcieLinkGeneration = 0;
-    uint32_t pcieCurrentSpeed = 0;
-    nvmlDriverModel_t driverModel, pendingDriverModel;
-    nvmlBrandType_t brandType = NVML_BRAND_UNKNOWN;
-    nvmlDeviceArchitecture_t deviceArch = NVML_DEVICE_ARCH_UNKNOWN;
-    char cDevicename[NVML_DEVICE_NAME_BUFFER_SIZE] = { '\0' };
-    uint32_t numLinks;
-    nvmlEnableState_t nvlinkActives[NVML_NVLINK_MAX_LINKS];
-    uint32_t nvlinkMaxSpeeds[NVML_NVLINK_MAX_LINKS];
-    nvmlPciInfo_t nvlinkPciInfos[NVML_NVLINK_MAX_LINKS];
-
-    std::vector<ProcInfo> ProcInfos;
-
-    // Flags to denote unsupported queries
-    bool bGPUUtilSupported = true;
-    bool bEncoderUtilSupported = true;
-    bool bDecoderUtilSupported = true;
-
-    nvmlEnableState_t bMonitorConnected = NVML_FEATURE_DISABLED;
-
-    MetricsInfo metrics;
-
-    int setup();
-
-    int update();
-
-    int updatePerProcessInfo();
-
-    void draw(bool show_legends);
-
-    void drawImgui()
-    {
-        metrics.drawImgui(cDevicename, METRIC_SM_SOL, METRIC_FB_USAGE);
-    }
-};
-
-int NvidiaInfo::setup()
-{
-    auto nvRetValue = _nvmlDeviceGetHandleByIndex_v2(deviceId, &handle);
-    CHECK_NVML(nvRetValue, nvmlDeviceGetHandleByIndex);
-
-    nvRetValue = _nvmlDeviceSetAccountingMode(handle, NVML_FEATURE_ENABLED);
-
-    printf("%d", deviceId);
-    nvRetValue = _nvmlDeviceGetPciInfo_v3(handle, &pciInfo);
-    CHECK_NVML(nvRetValue, nvmlDeviceGetPciInfo);
-    
-    nvRetValue = _nvmlDeviceGetDisplayMode(handle, &bMonitorConnected);
-    //CHECK_NVML(nvRetValue, nvmlDeviceGetDisplayMode);
-
-    // nvlink
-    getUInt(handle, NVML_FI_DEV_NVLINK_LINK_COUNT, &numLinks);
-    assert(numLinks <= NVML_NVLINK_MAX_LINKS);
-    for (int j = 0; j < numLinks; j++)
-    {
-        // TODO:
-        //bNVLinkSupported = true;
-        _nvmlDeviceGetNvLinkState(handle, j, &nvlinkActives[j]);
-        _nvmlDeviceGetNvLinkRemotePciInfo_v2(handle, j, &nvlinkPciInfos[j]);
-        getUInt(handle, NVML_FI_DEV_NVLINK_SPEED_MBPS_L0 + j, &nvlinkMaxSpeeds[j]);
-
-        for (int counter = 0; counter < 2; counter++)
-        {
-            unsigned int reset = 1;
-            nvmlNvLinkUtilizationControl_t control = { NVML_NVLINK_COUNTER_UNIT_BYTES, NVML_NVLINK_COUNTER_PKTFILTER_ALL };
-            nvRetValue = _nvmlDeviceSetNvLinkUtilizationControl(handle, j, counter, &control, reset);
-            //CHECK_NVML(nvRetValue, nvmlDeviceSetNvLinkUtilizationControl);
-        }
-    }
-
-    // Get driver mode, WDDM or TCC?
-    nvRetValue = _nvmlDeviceGetDriverModel(handle, &driverModel, &pendingDriverModel);
-    CHECK_NVML(nvRetValue, nvmlDeviceGetDriverModel);
-    static char* driverModelsString[] = { "WDDM", "TCC", "N/A" };
-    printf("\t%s", driverModelsString[driverModel]);
-
-    if (_nvmlDeviceGetNumGpuCores)
-    {
-        _nvmlDeviceGetNumGpuCores(handle, &numCores);
-        printf("\t%u", numCores);
-    }
-    else printf("\tN/A");
-
-    if (_nvmlDeviceGetMemoryBusWidth)
-    {
-        _nvmlDeviceGetMemoryBusWidth(handle, &busWidth);
-        printf("\t%u", busWidth);
-    }
-    else printf("\tN/A");
-
-    if (_nvmlDeviceGetCurrPcieLinkWidth && _nvmlDeviceGetCurrPcieLinkGeneration)
-    {
-        _nvmlDeviceGetCurrPcieLinkWidth(handle, &pcieLinkWidth);
-        _nvmlDeviceGetCurrPcieLinkGeneration(handle, &pcieLinkGeneration);
-        if (pcieLinkGeneration != 0)
-            printf("\t%u.0 x%u", pcieLinkGeneration, pcieLinkWidth);
-        else
-            printf("\tN/A");
-    }
-    else printf("\tN/A");
-
-    if (_nvmlDeviceGetPcieSpeed)
-    {
-        _nvmlDeviceGetPcieSpeed(handle, &pcieCurrentSpeed);
-        printf("\t%.0f", pcieCurrentSpeed / 1e3);
-    }
-    else printf("\tN/A");
-
-    // Get the device name
-    nvRetValue = _nvmlDeviceGetName(handle, cDevicename, NVML_DEVICE_NAME_BUFFER_SIZE);
-    CHECK_NVML(nvRetValue, nvmlDeviceGetName);
-
-    nvRetValue = _nvmlDeviceGetBrand(handle, &brandType);
-    //CHECK_NVML(nvRetValue, nvmlDeviceGetBrand);
-
-    char* brandName = "";
-#define ENTRY(type, desc) case type: brandName = desc; break;
-    switch (brandType)
-    {
-        ENTRY(NVML_BRAND_UNKNOWN, "UNKNOWN");
-        ENTRY(NVML_BRAND_QUADRO, "Quadro");
-        ENTRY(NVML_BRAND_TESLA, "Tesla");
-        ENTRY(NVML_BRAND_NVS, "NVS");
-        ENTRY(NVML_BRAND_GRID, "GRID");
-        ENTRY(NVML_BRAND_GEFORCE, "Geforce");
-        ENTRY(NVML_BRAND_TITAN, "Titan");
-        ENTRY(NVML_BRAND_NVIDIA_VAPPS, "vApps");
-        ENTRY(NVML_BRAND_NVIDIA_VPC, "vPC");
-        ENTRY(NVML_BRAND_NVIDIA_VCS, "vCS");
-        ENTRY(NVML_BRAND_NVIDIA_VWS, "vWS");
-        ENTRY(NVML_BRAND_NVIDIA_CLOUD_GAMING, "Cloud Gaming");
-        ENTRY(NVML_BRAND_QUADRO_RTX, "Quadro");
-        ENTRY(NVML_BRAND_NVIDIA_RTX, "NVIDIA");
-        ENTRY(NVML_BRAND_NVIDIA, "NVIDIA");
-        ENTRY(NVML_BRAND_GEFORCE_RTX, "Geforce RTX");
-        ENTRY(NVML_BRAND_TITAN_RTX, "Titan RTX");
-    }
-#undef ENTRY
-
-    nvRetValue = _nvmlDeviceGetArchitecture(handle, &deviceArch);
-    char* archName = "";
-#define ENTRY(type, desc) case type: archName = desc; break;
-    switch (deviceArch)
-    {
-        ENTRY(NVML_DEVICE_ARCH_KEPLER, "Kepler");
-        ENTRY(NVML_DEVICE_ARCH_MAXWELL, "Maxwell");
-        ENTRY(NVML_DEVICE_ARCH_PASCAL, "Pascal");
-        ENTRY(NVML_DEVICE_ARCH_VOLTA, "Volta");
-        ENTRY(NVML_DEVICE_ARCH_TURING, "Turing");
-        ENTRY(NVML_DEVICE_ARCH_AMPERE, "Ampere");
-        ENTRY(NVML_DEVICE_ARCH_ADA, "Ada");
-        ENTRY(NVML_DEVICE_ARCH_HOPPER, "Hopper");
-    }
-#undef ENTRY
-
-
-    printf("\t%s", archName);
-    printf("\t%s", brandName);
-    printf("\t%s", cDevicename);
-
-    printf("\n");
-
-    return 0;
-}
-
-int NvidiaInfo::update()
-{
-    nvmlReturn_t nvRetValue = NVML_SUCCESS;
-    nvmlUtilization_t nvUtilData = {};
-
-    // SM and MEM
-    {
-        // NOTE: nvUtil.memory is the memory controller utilization not the frame buffer utilization
-        nvRetValue = _nvmlDeviceGetUtilizationRates(handle, &nvUtilData);
-        if (nvRetValue == NVML_ERROR_NOT_SUPPORTED)
-        {
-            bGPUUtilSupported = false;
-        }
-        else if (nvRetValue == NVML_ERROR_UNINITIALIZED)
-        {
-#if 0
-            nvidia_cleanup();
-            nvidia_setup();
-#endif
-        }
-        //else CHECK_NVML(nvRetValue, nvmlDeviceGetUtilizationRates);
-        metrics.addMetric(METRIC_SM_SOL, nvUtilData.gpu);
-        metrics.addMetric(METRIC_MEM_SOL, nvUtilData.memory);
-    }
-
-    // Get the GPU frame buffer memory information
-    nvmlMemory_t GPUmemoryInfo = {};
-    nvRetValue = _nvmlDeviceGetMemoryInfo(handle, &GPUmemoryInfo);
-    CHECK_NVML(nvRetValue, nvmlDeviceGetMemoryInfo);
-
-    // verify that the uint64_t to unsigned long cast will not result in lost data
-    if (ULLONG_MAX < GPUmemoryInfo.total)
-    {
-        printf("ERROR: GPU memory size exceeds variable limit\n");
-        _nvmlShutdown();
-        return NVML_ERROR_NOT_SUPPORTED;
-    }
-
-    // convert the frame buffer value to KBytes
-    uint64_t ulFrameBufferTotalMBytes = (uint64_t)(GPUmemoryInfo.total / 1024L / 1024L);
-    uint64_t ulFrameBufferUsedMBytes = (uint64_t)(ulFrameBufferTotalMBytes - (GPUmemoryInfo.free / 1024L / 1024L));
-
-    // calculate the frame buffer memory utilization
-
-    metrics.addMetric(METRIC_FB_USAGE, ulFrameBufferUsedMBytes * 100.0f / ulFrameBufferTotalMBytes);
-
-    // power and temprature
-    {
-        uint32_t temp = 0;
-        nvRetValue = _nvmlDeviceGetTemperature(handle, NVML_TEMPERATURE_GPU, &temp);
-        CHECK_NVML(nvRetValue, nvmlDeviceGetTemperature);
-        metrics.addMetric(METRIC_GPU_TEMPERATURE, temp);
-
-        uint32_t power = 0;
-        nvRetValue = _nvmlDeviceGetPowerUsage(handle, &power);
-        CHECK_NVML(nvRetValue, nvmlDeviceGetPowerUsage);
-        metrics.addMetric(METRIC_GPU_POWER, power * 0.001f);
-
-#if 0
-        // BUG? fanSpeed is always 0
-        uint32_t fanSpeed = 0;
-        nvRetValue = _nvmlDeviceGetFanSpeed(handle, &fanSpeed);
-        CHECK_NVML(nvRetValue, nvmlDeviceGetFanSpeed);
-#endif
-    }
-
-    // Get the video encoder utilization (where supported)
-    uint32_t uiVidEncoderUtil = 0u;
-    uint32_t uiVideEncoderLastSample = 0u;
-    nvRetValue = _nvmlDeviceGetEncoderUtilization(handle, &uiVidEncoderUtil, &uiVideEncoderLastSample);
-    if (NVML_ERROR_NOT_SUPPORTED == nvRetValue)
-    {
-        bEncoderUtilSupported = false;
-    }
-    else CHECK_NVML(nvRetValue, nvmlDeviceGetEncoderUtilization);
-
-    // Get the video decoder utilization (where supported)
-    uint32_t uiVidDecoderUtil = 0u;
-    uint32_t uiVidDecoderLastSample = 0u;
-    nvRetValue = _nvmlDeviceGetDecoderUtilization(handle, &uiVidDecoderUtil, &uiVidDecoderLastSample);
-    if (NVML_ERROR_NOT_SUPPORTED == nvRetValue)
-    {
-        bDecoderUtilSupported = false;
-    }
-    else CHECK_NVML(nvRetValue, nvmlDeviceGetEncoderUtilization);
-
-    metrics.addMetric(METRIC_NVENC_SOL, uiVidEncoderUtil);
-    metrics.addMetric(METRIC_NVDEC_SOL, uiVidDecoderUtil);
-
-    // Clock
-    uint32_t clocks[NVML_CLOCK_COUNT] = {};
-    for (int i = 0; i < NVML_CLOCK_COUNT; i++)
-    {
-        nvRetValue = _nvmlDeviceGetClockInfo(handle, nvmlClockType_t(i), clocks + i);
-        if (NVML_ERROR_NOT_SUPPORTED == nvRetValue)
-        {
-
-        }
-        else CHECK_NVML(nvRetValue, nvmlDeviceGetClockInfo);
-    }
-
-    // pcie traffic
-    uint32_t pcieUtils[NVML_PCIE_UTIL_COUNT] = {};
-    uint32_t pcieUtilSum = 0;
-    for (int i = 0; i < NVML_PCIE_UTIL_COUNT; i++)
-    {
-        nvRetValue = _nvmlDeviceGetPcieThroughput(handle, nvmlPcieUtilCounter_t(i), pcieUtils + i);
-        if (NVML_ERROR_NOT_SUPPORTED == nvRetValue)
-        {
-
-        }
-        else CHECK_NVML(nvRetValue, nvmlDeviceGetPcieThroughput);
-
-        pcieUtilSum += pcieUtils[i];
-    }
-    float sol = pcieUtilSum * 0.1 / (pcieCurrentSpeed + 0.1f);
-    metrics.addMetric(METRIC_PCIE_SOL, sol);
-
-    // Output the utilization results depending on which of the counters has data available
-    // I have opted to display "-" to denote an unsupported value rather than simply display "0"
-    // to clarify that the GPU/driver does not support the query. 
-    printf("%d %s", deviceId, bMonitorConnected ? "<-" : "");
-
-    if (bGPUUtilSupported) printf("\t%d\t%d", nvUtilData.gpu, nvUtilData.memory);
-    else printf("\t-\t-");
-    printf("\t%lld / %lld", ulFrameBufferUsedMBytes, ulFrameBufferTotalMBytes);
-    printf("\t%-5d\t%-6d", clocks[NVML_CLOCK_SM], clocks[NVML_CLOCK_MEM]);
-    printf("\t%-6d\t%-6d", pcieUtils[NVML_PCIE_UTIL_TX_BYTES] / 1024L, pcieUtils[NVML_PCIE_UTIL_RX_BYTES] / 1024L);
-
-#if 0
-    if (bEncoderUtilSupported) printf("\t%d", uiVidEncoderUtil);
-    else printf("\t-");
-    if (bDecoderUtilSupported) printf("\t%d", uiVidDecoderUtil);
-    else printf("\t-");
-#endif
-    //if (bNVLinkSupported)
-    if (nvlinkActives[0])
-    {
-        //for (int j = 0; j < info.numLinks; j++)
-        int j = 0;
-        uint32_t counter = 0;
-        uint64_t rxcounter = 0;
-        uint64_t txcounter = 0;
-        nvRetValue = _nvmlDeviceGetNvLinkUtilizationCounter(handle, j, counter, &rxcounter, &txcounter);
-        if (NVML_ERROR_NOT_SUPPORTED == nvRetValue)
-        {
-        }
-        else
-            CHECK_NVML(nvRetValue, nvmlDeviceGetNvLinkUtilizationCounter);
-        rxcounter /= 1024L;
-        txcounter /= 1024L;
-        printf("\t%-5d\t%-5d", txcounter, rxcounter);
-        metrics.addMetric(METRIC_NVLINK_TX, txcounter);
-        metrics.addMetric(METRIC_NVLINK_RX, rxcounter);
-    }
-
-    updatePerProcessInfo();
-
-    return 0;
-}
-
-int NvidiaInfo::updatePerProcessInfo()
-{
-    nvmlReturn_t ret;
-#if 0
-    // nvmlDeviceGetGraphicsRunningProcesses and nvmlDeviceGetComputeRunningProcesses gives wrong results
-    {
-        unsigned int infoCount = 0;
-        ret = _nvmlDeviceGetGraphicsRunningProcesses(handle, &infoCount, nullptr);
-        if (ret == NVML_ERROR_INSUFFICIENT_SIZE || ret == NVML_SUCCESS)
-        {
-            vector<nvmlProcInfo_t> infos(infoCount);
-            ret = _nvmlDeviceGetGraphicsRunningProcesses(handle, &infoCount, infos.data());
-            int a = 0;
-        }
-    }
-    {
-        unsigned int infoCount = 0;
-        ret = _nvmlDeviceGetComputeRunningProcesses(handle, &infoCount, nullptr);
-        if (ret == NVML_ERROR_INSUFFICIENT_SIZE || ret == NVML_SUCCESS)
-        {
-            vector<nvmlProcInfo_t> infos(infoCount);
-            ret = _nvmlDeviceGetComputeRunningProcesses(handle, &infoCount, infos.data());
-            int a = 0;
-        }
-    }
-#endif
-    nvmlEnableState_t mode;
-    ret = _nvmlDeviceGetAccountingMode(handle, &mode);
-    if (mode == NVML_FEATURE_DISABLED)
-        return ret;
-
-    ProcInfos.clear();
-    unsigned int pidCount = 0;
-    ret = _nvmlDeviceGetAccountingPids(handle, &pidCount, nullptr);
-    if (pidCount > 0)
-    {
-        vector<unsigned int> pids(pidCount);
-        ret = _nvmlDeviceGetAccountingPids(handle, &pidCount, pids.data());
-        CHECK_NVML(ret, nvmlDeviceGetAccountingPids);
-        for (auto pid : pids)
-        {
-            nvmlAccountingStats_t gpuStats;
-            ret = _nvmlDeviceGetAccountingStats(handle, pid, &gpuStats);
-            CHECK_NVML(ret, nvmlDeviceGetAccountingStats);
-            if (gpuStats.isRunning && (gpuStats.gpuUtilization > 0 || gpuStats.memoryUtilization > 0))
-            {
-#if 0
-                char name[80];
-                nvmlSystemGetProcessName(pid, name, 80);
-#endif
-                auto cpuStats = getEntryFromPID(pid);
-                auto p = ProcInfo();
-                p.pid = pid;
-                p.exeName = cpuStats.szExeFile;
-                p.cpuStats = cpuStats;
-                p.gpuStats = gpuStats;
-                ProcInfos.emplace_back(p);
-            }
-        }
-    }
-
-    return 0;
-}
-
-void NvidiaInfo::draw(bool show_legends)
-{
-    CImg<unsigned char> img(window->width(), window->height(), 1, 3, 50);
-    img.draw_grid(-50 * 100.0f / window->width(), -50 * 100.0f / 256, 0, 0, false, true, colors[0], 0.2f, 0xCCCCCCCC, 0xCCCCCCCC);
-
-    metrics.draw(window, img, METRIC_SM_SOL, METRIC_NVDEC_SOL, show_legends);
-
-    // per process info
-    if (show_legends)
-    {
-        int k = 0;
-        for (const auto& p : ProcInfos)
-        {
-            img.draw_text(100, FONT_HEIGHT * (k + 1),
-                "%s (%d): %d%% | %d%% \n",
-                colors[9], 0, 1, FONT_HEIGHT,
-                p.exeName.c_str(), p.pid, p.gpuStats.gpuUtilization, p.gpuStats.memoryUtilization);
-            k++;
-        }
-    }
-    img.display(*window);
-}
-
-// TODO
-static vector<NvidiaInfo> NvidiaInfos;
-extern vector<shared_ptr<CImgDisplay>> windows;
-extern bool isCimgVisible;
-uint32_t uiNumGPUs = 0;
-
-
-int nvidia_setup()
-{
-#ifdef NV_PERF_ENABLE_INSTRUMENTATION
-    const bool initializeNvPerfResult = InitializeNvPerf();
-    if (initializeNvPerfResult)
-    {
-        const bool openGLLoadDriverResult = OpenGLLoadDriver(); // device periodic sampler requires at least one driver to be loaded
-        if (initializeNvPerfResult)
-        {
-            nsightDeviceIndex = GetCompatibleGpuDeviceIndex();
-            if (nsightDeviceIndex == size_t(~0))
-            {
-                printf("Current device is unsupported, test is skipped.\n");
-                return 1;
-            }
-
-            const size_t MaxNumUndecodedSamples = 1024;
-            const size_t RecordBufferSize = 256 * 1024 * 1024; // 256 MB
-        }
-    }
-#endif
-    nvmlReturn_t nvRetValue = NVML_ERROR_UNINITIALIZED;
-
-    if (!LoadNVML())
-        return -1;
-
-    // Before any of the NVML functions can be used nvmlInit() must be called
-    nvRetValue = _nvmlInitWithFlags(0);
-    nvRetValue = _nvmlInit_v2();
-
-    if (NVML_SUCCESS != nvRetValue)
-    {
-        // Can not call the NVML specific error string handler if the initialization failed
-        printf("[%s] error code :%d\n", "nvmlInit", nvRetValue);
-        return -1;
-    }
-
-    char driverVersion[80];
-    int cudaVersion = 0;
-    char nvmlVersion[80];
-    nvRetValue = _nvmlSystemGetDriverVersion(driverVersion, 80);
-    nvRetValue = _nvmlSystemGetCudaDriverVersion(&cudaVersion);
-    nvRetValue = _nvmlSystemGetNVMLVersion(nvmlVersion, 80);
-    printf("Driver: %s     CUDA: %d.%d      NVML: %s\n",
-        driverVersion,
-        NVML_CUDA_DRIVER_VERSION_MAJOR(cudaVersion), NVML_CUDA_DRIVER_VERSION_MINOR(cudaVersion),
-        nvmlVersion);
-    printf("------------------------------------------------------------\n");
-
-    // Get the number of GPUs
-    nvRetValue = _nvmlDeviceGetCount_v2(&uiNumGPUs);
-    CHECK_NVML(nvRetValue, nvmlDeviceGetCount);
-
-    // In the case that no GPUs were detected
-    if (0 == uiNumGPUs)
-    {
-        printf("No NVIDIA GPUs were detected.\n");
-        _nvmlShutdown();
-        return -1;
-    }
-
-    bool bNVLinkSupported = false;
-
-    printf("GPU\tMODE\tCORES\tBUS\tPCIe\tGB/s\tARCH\tBRAND\tNAME\n");
-
-    NvidiaInfos.resize(uiNumGPUs);
-
-    for (uint32_t iDevIDX = 0; iDevIDX < uiNumGPUs; iDevIDX++)
-    {
-        auto& info = NvidiaInfos[iDevIDX];
-        info.deviceId = iDevIDX;
-        info.setup();
-        if (isCimgVisible)
-        {
-            info.window = make_shared<CImgDisplay>(WINDOW_W, WINDOW_H, info.cDevicename, 3);
-            windows.push_back(info.window);
-        }
-    }
-    printf("------------------------------------------------------------\n");
-
-    // Print out a header for the utilization output
-    printf("GPU\tSM\tMEM\tFBuffer(MB)\tSM-CLK\tMEM-CLK\tPCIE-TX\tPCIE-RX");
-    if (bNVLinkSupported)
-        printf("\tNVLK-TX\tNVLK-RX");
-    printf("\n");
-    printf("#id\t%%\t%%\tUsed / All\tMHz\tMHz\tMB\tMB");
-    if (bNVLinkSupported)
-        printf("\tMB\tMB");
-    printf("\n");
-
-    return 0;
-}
-
-int nvidia_update()
-{
-    nvmlReturn_t nvRetValue = NVML_ERROR_UNINITIALIZED;
-    // Iterate through all of the GPUs
-    for (uint32_t iDevIDX = 0; iDevIDX < uiNumGPUs; iDevIDX++)
-    {
-        auto& info = NvidiaInfos[iDevIDX];
-        GoToXY(0, iDevIDX + 5 + uiNumGPUs + 2);
-        info.update();
-    }
-    return 0;
-}
-
-int nvidia_draw(bool show_legends)
-{
-    for (auto& info : NvidiaInfos)
-    {
-        info.draw(show_legends);
-    }
-
-    return 0;
-}
-
-int nvidia_cleanup()
-{
-    auto nvRetValue = _nvmlShutdown();
-
-    return nvRetValue;
-}
-
-int nvidia_draw_imgui()
-{
-    for (auto& info : NvidiaInfos)
-    {
-        info.drawImgui();
-    }
-
-    return 0;
-}
+#include "nvidia_prof.h"
+#include <stdio.h>
+#include <assert.h>
+#include <string>
+#include <inttypes.h>
+#include "util_win32.h"
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include "../3rdparty/CImg.h"
+#include "metrics_info.h"
+#include "self_profile.h"
+#include "nvml_sampling.h"
+#include "nvml_stub.h"
+#include "device_inventory.h"
+#include "watchdog.h"
+#include "scheduler.h"
+#include "process_cache.h"
+#include "implot/implot.h"
+#include <stdarg.h>
+#include <algorithm>
+#include <chrono>
+#include <string.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+using namespace cimg_library;
+using namespace std;
+
+#include "../3rdparty/CUDA_SDK/nvml.h"
+
+//#define NV_PERF_ENABLE_INSTRUMENTATION
+
+#ifdef NV_PERF_ENABLE_INSTRUMENTATION
+#ifdef _WIN32
+// Suppress redifinition warnings
+//#undef APIENTRY
+// undef min and max from windows.h
+#define NOMINMAX
+#endif
+#include "windows-desktop-x64/nvperf_host_impl.h"
+#include "../3rdparty/NvPerfUtility/include/NvPerfReportGenerator.h"
+#include "../3rdparty/NvPerfUtility/include/NvPerfPeriodicSamplerGpu.h"
+#include "../3rdparty/NvPerfUtility/include/NvPerfOpenGL.h"
+
+//nv::perf::profiler::ReportGeneratorOpenGL m_nvperf;
+double m_nvperfWarmupTime = 0.5; // Wait 0.5s to allow the clock to stabalize before begining to profile
+NVPW_Device_ClockStatus m_clockStatus = NVPW_DEVICE_CLOCK_STATUS_UNKNOWN; // Used to restore clock state when exiting
+
+using namespace nv::perf;
+using namespace nv::perf::sampler;
+
+size_t nsightDeviceIndex = -1;
+
+size_t GetCompatibleGpuDeviceIndex()
+{
+    NVPW_GetDeviceCount_Params getDeviceCountParams = { NVPW_GetDeviceCount_Params_STRUCT_SIZE };
+    NVPA_Status nvpaStatus = NVPW_GetDeviceCount(&getDeviceCountParams);
+    if (nvpaStatus)
+    {
+        NV_PERF_LOG_ERR(50, "Failed NVPW_GetDeviceCount: %u\n", nvpaStatus);
+        return size_t(~0);
+    }
+
+    for (size_t deviceIndex = 0; deviceIndex < getDeviceCountParams.numDevices; ++deviceIndex)
+    {
+        if (GpuPeriodicSamplerIsGpuSupported(deviceIndex))
+        {
+            return deviceIndex;
+        }
+    }
+    return size_t(~0);
+}
+
+#endif
+
+// display information about the calling function and related error
+void ShowErrorDetails(const nvmlReturn_t nvRetVal, const char* pFunctionName);
+
+extern bool isHeadless;
+// -nvml-record, -nvml-replay and -nvml-fake
+extern const char* nvmlRecordPath;
+extern const char* nvmlReplayPath;
+extern int nvmlFakeDevices;
+
+// printf into a string
+void appendf(std::string& s, const char* format, ...)
+{
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    s += buf;
+}
+
+#define CHECK_NVML(nvRetValue, func) \
+            if (NVML_SUCCESS != nvRetValue) \
+            { \
+                if (nvRetValue != NVML_ERROR_NO_PERMISSION && nvRetValue != NVML_ERROR_NOT_SUPPORTED) \
+                { \
+                    ShowErrorDetails(nvRetValue, #func); \
+                } \
+            }
+
+#define ENTRY(func) decltype(func)  *_##func = NULL;
+#include "../3rdparty/CUDA_SDK/nvml.def"
+#undef ENTRY(func)
+
+bool LoadNVML()
+{
+    // no driver at all, the entry points are stubs
+    if (nvmlReplayPath || nvmlFakeDevices > 0)
+    {
+        static bool isStubBound = false;
+        if (!isStubBound)
+            isStubBound = nvmlReplayPath ? nvml_stub_replay(nvmlReplayPath) : nvml_stub_fake(nvmlFakeDevices);
+        if (isStubBound && nvmlRecordPath && !nvmlReplayPath)
+            nvml_stub_record(nvmlRecordPath);
+        if (isStubBound)
+            nvml_stub_time();
+        return isStubBound;
+    }
+
+    // Load the NVML DLL using the default NVML DLL install path
+    // NOTE: This DLL is included in the NVIDIA driver installation by default
+    static HINSTANCE hDLLhandle = NULL;
+    if (hDLLhandle) return true;
+
+    const char* nvmlFilenames[] =
+    {
+        "C:\\Program Files\\NVIDIA Corporation\\NVSMI\\NVML.DLL",
+        "C:\\Windows\\System32\\nvml.dll"
+    };
+    for (auto file : nvmlFilenames)
+    {
+        hDLLhandle = LoadLibraryA(file);
+        if (hDLLhandle) break;
+    }
+
+    // if the DLL can not be found, exit
+    if (NULL == hDLLhandle)
+    {
+        printf("NVML DLL is not installed or not found at the default path.\r\n");
+        return false;
+    }
+
+#define ENTRY(func) _##func = (decltype(func)*)GetProcAddress(hDLLhandle, #func);
+#include "../3rdparty/CUDA_SDK/nvml.def"
+#undef ENTRY(func)
+
+    // every call from here on goes to the tape as well
+    if (nvmlRecordPath)
+        nvml_stub_record(nvmlRecordPath);
+    // and is timed
+    nvml_stub_time();
+
+    return true;
+}
+
+int getUInt(nvmlDevice_t device, int fieldId, uint32_t* value)
+{
+    nvmlFieldValue_t fieldValue = {};
+    fieldValue.fieldId = fieldId;
+    nvmlReturn_t nvRetValue = NVML_ERROR_UNKNOWN;
+    nvRetValue = _nvmlDeviceGetFieldValues(device, 1, &fieldValue);
+    *value = 0;
+    CHECK_NVML(nvRetValue, nvmlDeviceGetFieldValues);
+    *value = fieldValue.value.uiVal;
+
+    return 0;
+}
+
+// display information about the calling function and related error
+void ShowErrorDetails(const nvmlReturn_t nvRetVal, const char* pFunctionName)
+{
+    auto pErrorDescription = _nvmlErrorString(nvRetVal);
+    fprintf(stderr, "[%s] - %s\r\n", pFunctionName, pErrorDescription);
+}
+
+struct ProcInfo
+{
+    unsigned int pid;
+    std::string exeName;
+    ProcessMeta cpuStats;
+    nvmlAccountingStats_t gpuStats;
+};
+
+// What the event watcher saw on a device, it only blocks in nvmlEventSetWait, the worker
+// of the device turns them into chart events at its next update().
+struct PendingEvents
+{
+    // the oldest ones are dropped past this while the device doesn't update
+    static const size_t CAPACITY = 64;
+
+    mutex lock;
+    vector<pair<int64_t, nvmlEventData_t>> events;
+    int64_t dropped = 0;
+};
+
+struct NvidiaInfo
+{
+    shared_ptr<CImgDisplay> window;
+
+    uint32_t deviceId = 0;
+    nvmlDevice_t handle = NULL;
+    nvmlPciInfo_t pciInfo;
+    uint32_t numCores = 0;
+    uint32_t busWidth = 0;
+    uint32_t pcieLinkWidth = 0;
+    uint32_t pcieLinkGeneration = 0;
+    uint32_t pcieCurrentSpeed = 0;
+    // the clocks are shown relative to these, 0 when the driver doesn't tell
+    uint32_t maxSmClock = 0;
+    uint32_t maxMemClock = 0;
+    unsigned long long supportedThrottleReasons = 0;
+    nvmlDriverModel_t driverModel, pendingDriverModel;
+    nvmlBrandType_t brandType = NVML_BRAND_UNKNOWN;
+    nvmlDeviceArchitecture_t deviceArch = NVML_DEVICE_ARCH_UNKNOWN;
+    char cDevicename[NVML_DEVICE_NAME_BUFFER_SIZE] = { '\0' };
+    uint32_t numLinks = 0;
+    nvmlEnableState_t nvlinkActives[NVML_NVLINK_MAX_LINKS] = {};
+    uint32_t nvlinkMaxSpeeds[NVML_NVLINK_MAX_LINKS] = {};
+    nvmlPciInfo_t nvlinkPciInfos[NVML_NVLINK_MAX_LINKS] = {};
+    // the device at the other end of each link, -1 for none or not a GPU (NVSwitch, CPU)
+    int nvlinkPeers[NVML_NVLINK_MAX_LINKS];
+    uint32_t numActiveLinks = 0;
+
+    // TX / RX of one link as rates, from the cumulative counters
+    struct NvLinkRate
+    {
+        CounterRate tx;
+        CounterRate rx;
+        double txBytesPerSecond = 0;
+        double rxBytesPerSecond = 0;
+        MetricHandle txMetric = INVALID_METRIC;
+        MetricHandle rxMetric = INVALID_METRIC;
+    };
+    NvLinkRate nvlinkRates[NVML_NVLINK_MAX_LINKS];
+    // sum over the active links
+    double nvlinkTxBytesPerSecond = 0;
+    double nvlinkRxBytesPerSecond = 0;
+
+    std::vector<ProcInfo> ProcInfos;
+    // row of the console table, printed by nvidia_update() once every device is sampled
+    std::string consoleLine;
+    // ProcInfos as last published by the collector thread, read by draw()
+    unique_ptr<SnapshotBuffer<vector<ProcInfo>>> procSnapshots = make_unique<SnapshotBuffer<vector<ProcInfo>>>();
+
+    // the per pid accounting stats cost one call per process, they are slowed down like the plan calls
+    CallCadence accountingCadence;
+    // what the cost control did, published for the UI
+    unique_ptr<SnapshotBuffer<vector<SamplingPlan::CallReport>>> costReports = make_unique<SnapshotBuffer<vector<SamplingPlan::CallReport>>>();
+
+    // every NVML call of update() and updatePower() runs on this thread, see superviseDevice()
+    SupervisedWorker worker;
+    int64_t submitMs = 0;
+    // metric time of the call that didn't come back in time, 0 while the device answers
+    int64_t stallStartMs = 0;
+    // the same for the offloaded call SamplingPlan::stalledCall names
+    int64_t offloadStallStartMs = 0;
+    bool isQuarantined = false;     // stalled past kQuarantineMs, NVML is started again once it returns
+    // not found again after a reinit, metric time since when
+    int64_t lostSinceMs = 0;
+    // why the charts stopped, empty while sampling, published by the collector thread
+    unique_ptr<SnapshotBuffer<string>> statusSnapshots = make_unique<SnapshotBuffer<string>>();
+    // filled by the event watcher, shared with it as it may outlive the device
+    shared_ptr<PendingEvents> pendingEvents = make_shared<PendingEvents>();
+
+    // Flags to denote unsupported queries
+    bool bGPUUtilSupported = true;
+    bool bEncoderUtilSupported = true;
+    bool bDecoderUtilSupported = true;
+    bool bProcessUtilSupported = true;
+
+    nvmlEnableState_t bMonitorConnected = NVML_FEATURE_DISABLED;
+
+    MetricsInfo metrics;
+    MetricHandle smMetric = INVALID_METRIC;
+    MetricHandle fbMetric = INVALID_METRIC;
+    MetricHandle memMetric = INVALID_METRIC;
+    MetricHandle pcieMetric = INVALID_METRIC;
+    MetricHandle tempMetric = INVALID_METRIC;
+    MetricHandle powerMetric = INVALID_METRIC;
+    MetricHandle encMetric = INVALID_METRIC;
+    MetricHandle decMetric = INVALID_METRIC;
+    MetricHandle smClockMetric = INVALID_METRIC;
+    MetricHandle memClockMetric = INVALID_METRIC;
+    // band track of the clock throttle reasons under the clock charts, -1 when unsupported
+    int throttleTrack = -1;
+    MetricHandle nvlinkTxMetric = INVALID_METRIC;
+    MetricHandle nvlinkRxMetric = INVALID_METRIC;
+    // positions in metrics of what the renderers draw, resolved by setup() from the registered series
+    vector<int> imguiCharts;
+    int cimgLastChart = -1;
+
+    // what update() reads, built once by setup()
+    SamplingPlan plan;
+    struct
+    {
+        int sm, mem, fbUsed, fbTotal, temp, enc, dec, smClock, memClock, throttle, pcieTx, pcieRx;
+        int nvlinkTx[NVML_NVLINK_MAX_LINKS];
+        int nvlinkRx[NVML_NVLINK_MAX_LINKS];
+    } slots = {};
+
+    // A buffer the driver fills at its own rate, read back with nvmlDeviceGetSamples.
+    // Every sample is pushed with its own timestamp instead of the one of our tick.
+    struct DriverStream
+    {
+        nvmlSamplingType_t type;
+        MetricHandle metric;
+        int slot;                       // plan slot mirrored for the console, -1 for none
+        const char* pollName;           // the plan call it replaces, null for none
+        float scale;
+        unsigned long long lastSeen;    // wall clock us of the newest sample pushed
+        float latest;
+        bool supported;
+        bool streaming;                 // true once it delivered samples, the poll is off from then on
+        std::vector<nvmlSample_t> buffer;
+    };
+    std::vector<DriverStream> driverStreams;
+
+    // SM / MEM / ENC / DEC of every process using the GPU, from nvmlDeviceGetProcessUtilization.
+    // ENC and DEC series are only created once the process uses the engine.
+    struct ProcessTimeline
+    {
+        uint64_t startTime = 0;
+        int64_t lastSampleMs = 0;
+        bool isQuiet = false;           // zeros were pushed after it stopped showing up
+        std::string label;
+        MetricHandle sm = INVALID_METRIC;
+        MetricHandle mem = INVALID_METRIC;
+        MetricHandle enc = INVALID_METRIC;
+        MetricHandle dec = INVALID_METRIC;
+    };
+    MetricsInfo procMetrics;
+    std::unordered_map<uint32_t, ProcessTimeline> processTimelines;
+    std::vector<nvmlProcessUtilizationSample_t> procSamples;
+    unsigned long long procLastSeen = 0;
+
+    // driverVersion keys the inventory, null to ask the driver for everything
+    int setup(const char* driverVersion);
+
+    void buildSamplingPlan();
+
+    // after NVML was started again, the handle changed
+    void rebuildSamplingPlan();
+
+    void setupDriverStreams();
+
+    void drainDriverSamples();
+
+    bool isStreamed(MetricHandle metric) const;
+
+    int updateProcessTimelines();
+
+    ProcessTimeline& getProcessTimeline(uint32_t pid, int64_t now);
+
+    void removeProcessTimeline(uint32_t pid);
+
+    void addPendingEvents();
+
+    int update();
+
+    int updatePower();
+
+    void updateNvLinkRates();
+
+    bool isNvLinkActive(uint32_t link) const { return link < numLinks && nvlinkActives[link] == NVML_FEATURE_ENABLED; }
+
+    int updatePerProcessInfo();
+
+    void draw(bool show_legends);
+
+    void drawImgui()
+    {
+        const auto& status = statusSnapshots->read();
+        if (!status.empty())
+            ImGui::TextColored(ImVec4(1, 0.3f, 0.3f, 1), "%s: %s", cDevicename, status.c_str());
+        for (int idx : imguiCharts)
+            metrics.drawImgui(cDevicename, idx, idx);
+        procMetrics.drawImgui(cDevicename, 0, -1);
+    }
+};
+
+// the static properties of a device, only asked when the inventory of the last run doesn't have them
+static void queryInventory(nvmlDevice_t handle, DeviceInventory* inventory)
+{
+    inventory->brandType = NVML_BRAND_UNKNOWN;
+    inventory->deviceArch = NVML_DEVICE_ARCH_UNKNOWN;
+
+    // nvlink
+    getUInt(handle, NVML_FI_DEV_NVLINK_LINK_COUNT, &inventory->numLinks);
+    assert(inventory->numLinks <= NVML_NVLINK_MAX_LINKS);
+    uint32_t commonSpeed = 0;
+    if (inventory->numLinks > 0)
+        getUInt(handle, NVML_FI_DEV_NVLINK_SPEED_MBPS_COMMON, &commonSpeed);
+    for (int j = 0; j < inventory->numLinks; j++)
+    {
+        _nvmlDeviceGetNvLinkRemotePciInfo_v2(handle, j, &inventory->nvlinkPciInfos[j]);
+        // the per link speed fields stop at link 11 and aren't contiguous
+        if (j < 6)
+            getUInt(handle, NVML_FI_DEV_NVLINK_SPEED_MBPS_L0 + j, &inventory->nvlinkMaxSpeeds[j]);
+        else if (j < 12)
+            getUInt(handle, NVML_FI_DEV_NVLINK_SPEED_MBPS_L6 + j - 6, &inventory->nvlinkMaxSpeeds[j]);
+        if (inventory->nvlinkMaxSpeeds[j] == 0)
+            inventory->nvlinkMaxSpeeds[j] = commonSpeed;
+    }
+
+    if (_nvmlDeviceGetNumGpuCores)
+        _nvmlDeviceGetNumGpuCores(handle, &inventory->numCores);
+    if (_nvmlDeviceGetMemoryBusWidth)
+        _nvmlDeviceGetMemoryBusWidth(handle, &inventory->busWidth);
+    if (_nvmlDeviceGetCurrPcieLinkWidth && _nvmlDeviceGetCurrPcieLinkGeneration)
+    {
+        _nvmlDeviceGetCurrPcieLinkWidth(handle, &inventory->pcieLinkWidth);
+        _nvmlDeviceGetCurrPcieLinkGeneration(handle, &inventory->pcieLinkGeneration);
+    }
+
+    _nvmlDeviceGetMaxClockInfo(handle, NVML_CLOCK_SM, &inventory->maxSmClock);
+    _nvmlDeviceGetMaxClockInfo(handle, NVML_CLOCK_MEM, &inventory->maxMemClock);
+    _nvmlDeviceGetSupportedClocksThrottleReasons(handle, &inventory->supportedThrottleReasons);
+
+    // Get the device name
+    auto nvRetValue = _nvmlDeviceGetName(handle, inventory->name, NVML_DEVICE_NAME_BUFFER_SIZE);
+    CHECK_NVML(nvRetValue, nvmlDeviceGetName);
+
+    nvRetValue = _nvmlDeviceGetBrand(handle, &inventory->brandType);
+    //CHECK_NVML(nvRetValue, nvmlDeviceGetBrand);
+
+    nvRetValue = _nvmlDeviceGetArchitecture(handle, &inventory->deviceArch);
+}
+
+int NvidiaInfo::setup(const char* driverVersion)
+{
+    auto nvRetValue = _nvmlDeviceGetHandleByIndex_v2(deviceId, &handle);
+    CHECK_NVML(nvRetValue, nvmlDeviceGetHandleByIndex);
+
+    nvRetValue = _nvmlDeviceSetAccountingMode(handle, NVML_FEATURE_ENABLED);
+
+    printf("%d", deviceId);
+    nvRetValue = _nvmlDeviceGetPciInfo_v3(handle, &pciInfo);
+    CHECK_NVML(nvRetValue, nvmlDeviceGetPciInfo);
+    
+    nvRetValue = _nvmlDeviceGetDisplayMode(handle, &bMonitorConnected);
+    //CHECK_NVML(nvRetValue, nvmlDeviceGetDisplayMode);
+
+    // the static properties come from the inventory when this driver already saw the device,
+    // a warm start only asks for what can change while it runs
+    DeviceInventory inventory = {};
+    if (!driverVersion || !findDeviceInventory(driverVersion, pciInfo.busId, &inventory))
+    {
+        queryInventory(handle, &inventory);
+        if (driverVersion)
+        {
+            strncpy(inventory.driverVersion, driverVersion, sizeof(inventory.driverVersion) - 1);
+            strncpy(inventory.busId, pciInfo.busId, sizeof(inventory.busId) - 1);
+            storeDeviceInventory(inventory);
+        }
+    }
+    memcpy(cDevicename, inventory.name, sizeof(cDevicename));
+    brandType = inventory.brandType;
+    deviceArch = inventory.deviceArch;
+    numCores = inventory.numCores;
+    busWidth = inventory.busWidth;
+    pcieLinkGeneration = inventory.pcieLinkGeneration;
+    pcieLinkWidth = inventory.pcieLinkWidth;
+    maxSmClock = inventory.maxSmClock;
+    maxMemClock = inventory.maxMemClock;
+    supportedThrottleReasons = inventory.supportedThrottleReasons;
+    numLinks = inventory.numLinks;
+    memcpy(nvlinkMaxSpeeds, inventory.nvlinkMaxSpeeds, sizeof(nvlinkMaxSpeeds));
+    memcpy(nvlinkPciInfos, inventory.nvlinkPciInfos, sizeof(nvlinkPciInfos));
+
+    // a link can go down, its state and the counters are live
+    for (int j = 0; j < numLinks; j++)
+    {
+        _nvmlDeviceGetNvLinkState(handle, j, &nvlinkActives[j]);
+        if (isNvLinkActive(j))
+            numActiveLinks++;
+
+        for (int counter = 0; counter < 2; counter++)
+        {
+            unsigned int reset = 1;
+            nvmlNvLinkUtilizationControl_t control = { NVML_NVLINK_COUNTER_UNIT_BYTES, NVML_NVLINK_COUNTER_PKTFILTER_ALL };
+            nvRetValue = _nvmlDeviceSetNvLinkUtilizationControl(handle, j, counter, &control, reset);
+            //CHECK_NVML(nvRetValue, nvmlDeviceSetNvLinkUtilizationControl);
+        }
+    }
+
+    // Get driver mode, WDDM or TCC?
+    nvRetValue = _nvmlDeviceGetDriverModel(handle, &driverModel, &pendingDriverModel);
+    CHECK_NVML(nvRetValue, nvmlDeviceGetDriverModel);
+    static char* driverModelsString[] = { "WDDM", "TCC", "N/A" };
+    // there is no driver model outside of Windows
+    printf("\t%s", nvRetValue == NVML_SUCCESS ? driverModelsString[driverModel] : "N/A");
+
+    if (numCores != 0)
+        printf("\t%u", numCores);
+    else printf("\tN/A");
+
+    if (busWidth != 0)
+        printf("\t%u", busWidth);
+    else printf("\tN/A");
+
+    if (pcieLinkGeneration != 0)
+        printf("\t%u.0 x%u", pcieLinkGeneration, pcieLinkWidth);
+    else printf("\tN/A");
+
+    if (_nvmlDeviceGetPcieSpeed)
+    {
+        _nvmlDeviceGetPcieSpeed(handle, &pcieCurrentSpeed);
+        printf("\t%.0f", pcieCurrentSpeed / 1e3);
+    }
+    else printf("\tN/A");
+
+    char* brandName = "";
+#define ENTRY(type, desc) case type: brandName = desc; break;
+    switch (brandType)
+    {
+        ENTRY(NVML_BRAND_UNKNOWN, "UNKNOWN");
+        ENTRY(NVML_BRAND_QUADRO, "Quadro");
+        ENTRY(NVML_BRAND_TESLA, "Tesla");
+        ENTRY(NVML_BRAND_NVS, "NVS");
+        ENTRY(NVML_BRAND_GRID, "GRID");
+        ENTRY(NVML_BRAND_GEFORCE, "Geforce");
+        ENTRY(NVML_BRAND_TITAN, "Titan");
+        ENTRY(NVML_BRAND_NVIDIA_VAPPS, "vApps");
+        ENTRY(NVML_BRAND_NVIDIA_VPC, "vPC");
+        ENTRY(NVML_BRAND_NVIDIA_VCS, "vCS");
+        ENTRY(NVML_BRAND_NVIDIA_VWS, "vWS");
+        ENTRY(NVML_BRAND_NVIDIA_CLOUD_GAMING, "Cloud Gaming");
+        ENTRY(NVML_BRAND_QUADRO_RTX, "Quadro");
+        ENTRY(NVML_BRAND_NVIDIA_RTX, "NVIDIA");
+        ENTRY(NVML_BRAND_NVIDIA, "NVIDIA");
+        ENTRY(NVML_BRAND_GEFORCE_RTX, "Geforce RTX");
+        ENTRY(NVML_BRAND_TITAN_RTX, "Titan RTX");
+    }
+#undef ENTRY
+
+    char* archName = "";
+#define ENTRY(type, desc) case type: archName = desc; break;
+    switch (deviceArch)
+    {
+        ENTRY(NVML_DEVICE_ARCH_KEPLER, "Kepler");
+        ENTRY(NVML_DEVICE_ARCH_MAXWELL, "Maxwell");
+        ENTRY(NVML_DEVICE_ARCH_PASCAL, "Pascal");
+        ENTRY(NVML_DEVICE_ARCH_VOLTA, "Volta");
+        ENTRY(NVML_DEVICE_ARCH_TURING, "Turing");
+        ENTRY(NVML_DEVICE_ARCH_AMPERE, "Ampere");
+        ENTRY(NVML_DEVICE_ARCH_ADA, "Ada");
+        ENTRY(NVML_DEVICE_ARCH_HOPPER, "Hopper");
+    }
+#undef ENTRY
+
+
+    smMetric = metrics.addSeries("gpu", deviceId, "SM", "%");
+    fbMetric = metrics.addSeries("gpu", deviceId, "RAM", "%");
+    memMetric = metrics.addSeries("gpu", deviceId, "MEM", "%");
+    pcieMetric = metrics.addSeries("gpu", deviceId, "PCIE", "%");
+    tempMetric = metrics.addSeries("gpu", deviceId, "TEMP", "C");
+    powerMetric = metrics.addSeries("gpu", deviceId, "POWER", "W");
+    encMetric = metrics.addSeries("gpu", deviceId, "ENC", "%");
+    decMetric = metrics.addSeries("gpu", deviceId, "DEC", "%");
+    smClockMetric = metrics.addSeries("gpu", deviceId, "SM CLK", maxSmClock > 0 ? "%" : "MHz");
+    memClockMetric = metrics.addSeries("gpu", deviceId, "MEM CLK", maxMemClock > 0 ? "%" : "MHz");
+    if (supportedThrottleReasons != 0)
+    {
+        // bit k of nvmlClocksThrottleReason*
+        throttleTrack = metrics.addBandTrack("clock throttle reasons", {
+            "GPU idle", "applications clocks", "SW power cap", "HW slowdown", "sync boost",
+            "SW thermal slowdown", "HW thermal slowdown", "HW power brake", "display clock" }, memClockMetric);
+    }
+    if (numActiveLinks > 0)
+    {
+        // relative to the link speed, MB/s on drivers that don't report it
+        uint32_t totalSpeed = 0;
+        for (uint32_t j = 0; j < numLinks; j++)
+            totalSpeed += isNvLinkActive(j) ? nvlinkMaxSpeeds[j] : 0;
+        nvlinkTxMetric = metrics.addSeries("gpu", deviceId, "NVLK TX", totalSpeed > 0 ? "%" : "MB/s");
+        nvlinkRxMetric = metrics.addSeries("gpu", deviceId, "NVLK RX", totalSpeed > 0 ? "%" : "MB/s");
+        for (uint32_t j = 0; j < numLinks; j++)
+        {
+            if (!isNvLinkActive(j))
+                continue;
+            auto unit = nvlinkMaxSpeeds[j] > 0 ? "%" : "MB/s";
+            nvlinkRates[j].txMetric = metrics.addSeries("gpu", deviceId, "NVLK" + to_string(j) + " TX", unit);
+            nvlinkRates[j].rxMetric = metrics.addSeries("gpu", deviceId, "NVLK" + to_string(j) + " RX", unit);
+        }
+    }
+
+    // SM and RAM, then SM and MEM clocks with the throttle reasons under them
+    for (auto metric : { smMetric, fbMetric, smClockMetric, memClockMetric })
+    {
+        int idx = metrics.indexOf(metric);
+        if (idx >= 0)
+            imguiCharts.push_back(idx);
+    }
+    // the CImg window overlays everything from SM up to DEC, nvlink is console only
+    for (auto metric : { smMetric, fbMetric, memMetric, pcieMetric, tempMetric, powerMetric, encMetric, decMetric })
+        cimgLastChart = (std::max)(cimgLastChart, metrics.indexOf(metric));
+
+    buildSamplingPlan();
+    setupDriverStreams();
+
+    printf("\t%s", archName);
+    printf("\t%s", brandName);
+    printf("\t%s", cDevicename);
+
+    printf("\n");
+
+    return 0;
+}
+
+// NVML time one device may take per tick, see SamplingPlan
+const double kSampleBudgetUs = 10 * 1000;
+
+void NvidiaInfo::buildSamplingPlan()
+{
+    auto device = handle;
+    slots.sm = plan.addSlot("SM");
+    slots.mem = plan.addSlot("MEM");
+    slots.fbUsed = plan.addSlot("FB used");
+    slots.fbTotal = plan.addSlot("FB total");
+    slots.temp = plan.addSlot("TEMP");
+    slots.enc = plan.addSlot("ENC");
+    slots.dec = plan.addSlot("DEC");
+    slots.smClock = plan.addSlot("SM-CLK");
+    slots.memClock = plan.addSlot("MEM-CLK");
+    slots.throttle = plan.addSlot("THROTTLE");
+    slots.pcieTx = plan.addSlot("PCIE-TX");
+    slots.pcieRx = plan.addSlot("PCIE-RX");
+    for (uint32_t j = 0; j < numLinks; j++)
+    {
+        slots.nvlinkTx[j] = isNvLinkActive(j) ? plan.addSlot("NVLK-TX") : -1;
+        slots.nvlinkRx[j] = isNvLinkActive(j) ? plan.addSlot("NVLK-RX") : -1;
+    }
+    // the queries capture a copy, the offload thread may run them after the plan is rebuilt
+    const auto slot = slots;
+
+    plan.addCall("nvmlDeviceGetUtilizationRates", [=](SamplingPlan& plan)
+    {
+        // NOTE: nvUtil.memory is the memory controller utilization not the frame buffer utilization
+        nvmlUtilization_t nvUtilData = {};
+        auto ret = _nvmlDeviceGetUtilizationRates(device, &nvUtilData);
+        // NVML_ERROR_UNINITIALIZED, from this call or any other, marks the plan lost and
+        // nvidia_update() starts NVML again, see reinitNvml()
+        if (ret == NVML_SUCCESS)
+        {
+            plan.set(slot.sm, nvUtilData.gpu);
+            plan.set(slot.mem, nvUtilData.memory);
+        }
+        return ret;
+    });
+
+    // frame buffer in MB
+    plan.addCall("nvmlDeviceGetMemoryInfo", [=](SamplingPlan& plan)
+    {
+        nvmlMemory_t GPUmemoryInfo = {};
+        auto ret = _nvmlDeviceGetMemoryInfo(device, &GPUmemoryInfo);
+        if (ret == NVML_SUCCESS)
+        {
+            uint64_t totalMBytes = GPUmemoryInfo.total / 1024L / 1024L;
+            plan.set(slot.fbUsed, double(totalMBytes - GPUmemoryInfo.free / 1024L / 1024L));
+            plan.set(slot.fbTotal, double(totalMBytes));
+        }
+        return ret;
+    });
+
+    // power has its own faster task
+    plan.addCall("nvmlDeviceGetTemperature", [=](SamplingPlan& plan)
+    {
+        uint32_t temp = 0;
+        auto ret = _nvmlDeviceGetTemperature(device, NVML_TEMPERATURE_GPU, &temp);
+        if (ret == NVML_SUCCESS)
+            plan.set(slot.temp, temp);
+        return ret;
+    });
+
+    // video encoder and decoder utilization, where supported
+    plan.addCall("nvmlDeviceGetEncoderUtilization", [=](SamplingPlan& plan)
+    {
+        uint32_t util = 0, samplingPeriodUs = 0;
+        auto ret = _nvmlDeviceGetEncoderUtilization(device, &util, &samplingPeriodUs);
+        if (ret == NVML_SUCCESS)
+            plan.set(slot.enc, util);
+        return ret;
+    });
+    plan.addCall("nvmlDeviceGetDecoderUtilization", [=](SamplingPlan& plan)
+    {
+        uint32_t util = 0, samplingPeriodUs = 0;
+        auto ret = _nvmlDeviceGetDecoderUtilization(device, &util, &samplingPeriodUs);
+        if (ret == NVML_SUCCESS)
+            plan.set(slot.dec, util);
+        return ret;
+    });
+
+    // only the SM and MEM clocks are shown, graphics and video are not queried
+    for (auto type : { NVML_CLOCK_SM, NVML_CLOCK_MEM })
+    {
+        int slot = type == NVML_CLOCK_SM ? slots.smClock : slots.memClock;
+        plan.addCall("nvmlDeviceGetClockInfo", [=](SamplingPlan& plan)
+        {
+            uint32_t clock = 0;
+            auto ret = _nvmlDeviceGetClockInfo(device, type, &clock);
+            if (ret == NVML_SUCCESS)
+                plan.set(slot, clock);
+            return ret;
+        });
+    }
+
+    if (supportedThrottleReasons != 0)
+    {
+        plan.addCall("nvmlDeviceGetCurrentClocksThrottleReasons", [=](SamplingPlan& plan)
+        {
+            unsigned long long reasons = 0;
+            auto ret = _nvmlDeviceGetCurrentClocksThrottleReasons(device, &reasons);
+            if (ret == NVML_SUCCESS)
+                plan.set(slot.throttle, double(reasons & 0xFFFFFFFF));
+            return ret;
+        });
+    }
+
+    // pcie traffic in KB/s
+    for (auto counter : { NVML_PCIE_UTIL_TX_BYTES, NVML_PCIE_UTIL_RX_BYTES })
+    {
+        int slot = counter == NVML_PCIE_UTIL_TX_BYTES ? slots.pcieTx : slots.pcieRx;
+        plan.addCall("nvmlDeviceGetPcieThroughput", [=](SamplingPlan& plan)
+        {
+            uint32_t value = 0;
+            auto ret = _nvmlDeviceGetPcieThroughput(device, counter, &value);
+            if (ret == NVML_SUCCESS)
+                plan.set(slot, value);
+            return ret;
+        });
+    }
+
+    // cumulative nvlink traffic of every active link, in KiB from the fields,
+    // in bytes from the utilization counter on drivers without them
+    for (uint32_t j = 0; j < numLinks; j++)
+    {
+        if (!isNvLinkActive(j))
+            continue;
+        plan.addField(slots.nvlinkTx[j], NVML_FI_DEV_NVLINK_THROUGHPUT_DATA_TX, j, "nvmlDeviceGetNvLinkUtilizationCounter",
+            [=](SamplingPlan& plan)
+        {
+            unsigned long long rxcounter = 0;
+            unsigned long long txcounter = 0;
+            auto ret = _nvmlDeviceGetNvLinkUtilizationCounter(device, j, 0, &rxcounter, &txcounter);
+            if (ret == NVML_SUCCESS)
+            {
+                plan.setCounter(slot.nvlinkTx[j], txcounter);
+                plan.setCounter(slot.nvlinkRx[j], rxcounter);
+            }
+            return ret;
+        });
+        plan.addField(slots.nvlinkRx[j], NVML_FI_DEV_NVLINK_THROUGHPUT_DATA_RX, j, nullptr, nullptr);
+    }
+
+    plan.build(handle, _nvmlDeviceGetFieldValues);
+    plan.budgetUs = kSampleBudgetUs;
+}
+
+void NvidiaInfo::rebuildSamplingPlan()
+{
+    // reinitNvml() made sure nothing is in flight
+    plan.stop(0);
+    offloadStallStartMs = 0;
+    plan = SamplingPlan();
+    buildSamplingPlan();
+    // the streams the reset turned off, the samples before lastSeen are not pushed twice
+    for (auto& stream : driverStreams)
+    {
+        stream.supported = true;
+        stream.streaming = false;
+    }
+}
+
+// the driver stamps its samples with the wall clock in us, the series run on the steady clock in ms
+int64_t getWallToMetricOffsetMs()
+{
+    auto wallUs = chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    return getMetricTimeMs() - wallUs / 1000;
+}
+
+void NvidiaInfo::setupDriverStreams()
+{
+    auto add = [&](nvmlSamplingType_t type, MetricHandle metric, int slot, const char* pollName, float scale)
+    {
+        driverStreams.push_back({ type, metric, slot, pollName, scale, 0, 0, true, false });
+    };
+    add(NVML_GPU_UTILIZATION_SAMPLES, smMetric, slots.sm, "nvmlDeviceGetUtilizationRates", 1);
+    add(NVML_MEMORY_UTILIZATION_SAMPLES, memMetric, slots.mem, "nvmlDeviceGetUtilizationRates", 1);
+    add(NVML_ENC_UTILIZATION_SAMPLES, encMetric, slots.enc, "nvmlDeviceGetEncoderUtilization", 1);
+    add(NVML_DEC_UTILIZATION_SAMPLES, decMetric, slots.dec, "nvmlDeviceGetDecoderUtilization", 1);
+    // mW
+    add(NVML_TOTAL_POWER_SAMPLES, powerMetric, -1, nullptr, 0.001f);
+}
+
+void NvidiaInfo::drainDriverSamples()
+{
+    if (!_nvmlDeviceGetSamples)
+        return;
+
+    auto offsetMs = getWallToMetricOffsetMs();
+
+    for (auto& stream : driverStreams)
+    {
+        if (!stream.supported)
+            continue;
+
+        nvmlValueType_t valueType;
+        unsigned int count = 0;
+        auto ret = _nvmlDeviceGetSamples(handle, stream.type, stream.lastSeen, &valueType, &count, nullptr);
+        if (ret == NVML_SUCCESS && count > 0)
+        {
+            stream.buffer.resize(count);
+            ret = _nvmlDeviceGetSamples(handle, stream.type, stream.lastSeen, &valueType, &count, stream.buffer.data());
+        }
+        if (ret == NVML_ERROR_UNINITIALIZED || ret == NVML_ERROR_GPU_IS_LOST)
+        {
+            plan.isLost = true;
+            continue;
+        }
+        // NOT_FOUND, nothing new since lastSeen
+        if (ret != NVML_SUCCESS && ret != NVML_ERROR_NOT_FOUND)
+        {
+            CHECK_NVML(ret, nvmlDeviceGetSamples);
+            stream.supported = false;
+            continue;
+        }
+
+        bool pushed = false;
+        if (ret == NVML_SUCCESS)
+        {
+            // the buffer is circular, the samples don't come back oldest first
+            auto samples = stream.buffer.begin();
+            sort(samples, samples + count, [](const nvmlSample_t& a, const nvmlSample_t& b) { return a.timeStamp < b.timeStamp; });
+            for (unsigned int i = 0; i < count; i++)
+            {
+                const auto& sample = stream.buffer[i];
+                if (sample.timeStamp <= stream.lastSeen)
+                    continue;
+                stream.latest = float(getNvmlValue(valueType, sample.sampleValue) * stream.scale);
+                metrics.addMetric(stream.metric, stream.latest, int64_t(sample.timeStamp / 1000) + offsetMs);
+                stream.lastSeen = sample.timeStamp;
+                pushed = true;
+            }
+        }
+
+        if (pushed && !stream.streaming)
+        {
+            stream.streaming = true;
+            // turn the poll off once every stream it feeds is streaming
+            if (stream.pollName)
+            {
+                bool allStreaming = true;
+                for (const auto& other : driverStreams)
+                {
+                    if (other.pollName && strcmp(other.pollName, stream.pollName) == 0)
+                        allStreaming &= other.streaming;
+                }
+                if (allStreaming)
+                    plan.setCallEnabled(stream.pollName, false);
+            }
+        }
+        if (stream.streaming && stream.slot >= 0)
+            plan.set(stream.slot, stream.latest);
+    }
+}
+
+// processes tracked per GPU, 2 to 4 series each
+const size_t kMaxProcessTimelines = 16;
+// a process without samples for this long reads 0
+const int64_t kProcessQuietMs = 1000;
+// and is dropped after this long
+const int64_t kProcessIdleMs = 30 * 1000;
+// exe names are clipped to this in the series names, szExeFile holds up to MAX_PATH
+const size_t kMaxProcessNameLength = 32;
+
+NvidiaInfo::ProcessTimeline& NvidiaInfo::getProcessTimeline(uint32_t pid, int64_t now)
+{
+    ProcessMeta meta;
+    bool isKnown = lookupProcess(pid, &meta);
+
+    auto it = processTimelines.find(pid);
+    if (it != processTimelines.end())
+    {
+        if (!isKnown || it->second.startTime == meta.startTime)
+            return it->second;
+        // the pid was reused
+        removeProcessTimeline(pid);
+    }
+
+    // full, the least recently active one makes room
+    if (processTimelines.size() >= kMaxProcessTimelines)
+    {
+        auto oldest = processTimelines.begin();
+        for (auto k = processTimelines.begin(); k != processTimelines.end(); ++k)
+        {
+            if (k->second.lastSampleMs < oldest->second.lastSampleMs)
+                oldest = k;
+        }
+        removeProcessTimeline(oldest->first);
+    }
+
+    auto& timeline = processTimelines[pid];
+    timeline.startTime = isKnown ? meta.startTime : 0;
+    timeline.lastSampleMs = now;
+    string name = isKnown ? meta.exeName : string("pid");
+    if (name.size() > kMaxProcessNameLength)
+        name = name.substr(0, kMaxProcessNameLength - 3) + "...";
+    timeline.label = name + " (" + to_string(pid) + ")";
+    timeline.sm = procMetrics.addSeries("gpu", deviceId, timeline.label + " SM", "%");
+    timeline.mem = procMetrics.addSeries("gpu", deviceId, timeline.label + " MEM", "%");
+    return timeline;
+}
+
+void NvidiaInfo::removeProcessTimeline(uint32_t pid)
+{
+    auto it = processTimelines.find(pid);
+    if (it == processTimelines.end())
+        return;
+    for (auto handle : { it->second.sm, it->second.mem, it->second.enc, it->second.dec })
+    {
+        if (handle != INVALID_METRIC)
+            procMetrics.removeSeries(handle);
+    }
+    processTimelines.erase(it);
+}
+
+int NvidiaInfo::updateProcessTimelines()
+{
+    PROFILE_ZONE("updateProcessTimelines");
+    if (!bProcessUtilSupported || !_nvmlDeviceGetProcessUtilization)
+        return 0;
+
+    // only the samples newer than procLastSeen come back
+    if (procSamples.size() < 16)
+        procSamples.resize(16);
+    unsigned int count = (unsigned int)procSamples.size();
+    auto ret = _nvmlDeviceGetProcessUtilization(handle, procSamples.data(), &count, procLastSeen);
+    if (ret == NVML_ERROR_INSUFFICIENT_SIZE && count > procSamples.size())
+    {
+        procSamples.resize(count);
+        ret = _nvmlDeviceGetProcessUtilization(handle, procSamples.data(), &count, procLastSeen);
+    }
+    if (ret == NVML_ERROR_NOT_SUPPORTED)
+    {
+        bProcessUtilSupported = false;
+        return 0;
+    }
+    if (ret != NVML_SUCCESS && ret != NVML_ERROR_NOT_FOUND)
+    {
+        CHECK_NVML(ret, nvmlDeviceGetProcessUtilization);
+        return 0;
+    }
+
+    auto now = getMetricTimeMs();
+    if (ret == NVML_SUCCESS)
+    {
+        auto offsetMs = getWallToMetricOffsetMs();
+        auto newest = procLastSeen;
+        sort(procSamples.begin(), procSamples.begin() + count,
+            [](const nvmlProcessUtilizationSample_t& a, const nvmlProcessUtilizationSample_t& b) { return a.timeStamp < b.timeStamp; });
+        for (unsigned int i = 0; i < count; i++)
+        {
+            const auto& sample = procSamples[i];
+            if (sample.timeStamp <= procLastSeen)
+                continue;
+            auto& timeline = getProcessTimeline(sample.pid, now);
+            auto timeMs = int64_t(sample.timeStamp / 1000) + offsetMs;
+            procMetrics.addMetric(timeline.sm, (float)sample.smUtil, timeMs);
+            procMetrics.addMetric(timeline.mem, (float)sample.memUtil, timeMs);
+            if (timeline.enc == INVALID_METRIC && sample.encUtil > 0)
+                timeline.enc = procMetrics.addSeries("gpu", deviceId, timeline.label + " ENC", "%");
+            if (timeline.dec == INVALID_METRIC && sample.decUtil > 0)
+                timeline.dec = procMetrics.addSeries("gpu", deviceId, timeline.label + " DEC", "%");
+            procMetrics.addMetric(timeline.enc, (float)sample.encUtil, timeMs);
+            procMetrics.addMetric(timeline.dec, (float)sample.decUtil, timeMs);
+            timeline.lastSampleMs = now;
+            timeline.isQuiet = false;
+            newest = (std::max)(newest, sample.timeStamp);
+        }
+        procLastSeen = newest;
+    }
+
+    // the driver only reports the processes that ran since procLastSeen
+    for (auto it = processTimelines.begin(); it != processTimelines.end();)
+    {
+        auto& timeline = it->second;
+        auto quietMs = now - timeline.lastSampleMs;
+        if (quietMs > kProcessIdleMs)
+        {
+            auto pid = it->first;
+            ++it;
+            removeProcessTimeline(pid);
+            continue;
+        }
+        if (quietMs > kProcessQuietMs && !timeline.isQuiet)
+        {
+            for (auto handle : { timeline.sm, timeline.mem, timeline.enc, timeline.dec })
+                procMetrics.addMetric(handle, 0, now);
+            timeline.isQuiet = true;
+        }
+        ++it;
+    }
+    procMetrics.publish();
+
+    return 0;
+}
+
+bool NvidiaInfo::isStreamed(MetricHandle metric) const
+{
+    for (const auto& stream : driverStreams)
+    {
+        if (stream.metric == metric && stream.streaming)
+            return true;
+    }
+    return false;
+}
+
+int NvidiaInfo::update()
+{
+    PROFILE_ZONE("NvidiaInfo::update");
+
+    plan.sample(handle, _nvmlDeviceGetFieldValues);
+    // a hung offloaded call leaves a gap the way a hung device does, see superviseDevice()
+    auto nowMs = getMetricTimeMs();
+    if (plan.stalledCall)
+    {
+        if (offloadStallStartMs == 0)
+        {
+            offloadStallStartMs = nowMs - plan.stallUs / 1000;
+            metrics.addEvent(offloadStallStartMs, EVENT_CRITICAL, string(plan.stalledCall) + " not responding");
+            fprintf(stderr, "[NvidiaInfo::update] - GPU %u: %s hasn't returned in %d ms\r\n", deviceId, plan.stalledCall,
+                SamplingPlan::OFFLOAD_DEADLINE_MS);
+        }
+        metrics.addGap(offloadStallStartMs, nowMs);
+    }
+    else if (offloadStallStartMs != 0)
+    {
+        char text[64];
+        snprintf(text, sizeof(text), "responding again after %.1f s", (nowMs - offloadStallStartMs) / 1000.0);
+        metrics.addGap(offloadStallStartMs, nowMs);
+        metrics.addEvent(nowMs, EVENT_WARNING, text);
+        fprintf(stderr, "[NvidiaInfo::update] - GPU %u slow calls %s\r\n", deviceId, text);
+        offloadStallStartMs = 0;
+    }
+    // after the plan so the newest driver samples win in the slots
+    drainDriverSamples();
+    updateProcessTimelines();
+    addPendingEvents();
+
+    bGPUUtilSupported = plan.isValid(slots.sm);
+    bEncoderUtilSupported = plan.isValid(slots.enc);
+    bDecoderUtilSupported = plan.isValid(slots.dec);
+
+    // the polled value, for the series the driver buffers don't feed
+    auto addPolled = [&](MetricHandle metric, double value)
+    {
+        if (!isStreamed(metric))
+            metrics.addMetric(metric, (float)value);
+    };
+    addPolled(smMetric, plan.get(slots.sm));
+    addPolled(memMetric, plan.get(slots.mem));
+
+    // calculate the frame buffer memory utilization
+    auto fbUsed = plan.get(slots.fbUsed);
+    auto fbTotal = plan.get(slots.fbTotal);
+    metrics.addMetric(fbMetric, fbTotal > 0 ? float(fbUsed * 100 / fbTotal) : 0);
+
+    metrics.addMetric(tempMetric, plan.get(slots.temp));
+    addPolled(encMetric, plan.get(slots.enc));
+    addPolled(decMetric, plan.get(slots.dec));
+
+    // percent of the max clocks, so a drop reads the same on every board
+    if (plan.isValid(slots.smClock))
+        metrics.addMetric(smClockMetric, float(maxSmClock > 0 ? plan.get(slots.smClock) * 100 / maxSmClock : plan.get(slots.smClock)));
+    if (plan.isValid(slots.memClock))
+        metrics.addMetric(memClockMetric, float(maxMemClock > 0 ? plan.get(slots.memClock) * 100 / maxMemClock : plan.get(slots.memClock)));
+    if (throttleTrack >= 0 && plan.isValid(slots.throttle))
+        metrics.setBands(throttleTrack, (uint32_t)plan.get(slots.throttle));
+
+    double pcieUtilSum = plan.get(slots.pcieTx) + plan.get(slots.pcieRx);
+    float sol = pcieUtilSum * 0.1 / (pcieCurrentSpeed + 0.1f);
+    metrics.addMetric(pcieMetric, sol);
+
+    // Output the utilization results depending on which of the counters has data available
+    // I have opted to display "-" to denote an unsupported value rather than simply display "0"
+    // to clarify that the GPU/driver does not support the query. 
+    consoleLine.clear();
+    appendf(consoleLine, "%d %s", deviceId, bMonitorConnected ? "<-" : "");
+
+    if (bGPUUtilSupported) appendf(consoleLine, "\t%.0f\t%.0f", plan.get(slots.sm), plan.get(slots.mem));
+    else appendf(consoleLine, "\t-\t-");
+    appendf(consoleLine, "\t%.0f / %.0f", fbUsed, fbTotal);
+    appendf(consoleLine, "\t%-5.0f\t%-6.0f", plan.get(slots.smClock), plan.get(slots.memClock));
+    appendf(consoleLine, "\t%-6.0f\t%-6.0f", plan.get(slots.pcieTx) / 1024, plan.get(slots.pcieRx) / 1024);
+
+#if 0
+    if (bEncoderUtilSupported) printf("\t%d", uiVidEncoderUtil);
+    else printf("\t-");
+    if (bDecoderUtilSupported) printf("\t%d", uiVidDecoderUtil);
+    else printf("\t-");
+#endif
+    if (numActiveLinks > 0)
+    {
+        updateNvLinkRates();
+        appendf(consoleLine, "\t%-5.0f\t%-5.0f", nvlinkTxBytesPerSecond / 1e6, nvlinkRxBytesPerSecond / 1e6);
+    }
+
+    if (accountingCadence.isDue())
+    {
+        auto t0 = chrono::steady_clock::now();
+        updatePerProcessInfo();
+        accountingCadence.record(chrono::duration<float, micro>(chrono::steady_clock::now() - t0).count());
+        if (accountingCadence.runs >= CallCadence::MIN_RUNS && accountingCadence.costUs > kSampleBudgetUs / 2
+            && accountingCadence.slowDown())
+        {
+            fprintf(stderr, "[NvidiaInfo::update] - nvmlDeviceGetAccountingStats takes %.1f ms, now every %d ticks\r\n",
+                accountingCadence.costUs / 1000, accountingCadence.period);
+        }
+    }
+
+    auto& reports = costReports->writeBuffer();
+    plan.getReports(&reports);
+    if (accountingCadence.runs > 0)
+    {
+        reports.push_back({ "nvmlDeviceGetAccountingStats", accountingCadence.costUs, accountingCadence.maxCostUs,
+            accountingCadence.period, false });
+    }
+    costReports->publish();
+
+    metrics.publish();
+
+    return 0;
+}
+
+void NvidiaInfo::updateNvLinkRates()
+{
+    // percent of the link speed, MB/s when it's unknown
+    auto normalize = [](double bytesPerSecond, double maxBytesPerSecond)
+    {
+        return float(maxBytesPerSecond > 0 ? bytesPerSecond * 100 / maxBytesPerSecond : bytesPerSecond / 1e6);
+    };
+
+    double txTotal = 0, rxTotal = 0, maxTotal = 0;
+    bool hasRate = false;
+    for (uint32_t j = 0; j < numLinks; j++)
+    {
+        if (!isNvLinkActive(j))
+            continue;
+        auto& link = nvlinkRates[j];
+        double maxBytesPerSecond = nvlinkMaxSpeeds[j] * 1e6;
+        // the counters are 64 bit, KiB when read as fields
+        double unit = plan.isBatched(slots.nvlinkTx[j]) ? 1024 : 1;
+        double rate = 0;
+        int tx = slots.nvlinkTx[j], rx = slots.nvlinkRx[j];
+        if (plan.isValid(tx) && link.tx.update(plan.getCounter(tx), plan.getTimeUs(tx), 64, maxBytesPerSecond / unit, &rate))
+        {
+            link.txBytesPerSecond = rate * unit;
+            hasRate = true;
+            metrics.addMetric(link.txMetric, normalize(link.txBytesPerSecond, maxBytesPerSecond));
+        }
+        if (plan.isValid(rx) && link.rx.update(plan.getCounter(rx), plan.getTimeUs(rx), 64, maxBytesPerSecond / unit, &rate))
+        {
+            link.rxBytesPerSecond = rate * unit;
+            hasRate = true;
+            metrics.addMetric(link.rxMetric, normalize(link.rxBytesPerSecond, maxBytesPerSecond));
+        }
+        txTotal += link.txBytesPerSecond;
+        rxTotal += link.rxBytesPerSecond;
+        maxTotal += maxBytesPerSecond;
+    }
+    nvlinkTxBytesPerSecond = txTotal;
+    nvlinkRxBytesPerSecond = rxTotal;
+    // the first reading of the counters is no rate yet
+    if (!hasRate)
+        return;
+    metrics.addMetric(nvlinkTxMetric, normalize(txTotal, maxTotal));
+    metrics.addMetric(nvlinkRxMetric, normalize(rxTotal, maxTotal));
+}
+
+int NvidiaInfo::updatePower()
+{
+    // update() drains the driver's own power samples
+    if (isStreamed(powerMetric))
+        return 0;
+
+    uint32_t power = 0;
+    auto nvRetValue = _nvmlDeviceGetPowerUsage(handle, &power);
+    CHECK_NVML(nvRetValue, nvmlDeviceGetPowerUsage);
+    metrics.addMetric(powerMetric, power * 0.001f);
+
+    return 0;
+}
+
+int NvidiaInfo::updatePerProcessInfo()
+{
+    PROFILE_ZONE("updatePerProcessInfo");
+    nvmlReturn_t ret;
+#if 0
+    // nvmlDeviceGetGraphicsRunningProcesses and nvmlDeviceGetComputeRunningProcesses gives wrong results
+    {
+        unsigned int infoCount = 0;
+        ret = _nvmlDeviceGetGraphicsRunningProcesses(handle, &infoCount, nullptr);
+        if (ret == NVML_ERROR_INSUFFICIENT_SIZE || ret == NVML_SUCCESS)
+        {
+            vector<nvmlProcInfo_t> infos(infoCount);
+            ret = _nvmlDeviceGetGraphicsRunningProcesses(handle, &infoCount, infos.data());
+            int a = 0;
+        }
+    }
+    {
+        unsigned int infoCount = 0;
+        ret = _nvmlDeviceGetComputeRunningProcesses(handle, &infoCount, nullptr);
+        if (ret == NVML_ERROR_INSUFFICIENT_SIZE || ret == NVML_SUCCESS)
+        {
+            vector<nvmlProcInfo_t> infos(infoCount);
+            ret = _nvmlDeviceGetComputeRunningProcesses(handle, &infoCount, infos.data());
+            int a = 0;
+        }
+    }
+#endif
+    nvmlEnableState_t mode;
+    ret = _nvmlDeviceGetAccountingMode(handle, &mode);
+    if (mode == NVML_FEATURE_DISABLED)
+        return ret;
+
+    ProcInfos.clear();
+    unsigned int pidCount = 0;
+    ret = _nvmlDeviceGetAccountingPids(handle, &pidCount, nullptr);
+    if (pidCount > 0)
+    {
+        vector<unsigned int> pids(pidCount);
+        ret = _nvmlDeviceGetAccountingPids(handle, &pidCount, pids.data());
+        CHECK_NVML(ret, nvmlDeviceGetAccountingPids);
+        for (auto pid : pids)
+        {
+            nvmlAccountingStats_t gpuStats;
+            ret = _nvmlDeviceGetAccountingStats(handle, pid, &gpuStats);
+            CHECK_NVML(ret, nvmlDeviceGetAccountingStats);
+            if (gpuStats.isRunning && (gpuStats.gpuUtilization > 0 || gpuStats.memoryUtilization > 0))
+            {
+#if 0
+                char name[80];
+                nvmlSystemGetProcessName(pid, name, 80);
+#endif
+                auto p = ProcInfo();
+                p.pid = pid;
+                lookupProcess(pid, &p.cpuStats);
+                p.exeName = p.cpuStats.exeName;
+                p.gpuStats = gpuStats;
+                ProcInfos.emplace_back(p);
+            }
+        }
+    }
+    procSnapshots->writeBuffer() = ProcInfos;
+    procSnapshots->publish();
+
+    return 0;
+}
+
+void NvidiaInfo::draw(bool show_legends)
+{
+    CImg<unsigned char> img(window->width(), window->height(), 1, 3, 50);
+    img.draw_grid(-50 * 100.0f / window->width(), -50 * 100.0f / 256, 0, 0, false, true, colors[0], 0.2f, 0xCCCCCCCC, 0xCCCCCCCC);
+
+    if (cimgLastChart >= 0)
+        metrics.draw(window, img, 0, cimgLastChart, show_legends);
+
+    // per process info
+    if (show_legends)
+    {
+        int k = 0;
+        for (const auto& p : procSnapshots->read())
+        {
+            img.draw_text(100, FONT_HEIGHT * (k + 1),
+                "%s (%d): %d%% | %d%% \n",
+                colors[9], 0, 1, FONT_HEIGHT,
+                p.exeName.c_str(), p.pid, p.gpuStats.gpuUtilization, p.gpuStats.memoryUtilization);
+            k++;
+        }
+    }
+    {
+        PROFILE_ZONE("img.display");
+        img.display(*window);
+    }
+}
+
+// TODO
+// shared with the jobs of the workers, a job left behind past its deadline keeps its device alive
+static vector<shared_ptr<NvidiaInfo>> NvidiaInfos;
+extern void addWindow(shared_ptr<CImgDisplay> window);
+extern bool isCimgVisible;
+extern char exe_folder[];
+uint32_t uiNumGPUs = 0;
+
+// nvidia_setup() runs on the collector thread while the UI is already up,
+// the draw functions leave NvidiaInfos alone until it is done
+enum NvidiaState
+{
+    NVIDIA_STARTING,
+    NVIDIA_READY,
+    NVIDIA_FAILED,
+};
+static atomic<int> nvidiaState(NVIDIA_STARTING);
+
+// GPU x GPU view of the NVLinks, resolved once from the remote PCI bus ids of every link.
+// Row major [from * deviceCount + to], the live part is published by the collector thread.
+namespace
+{
+    struct PeerTopology
+    {
+        int deviceCount = 0;
+        int linkTotal = 0;
+        vector<int> linkCounts;
+        vector<double> capacityBytesPerSecond;     // per direction
+        vector<int> pcieLevels;                    // nvmlGpuTopologyLevel_t, -1 when unknown
+    };
+
+    struct TopologySnapshot
+    {
+        vector<double> txBytesPerSecond;
+        vector<float> utilization;                 // percent of the capacity
+    };
+
+    PeerTopology peerTopology;
+    SnapshotBuffer<TopologySnapshot> topologySnapshots;
+
+    bool isSamePciDevice(const nvmlPciInfo_t& a, const nvmlPciInfo_t& b)
+    {
+        return a.domain == b.domain && a.bus == b.bus && a.device == b.device;
+    }
+
+    void buildPeerTopology()
+    {
+        int n = (int)NvidiaInfos.size();
+        auto& topology = peerTopology;
+        topology.deviceCount = n;
+        topology.linkCounts.assign(n * n, 0);
+        topology.capacityBytesPerSecond.assign(n * n, 0);
+        topology.pcieLevels.assign(n * n, -1);
+        for (int i = 0; i < n; i++)
+        {
+            auto& info = *NvidiaInfos[i];
+            for (uint32_t j = 0; j < NVML_NVLINK_MAX_LINKS; j++)
+            {
+                info.nvlinkPeers[j] = -1;
+                if (!info.isNvLinkActive(j))
+                    continue;
+                for (int p = 0; p < n; p++)
+                {
+                    if (p != i && isSamePciDevice(info.nvlinkPciInfos[j], NvidiaInfos[p]->pciInfo))
+                        info.nvlinkPeers[j] = p;
+                }
+                int peer = info.nvlinkPeers[j];
+                if (peer < 0)
+                    continue;
+                topology.linkCounts[i * n + peer]++;
+                topology.capacityBytesPerSecond[i * n + peer] += info.nvlinkMaxSpeeds[j] * 1e6;
+                topology.linkTotal++;
+            }
+            for (int p = 0; p < n; p++)
+            {
+                nvmlGpuTopologyLevel_t level;
+                if (p != i && _nvmlDeviceGetTopologyCommonAncestor(info.handle, NvidiaInfos[p]->handle, &level) == NVML_SUCCESS)
+                    topology.pcieLevels[i * n + p] = level;
+            }
+        }
+    }
+
+    // the TX rate of every link rolled up per pair, the sender is the row
+    void publishTopology()
+    {
+        auto& topology = peerTopology;
+        if (topology.linkTotal == 0)
+            return;
+        int n = topology.deviceCount;
+        auto& snapshot = topologySnapshots.writeBuffer();
+        snapshot.txBytesPerSecond.assign(n * n, 0);
+        snapshot.utilization.assign(n * n, 0);
+        for (int i = 0; i < n; i++)
+        {
+            const auto& info = *NvidiaInfos[i];
+            // its worker still owns the rates, or they stopped with the device
+            if (info.stallStartMs != 0 || info.lostSinceMs != 0)
+                continue;
+            for (uint32_t j = 0; j < NVML_NVLINK_MAX_LINKS; j++)
+            {
+                if (info.nvlinkPeers[j] >= 0)
+                    snapshot.txBytesPerSecond[i * n + info.nvlinkPeers[j]] += info.nvlinkRates[j].txBytesPerSecond;
+            }
+        }
+        for (int k = 0; k < n * n; k++)
+        {
+            auto capacity = topology.capacityBytesPerSecond[k];
+            snapshot.utilization[k] = capacity > 0 ? float(snapshot.txBytesPerSecond[k] * 100 / capacity) : 0;
+        }
+        topologySnapshots.publish();
+    }
+
+    const char* getPcieLevelName(int level)
+    {
+        switch (level)
+        {
+        case NVML_TOPOLOGY_INTERNAL: return "same board";
+        case NVML_TOPOLOGY_SINGLE: return "PCIe switch";
+        case NVML_TOPOLOGY_MULTIPLE: return "PCIe switches";
+        case NVML_TOPOLOGY_HOSTBRIDGE: return "host bridge";
+        case NVML_TOPOLOGY_NODE: return "NUMA node";
+        case NVML_TOPOLOGY_SYSTEM: return "across NUMA nodes";
+        default: return "unknown";
+        }
+    }
+
+    void drawTopologyImgui()
+    {
+        const auto& topology = peerTopology;
+        if (topology.linkTotal == 0 || !ImGui::CollapsingHeader("NVLink topology"))
+            return;
+        const auto& snapshot = topologySnapshots.read();
+        int n = topology.deviceCount;
+        if ((int)snapshot.utilization.size() != n * n)
+            return;
+
+        vector<string> names(n);
+        vector<const char*> labels(n);
+        vector<double> columns(n), rows(n);
+        for (int i = 0; i < n; i++)
+        {
+            names[i] = "GPU" + to_string(i);
+            labels[i] = names[i].c_str();
+            columns[i] = i + 0.5;
+            // PlotHeatmap draws the first row at the top
+            rows[i] = n - i - 0.5;
+        }
+
+        float side = min(ImGui::GetContentRegionAvail().x - 80, 120.0f + 40 * n);
+        ImPlot::PushColormap(ImPlotColormap_Viridis);
+        if (ImPlot::BeginPlot("##topology", ImVec2(side, side), ImPlotFlags_NoLegend | ImPlotFlags_NoMouseText))
+        {
+            auto axisFlags = ImPlotAxisFlags_NoGridLines | ImPlotAxisFlags_NoTickMarks | ImPlotAxisFlags_Lock;
+            ImPlot::SetupAxes("to", "from", axisFlags, axisFlags);
+            ImPlot::SetupAxesLimits(0, n, 0, n, ImPlotCond_Always);
+            ImPlot::SetupAxisTicks(ImAxis_X1, columns.data(), n, labels.data());
+            ImPlot::SetupAxisTicks(ImAxis_Y1, rows.data(), n, labels.data());
+            ImPlot::PlotHeatmap("TX", snapshot.utilization.data(), n, n, 0, 100, "%.0f%%", ImPlotPoint(0, 0), ImPlotPoint(n, n));
+
+            if (ImPlot::IsPlotHovered())
+            {
+                auto mouse = ImPlot::GetPlotMousePos();
+                int to = (int)mouse.x;
+                int from = n - 1 - (int)mouse.y;
+                if (to >= 0 && to < n && from >= 0 && from < n && to != from)
+                {
+                    int k = from * n + to;
+                    ImGui::BeginTooltip();
+                    ImGui::Text("GPU%d -> GPU%d", from, to);
+                    if (topology.linkCounts[k] > 0)
+                    {
+                        ImGui::Text("%d NVLinks, %.1f GB/s", topology.linkCounts[k], topology.capacityBytesPerSecond[k] / 1e9);
+                        ImGui::Text("TX %.2f GB/s, %.0f%%", snapshot.txBytesPerSecond[k] / 1e9, snapshot.utilization[k]);
+                    }
+                    else
+                    {
+                        ImGui::Text("no NVLink, PCIe via %s", getPcieLevelName(topology.pcieLevels[k]));
+                    }
+                    ImGui::EndTooltip();
+                }
+            }
+            ImPlot::EndPlot();
+        }
+        ImGui::SameLine();
+        ImPlot::ColormapScale("%##topology scale", 0, 100, ImVec2(60, side), "%g%%");
+        ImPlot::PopColormap();
+    }
+}
+
+// where the NVML time goes: every entry point, then what the cost control did per device
+static void drawCallCostImgui()
+{
+    if (!ImGui::CollapsingHeader("NVML call cost"))
+        return;
+
+    static vector<NvmlCallCost> costs;
+    nvml_stub_get_costs(&costs);
+    if (ImGui::BeginTable("entry points", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+    {
+        const char* headers[] = { "entry point", "calls", "p50", "p99", "max", "total" };
+        for (auto header : headers)
+            ImGui::TableSetupColumn(header);
+        ImGui::TableHeadersRow();
+        for (const auto& c : costs)
+        {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn(); ImGui::Text("%s", c.name);
+            ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)c.calls);
+            ImGui::TableNextColumn(); ImGui::Text("%.0f us", c.p50Us);
+            ImGui::TableNextColumn(); ImGui::Text("%.0f us", c.p99Us);
+            ImGui::TableNextColumn(); ImGui::Text("%.0f us", c.maxUs);
+            ImGui::TableNextColumn(); ImGui::Text("%.1f ms", c.totalUs / 1000);
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::Text("budget %.1f ms per device and tick", kSampleBudgetUs / 1000);
+    for (auto& info : NvidiaInfos)
+    {
+        ImGui::PushID(info.get());
+        if (ImGui::TreeNode(info->cDevicename))
+        {
+            if (ImGui::BeginTable("calls", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+            {
+                const char* headers[] = { "query", "avg", "max", "runs" };
+                for (auto header : headers)
+                    ImGui::TableSetupColumn(header);
+                ImGui::TableHeadersRow();
+                for (const auto& r : info->costReports->read())
+                {
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn(); ImGui::Text("%s", r.name);
+                    ImGui::TableNextColumn(); ImGui::Text("%.2f ms", r.costUs / 1000);
+                    ImGui::TableNextColumn(); ImGui::Text("%.2f ms", r.maxCostUs / 1000);
+                    ImGui::TableNextColumn();
+                    if (r.isOffloaded)
+                        ImGui::TextColored(ImVec4(1, 0.6f, 0.2f, 1), "in the background");
+                    else if (r.period > 1)
+                        ImGui::TextColored(ImVec4(1, 0.8f, 0.2f, 1), "every %d ticks", r.period);
+                    else
+                        ImGui::Text("every tick");
+                }
+                ImGui::EndTable();
+            }
+            ImGui::TreePop();
+        }
+        ImGui::PopID();
+    }
+}
+
+// XID errors and clock / power state changes block a thread of their own in nvmlEventSetWait,
+// they land on the charts with the time they happened rather than at the next poll.
+// The thread makes no other NVML call, the worker of the device describes the events, see addPendingEvents().
+namespace
+{
+    const unsigned long long kWatchedEvents = nvmlEventTypeXidCriticalError | nvmlEventTypeClock
+        | nvmlEventTypePState | nvmlEventTypePowerSourceChange;
+    // how long the thread takes to notice stopEventWatcher()
+    const unsigned int kEventWaitMs = 500;
+
+    // shared with the thread, outlives the watcher when stopEventWatcher() gives up on it
+    struct EventWatch
+    {
+        nvmlEventSet_t eventSet = nullptr;
+        atomic<bool> isWatching{ true };
+        vector<pair<nvmlDevice_t, shared_ptr<PendingEvents>>> devices;
+        mutex lock;
+        condition_variable done;
+        bool isDone = false;
+    };
+    shared_ptr<EventWatch> eventWatch;
+    thread eventThread;
+    // a thread stopEventWatcher() gave up on, NVML can't shut down before it returned
+    shared_ptr<EventWatch> leftBehindWatch;
+
+    const char* getXidName(unsigned long long xid)
+    {
+        switch (xid)
+        {
+        case 13: return "graphics engine exception";
+        case 31: return "memory page fault";
+        case 43: return "GPU stopped processing";
+        case 45: return "preemptive cleanup";
+        case 48: return "double bit ECC error";
+        case 61: case 62: return "internal micro-controller error";
+        case 63: case 64: return "ECC page retirement or row remapping";
+        case 74: return "NVLink error";
+        case 79: return "GPU has fallen off the bus";
+        case 92: return "high single bit ECC error rate";
+        case 94: return "contained ECC error";
+        case 95: return "uncontained ECC error";
+        default: return "";
+        }
+    }
+
+    void watchEvents(shared_ptr<EventWatch> watch)
+    {
+        setProfileThreadName("nvidia events");
+        while (watch->isWatching)
+        {
+            nvmlEventData_t data = {};
+            auto ret = _nvmlEventSetWait_v2(watch->eventSet, &data, kEventWaitMs);
+            if (ret == NVML_ERROR_TIMEOUT)
+                continue;
+            if (ret != NVML_SUCCESS)
+            {
+                fprintf(stderr, "[watchEvents] - nvmlEventSetWait failed, %s\r\n", _nvmlErrorString(ret));
+                break;
+            }
+            // stamped as soon as the thread wakes up, NVML doesn't say when it happened
+            auto timeMs = getMetricTimeMs();
+            for (auto& device : watch->devices)
+            {
+                if (device.first != data.device)
+                    continue;
+                auto& pending = *device.second;
+                lock_guard<mutex> guard(pending.lock);
+                if (pending.events.size() >= PendingEvents::CAPACITY)
+                {
+                    pending.events.erase(pending.events.begin());
+                    pending.dropped++;
+                }
+                pending.events.emplace_back(timeMs, data);
+            }
+        }
+        lock_guard<mutex> guard(watch->lock);
+        watch->isDone = true;
+        watch->done.notify_all();
+    }
+
+    void startEventWatcher()
+    {
+        auto watch = make_shared<EventWatch>();
+        auto ret = _nvmlEventSetCreate(&watch->eventSet);
+        if (ret != NVML_SUCCESS)
+            return;
+        for (auto& info : NvidiaInfos)
+        {
+            unsigned long long supported = 0;
+            if (_nvmlDeviceGetSupportedEventTypes(info->handle, &supported) != NVML_SUCCESS)
+                continue;
+            // on Windows (WDDM) most devices only support some of them
+            if ((supported & kWatchedEvents) != 0
+                && _nvmlDeviceRegisterEvents(info->handle, supported & kWatchedEvents, watch->eventSet) == NVML_SUCCESS)
+                watch->devices.emplace_back(info->handle, info->pendingEvents);
+        }
+        if (watch->devices.empty())
+        {
+            _nvmlEventSetFree(watch->eventSet);
+            return;
+        }
+        eventWatch = watch;
+        eventThread = thread(watchEvents, watch);
+    }
+
+    bool waitEventWatch(EventWatch& watch, int timeoutMs)
+    {
+        unique_lock<mutex> guard(watch.lock);
+        return watch.done.wait_for(guard, chrono::milliseconds(timeoutMs), [&] { return watch.isDone; });
+    }
+
+    // Joins the thread, still in nvmlEventSetWait after timeoutMs it is detached and looked at again
+    // by the next call. False until it returned, NVML isn't safe to shut down then.
+    bool stopEventWatcher(int timeoutMs)
+    {
+        if (leftBehindWatch)
+        {
+            if (!waitEventWatch(*leftBehindWatch, timeoutMs))
+                return false;
+            _nvmlEventSetFree(leftBehindWatch->eventSet);
+            leftBehindWatch.reset();
+        }
+        if (!eventWatch)
+            return true;
+
+        eventWatch->isWatching = false;
+        bool isDone = waitEventWatch(*eventWatch, timeoutMs);
+        if (isDone)
+        {
+            eventThread.join();
+            _nvmlEventSetFree(eventWatch->eventSet);
+        }
+        else
+        {
+            fprintf(stderr, "[stopEventWatcher] - nvmlEventSetWait still hasn't returned, left behind\r\n");
+            eventThread.detach();
+            leftBehindWatch = eventWatch;
+        }
+        eventWatch.reset();
+        return isDone;
+    }
+}
+
+// the events of the watcher since the last update, on the worker so the queries are supervised,
+// the clocks come from the plan and the other queries run once per update however many events came in
+void NvidiaInfo::addPendingEvents()
+{
+    vector<pair<int64_t, nvmlEventData_t>> events;
+    int64_t dropped;
+    {
+        lock_guard<mutex> guard(pendingEvents->lock);
+        events.swap(pendingEvents->events);
+        dropped = pendingEvents->dropped;
+        pendingEvents->dropped = 0;
+    }
+    if (dropped > 0)
+        fprintf(stderr, "[NvidiaInfo::addPendingEvents] - GPU %u: %lld events dropped\r\n", deviceId, (long long)dropped);
+
+    bool hasPstate = false, hasSource = false;
+    nvmlReturn_t pstateRet = NVML_SUCCESS, sourceRet = NVML_SUCCESS;
+    nvmlPstates_t pstate = NVML_PSTATE_UNKNOWN;
+    nvmlPowerSource_t source = 0;
+    for (const auto& event : events)
+    {
+        const auto& data = event.second;
+        char text[128];
+        int severity = EVENT_INFO;
+        if (data.eventType & nvmlEventTypeXidCriticalError)
+        {
+            severity = EVENT_CRITICAL;
+            snprintf(text, sizeof(text), "XID %llu %s", data.eventData, getXidName(data.eventData));
+        }
+        else if (data.eventType & nvmlEventTypePState)
+        {
+            if (!hasPstate)
+            {
+                hasPstate = true;
+                setWatchdogStep("nvmlDeviceGetPerformanceState");
+                pstateRet = _nvmlDeviceGetPerformanceState(handle, &pstate);
+            }
+            if (pstateRet == NVML_SUCCESS && pstate != NVML_PSTATE_UNKNOWN)
+                snprintf(text, sizeof(text), "P%d", (int)pstate);
+            else
+                snprintf(text, sizeof(text), "pstate change");
+        }
+        else if (data.eventType & nvmlEventTypeClock)
+        {
+            if (plan.isValid(slots.smClock) && plan.isValid(slots.memClock))
+                snprintf(text, sizeof(text), "clocks %.0f / %.0f MHz", plan.get(slots.smClock), plan.get(slots.memClock));
+            else
+                snprintf(text, sizeof(text), "clock change");
+        }
+        else if (data.eventType & nvmlEventTypePowerSourceChange)
+        {
+            severity = EVENT_WARNING;
+            if (!hasSource)
+            {
+                hasSource = true;
+                setWatchdogStep("nvmlDeviceGetPowerSource");
+                sourceRet = _nvmlDeviceGetPowerSource(handle, &source);
+            }
+            if (sourceRet == NVML_SUCCESS)
+                snprintf(text, sizeof(text), "power source %s", source == NVML_POWER_SOURCE_AC ? "AC" : "battery");
+            else
+                snprintf(text, sizeof(text), "power source change");
+        }
+        else
+        {
+            snprintf(text, sizeof(text), "event 0x%llx", data.eventType);
+        }
+        metrics.addEvent(event.first, severity, text);
+        if (severity == EVENT_CRITICAL)
+            fprintf(stderr, "[NvidiaInfo::addPendingEvents] - GPU %u: %s\r\n", deviceId, text);
+    }
+    setWatchdogStep(nullptr);
+}
+
+// Every device is sampled by a supervised worker of its own. A call that doesn't come back within
+// kCallDeadlineMs leaves a gap on the charts of that device rather than stalling the collector,
+// the device is skipped until it returns. A stall past kQuarantineMs, or a call answering that
+// NVML lost its state, gets NVML shut down and started again once no call is in flight,
+// a quarantined device is skipped until then.
+namespace
+{
+    const int kCallDeadlineMs = 500;
+    // the driver takes a few seconds to recover from a TDR
+    const int64_t kQuarantineMs = 5000;
+    const int64_t kReinitRetryMs = 5000;
+    // how long reinitNvml() waits for the calls in flight, the restart is retried later past that
+    const int kReinitDrainMs = 1000;
+
+    bool isNvmlLost = false;
+    int64_t nextReinitMs = 0;
+
+    void setStatus(NvidiaInfo& info, const string& status)
+    {
+        info.statusSnapshots->writeBuffer() = status;
+        info.statusSnapshots->publish();
+    }
+
+    // only touches the panel once the worker gave it back
+    void superviseDevice(NvidiaInfo& info, bool isSubmitted, int64_t deadlineUs)
+    {
+        auto nowMs = getMetricTimeMs();
+        if (info.lostSinceMs != 0)
+        {
+            info.metrics.addGap(info.lostSinceMs, nowMs);
+            info.metrics.publish();
+            return;
+        }
+
+        bool isIdle = isSubmitted ? info.worker.wait(deadlineUs) : !info.worker.isBusy();
+        if (!isIdle)
+        {
+            const char* name = "";
+            const char* step = nullptr;
+            int64_t elapsedUs = 0;
+            info.worker.getRunning(&name, &step, &elapsedUs);
+            step = step ? step : name;
+            if (info.stallStartMs == 0)
+            {
+                info.stallStartMs = info.submitMs;
+                info.metrics.addEvent(info.submitMs, EVENT_CRITICAL, string(step) + " not responding");
+                fprintf(stderr, "[superviseDevice] - GPU %u: %s hasn't returned in %d ms\r\n", info.deviceId, step, kCallDeadlineMs);
+            }
+            if (!info.isQuarantined && nowMs - info.stallStartMs > kQuarantineMs)
+            {
+                info.isQuarantined = true;
+                fprintf(stderr, "[superviseDevice] - GPU %u quarantined, NVML restarts once %s returns\r\n", info.deviceId, step);
+            }
+            char status[160];
+            snprintf(status, sizeof(status), "not responding, in %s for %.1f s%s", step, elapsedUs / 1e6,
+                info.isQuarantined ? ", NVML restarts once it returns" : "");
+            setStatus(info, status);
+            return;
+        }
+
+        // back, but its handle is likely stale after that long, it waits for reinitNvml()
+        if (info.isQuarantined)
+        {
+            isNvmlLost = true;
+            info.metrics.addGap(info.stallStartMs, nowMs);
+            info.metrics.publish();
+            setStatus(info, "quarantined, waiting for NVML to restart");
+            return;
+        }
+
+        if (info.stallStartMs != 0)
+        {
+            char text[64];
+            snprintf(text, sizeof(text), "responding again after %.1f s", (nowMs - info.stallStartMs) / 1000.0);
+            info.metrics.addGap(info.stallStartMs, nowMs);
+            info.metrics.addEvent(nowMs, EVENT_WARNING, text);
+            fprintf(stderr, "[superviseDevice] - GPU %u %s\r\n", info.deviceId, text);
+            info.stallStartMs = 0;
+            setStatus(info, "");
+        }
+        if (info.plan.isLost)
+            isNvmlLost = true;
+    }
+
+    // fn(info) on every device that isn't stalled, waits for them until the deadline
+    void runSupervised(const char* name, void (*fn)(NvidiaInfo& info))
+    {
+        auto deadlineUs = getSchedulerTimeUs() + kCallDeadlineMs * 1000;
+        auto nowMs = getMetricTimeMs();
+        // the devices are sampled at the same time, each one only touches its own NvidiaInfo
+        vector<bool> isSubmitted(NvidiaInfos.size());
+        for (size_t i = 0; i < NvidiaInfos.size(); i++)
+        {
+            auto& info = *NvidiaInfos[i];
+            if (info.lostSinceMs != 0 || info.stallStartMs != 0)
+                continue;
+            // the job holds on to its device, nvidia_cleanup() may give up on it
+            auto device = NvidiaInfos[i];
+            isSubmitted[i] = info.worker.submit(name, [device, fn] { fn(*device); });
+            if (isSubmitted[i])
+                info.submitMs = nowMs;
+        }
+        for (size_t i = 0; i < NvidiaInfos.size(); i++)
+            superviseDevice(*NvidiaInfos[i], isSubmitted[i], deadlineUs);
+    }
+
+    // looks the devices up again by PCI bus id, the ones not found stay lost and are retried
+    void reinitNvml()
+    {
+        auto nowMs = getMetricTimeMs();
+        if (nowMs < nextReinitMs)
+            return;
+        nextReinitMs = nowMs + kReinitRetryMs;
+
+        // nvmlShutdown under a running call isn't safe, nothing new is submitted meanwhile
+        auto deadlineUs = getSchedulerTimeUs() + kReinitDrainMs * 1000;
+        for (auto& info : NvidiaInfos)
+        {
+            if (!info->worker.wait(deadlineUs) || !info->plan.waitOffload(deadlineUs))
+            {
+                fprintf(stderr, "[reinitNvml] - GPU %u still has a call in flight, NVML restarts in %lld s\r\n",
+                    info->deviceId, (long long)(kReinitRetryMs / 1000));
+                return;
+            }
+        }
+        // the same for the event watcher, in nvmlEventSetWait
+        if (!stopEventWatcher(kReinitDrainMs))
+        {
+            fprintf(stderr, "[reinitNvml] - the event watcher is still in NVML, NVML restarts in %lld s\r\n",
+                (long long)(kReinitRetryMs / 1000));
+            return;
+        }
+        nowMs = getMetricTimeMs();
+
+        fprintf(stderr, "[reinitNvml] - starting NVML again\r\n");
+        for (auto& info : NvidiaInfos)
+            info->plan.stop(0);
+        _nvmlShutdown();
+        auto ret = _nvmlInit_v2();
+        if (ret != NVML_SUCCESS)
+        {
+            fprintf(stderr, "[reinitNvml] - nvmlInit failed, %s\r\n", _nvmlErrorString(ret));
+            return;
+        }
+
+        isNvmlLost = false;
+        for (auto& info : NvidiaInfos)
+        {
+            // the quarantine ends with the restart, whether the device is found again or not
+            if (info->isQuarantined)
+            {
+                info->metrics.addGap(info->stallStartMs, nowMs);
+                info->stallStartMs = 0;
+                info->isQuarantined = false;
+                setStatus(*info, "");
+            }
+
+            nvmlDevice_t handle = NULL;
+            ret = _nvmlDeviceGetHandleByPciBusId_v2(info->pciInfo.busId, &handle);
+            if (ret != NVML_SUCCESS)
+            {
+                if (info->lostSinceMs == 0)
+                {
+                    info->lostSinceMs = nowMs;
+                    info->metrics.addEvent(nowMs, EVENT_CRITICAL, "lost after the NVML restart");
+                    fprintf(stderr, "[reinitNvml] - GPU %u at %s not found, %s\r\n", info->deviceId, info->pciInfo.busId, _nvmlErrorString(ret));
+                    setStatus(*info, "lost, looked for again every few seconds");
+                }
+                isNvmlLost = true;
+                continue;
+            }
+            info->handle = handle;
+            info->rebuildSamplingPlan();
+            info->metrics.addEvent(nowMs, EVENT_WARNING, "NVML restarted");
+            if (info->lostSinceMs != 0)
+            {
+                info->metrics.addGap(info->lostSinceMs, nowMs);
+                info->lostSinceMs = 0;
+                setStatus(*info, "");
+            }
+        }
+        startEventWatcher();
+    }
+}
+
+
+// next to the exe, one entry per device of the current driver
+const char* const kInventoryFileName = "gpuprof_devices.bin";
+
+static int startNvml()
+{
+#ifdef NV_PERF_ENABLE_INSTRUMENTATION
+    const bool initializeNvPerfResult = InitializeNvPerf();
+    if (initializeNvPerfResult)
+    {
+        const bool openGLLoadDriverResult = OpenGLLoadDriver(); // device periodic sampler requires at least one driver to be loaded
+        if (initializeNvPerfResult)
+        {
+            nsightDeviceIndex = GetCompatibleGpuDeviceIndex();
+            if (nsightDeviceIndex == size_t(~0))
+            {
+                printf("Current device is unsupported, test is skipped.\n");
+                return 1;
+            }
+
+            const size_t MaxNumUndecodedSamples = 1024;
+            const size_t RecordBufferSize = 256 * 1024 * 1024; // 256 MB
+        }
+    }
+#endif
+    nvmlReturn_t nvRetValue = NVML_ERROR_UNINITIALIZED;
+
+    if (!LoadNVML())
+        return -1;
+    // names the call a hung device is blocked in
+    nvml_stub_set_call_hook(setWatchdogStep);
+
+    // Before any of the NVML functions can be used nvmlInit() must be called
+    nvRetValue = _nvmlInitWithFlags(0);
+    nvRetValue = _nvmlInit_v2();
+
+    if (NVML_SUCCESS != nvRetValue)
+    {
+        // Can not call the NVML specific error string handler if the initialization failed
+        printf("[%s] error code :%d\n", "nvmlInit", nvRetValue);
+        return -1;
+    }
+
+    char driverVersion[NVML_SYSTEM_DRIVER_VERSION_BUFFER_SIZE] = "";
+    int cudaVersion = 0;
+    char nvmlVersion[80];
+    nvRetValue = _nvmlSystemGetDriverVersion(driverVersion, NVML_SYSTEM_DRIVER_VERSION_BUFFER_SIZE);
+    // a tape has to hold every query, the stubs don't use the inventory
+    bool isInventoryUsed = nvRetValue == NVML_SUCCESS && !nvmlRecordPath && !nvmlReplayPath && nvmlFakeDevices == 0;
+    string inventoryPath = string(exe_folder) + "\\" + kInventoryFileName;
+    if (isInventoryUsed)
+        loadDeviceInventory(inventoryPath.c_str());
+    nvRetValue = _nvmlSystemGetCudaDriverVersion(&cudaVersion);
+    nvRetValue = _nvmlSystemGetNVMLVersion(nvmlVersion, 80);
+    printf("Driver: %s     CUDA: %d.%d      NVML: %s\n",
+        driverVersion,
+        NVML_CUDA_DRIVER_VERSION_MAJOR(cudaVersion), NVML_CUDA_DRIVER_VERSION_MINOR(cudaVersion),
+        nvmlVersion);
+    printf("------------------------------------------------------------\n");
+
+    // Get the number of GPUs
+    nvRetValue = _nvmlDeviceGetCount_v2(&uiNumGPUs);
+    CHECK_NVML(nvRetValue, nvmlDeviceGetCount);
+
+    // In the case that no GPUs were detected
+    if (0 == uiNumGPUs)
+    {
+        printf("No NVIDIA GPUs were detected.\n");
+        _nvmlShutdown();
+        return -1;
+    }
+
+    bool bNVLinkSupported = false;
+
+    printf("GPU\tMODE\tCORES\tBUS\tPCIe\tGB/s\tARCH\tBRAND\tNAME\n");
+
+    for (uint32_t iDevIDX = 0; iDevIDX < uiNumGPUs; iDevIDX++)
+    {
+        NvidiaInfos.push_back(make_shared<NvidiaInfo>());
+        auto& info = *NvidiaInfos.back();
+        info.deviceId = iDevIDX;
+        info.setup(isInventoryUsed ? driverVersion : nullptr);
+        if (isCimgVisible)
+        {
+            info.window = make_shared<CImgDisplay>(WINDOW_W, WINDOW_H, info.cDevicename, 3);
+            addWindow(info.window);
+        }
+        if (info.numActiveLinks > 0)
+            bNVLinkSupported = true;
+    }
+    printf("------------------------------------------------------------\n");
+    if (isInventoryUsed)
+        saveDeviceInventory(inventoryPath.c_str(), driverVersion);
+
+    for (auto& info : NvidiaInfos)
+        info->worker.start(("nvidia worker " + to_string(info->deviceId)).c_str());
+    buildPeerTopology();
+    startEventWatcher();
+
+    // Print out a header for the utilization output
+    printf("GPU\tSM\tMEM\tFBuffer(MB)\tSM-CLK\tMEM-CLK\tPCIE-TX\tPCIE-RX");
+    if (bNVLinkSupported)
+        printf("\tNVLK-TX\tNVLK-RX");
+    printf("\n");
+    printf("#id\t%%\t%%\tUsed / All\tMHz\tMHz\tMB\tMB");
+    if (bNVLinkSupported)
+        printf("\tMB/s\tMB/s");
+    printf("\n");
+
+    return 0;
+}
+
+int nvidia_setup()
+{
+    int result = startNvml();
+    nvidiaState = result == 0 ? NVIDIA_READY : NVIDIA_FAILED;
+    return result;
+}
+
+int nvidia_update()
+{
+    if (isNvmlLost)
+        reinitNvml();
+    runSupervised("update", [](NvidiaInfo& info) { info.update(); });
+    publishTopology();
+
+    // Nobody reads the console of a headless run.
+    if (!isHeadless)
+    {
+        for (uint32_t iDevIDX = 0; iDevIDX < NvidiaInfos.size(); iDevIDX++)
+        {
+            const auto& info = *NvidiaInfos[iDevIDX];
+            GoToXY(0, iDevIDX + 5 + uiNumGPUs + 2);
+            if (info.stallStartMs != 0 || info.lostSinceMs != 0)
+                printf("%d\t%-80s", info.deviceId, info.lostSinceMs != 0 ? "lost" : "not responding");
+            else
+                fputs(info.consoleLine.c_str(), stdout);
+        }
+    }
+    return 0;
+}
+
+int nvidia_update_power()
+{
+    runSupervised("updatePower", [](NvidiaInfo& info) { info.updatePower(); });
+    return 0;
+}
+
+int nvidia_draw(bool show_legends)
+{
+    if (nvidiaState != NVIDIA_READY)
+        return 0;
+    for (auto& info : NvidiaInfos)
+    {
+        info->draw(show_legends);
+    }
+
+    return 0;
+}
+
+int nvidia_cleanup()
+{
+    // nvmlEventSetWait returns within kEventWaitMs unless the driver hangs
+    bool isIdle = stopEventWatcher(kEventWaitMs + kCallDeadlineMs);
+    for (auto& info : NvidiaInfos)
+    {
+        bool isStopped = info->worker.stop(kCallDeadlineMs);
+        // the plan is only touched once its worker is done with it
+        if (isStopped)
+            isStopped = info->plan.stop(kCallDeadlineMs);
+        isIdle &= isStopped;
+    }
+    // a call still hung in the driver would crash in nvmlShutdown
+    auto nvRetValue = isIdle ? _nvmlShutdown() : NVML_SUCCESS;
+    nvml_stub_close();
+
+    return nvRetValue;
+}
+
+int nvidia_draw_imgui()
+{
+    if (nvidiaState == NVIDIA_STARTING)
+        ImGui::TextDisabled("starting NVML...");
+    if (nvidiaState != NVIDIA_READY)
+        return 0;
+    for (auto& info : NvidiaInfos)
+    {
+        info->drawImgui();
+    }
+    drawTopologyImgui();
+    drawCallCostImgui();
+
+    return 0;
+}
@@ -1,7 +1,10 @@
-#pragma once
-
-int nvidia_setup();
-int nvidia_update();
-int nvidia_draw(bool show_legends);
-int nvidia_draw_imgui();
-int nvidia_cleanup();
+#pragma once
+
+// Takes seconds on big machines, meant for the collector thread. The draw functions
+// can be called meanwhile, they skip the devices until it returned.
+int nvidia_setup();
+int nvidia_update();
+int nvidia_update_power();
+int nvidia_draw(bool show_legends);
+int nvidia_draw_imgui();
+int nvidia_cleanup();
@@ -0,0 +1,525 @@
+#include "nvml_sampling.h"
+#include "watchdog.h"
+#include <string.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+
+// defined in nvidia_prof.cpp
+void ShowErrorDetails(const nvmlReturn_t nvRetVal, const char* pFunctionName);
+
+namespace
+{
+    bool isReportable(nvmlReturn_t ret)
+    {
+        return ret != NVML_SUCCESS && ret != NVML_ERROR_NO_PERMISSION && ret != NVML_ERROR_NOT_SUPPORTED;
+    }
+
+    // NVML went through a driver reset, see SamplingPlan::isLost
+    bool isLostReturn(nvmlReturn_t ret)
+    {
+        return ret == NVML_ERROR_UNINITIALIZED || ret == NVML_ERROR_GPU_IS_LOST;
+    }
+
+    long long getWallTimeUs()
+    {
+        using namespace std::chrono;
+        return duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+    }
+
+    float getElapsedUs(std::chrono::steady_clock::time_point since)
+    {
+        return std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - since).count();
+    }
+}
+
+// The calls too slow for the tick run on a supervised worker, one at a time. Their values come back
+// to the plan with the next sample() after they finish. The worker only holds on to this,
+// a call left behind by stop() can return after the plan is gone.
+struct SamplingPlan::Offload
+{
+    struct Result
+    {
+        int call;
+        int slot;
+        double value;
+        unsigned long long counter;
+        long long timeUs;
+    };
+
+    struct Run
+    {
+        int call;
+        nvmlReturn_t ret;
+        float us;
+    };
+
+    std::mutex lock;
+    std::vector<SamplingPlan::QueryFn> fns;     // copies, by call index
+    std::vector<bool> isQueued;                 // queued or running
+    std::vector<int> queue;
+    std::vector<Result> results;
+    std::vector<Run> runs;
+    // the call in the driver right now, -1 when none
+    int runningCall = -1;
+    std::chrono::steady_clock::time_point runningSince;
+    // only touched by the worker, the calls write their slots in there
+    SamplingPlan scratch;
+
+    // the job of the worker, runs the queued calls until none is left
+    static void drain(std::shared_ptr<Offload> self)
+    {
+        std::unique_lock<std::mutex> guard(self->lock);
+        while (!self->queue.empty())
+        {
+            int call = self->queue.front();
+            self->queue.erase(self->queue.begin());
+            auto fn = self->fns[call];
+            self->runningCall = call;
+            self->runningSince = std::chrono::steady_clock::now();
+            guard.unlock();
+
+            auto& scratch = self->scratch;
+            std::fill(scratch.valid.begin(), scratch.valid.end(), false);
+            scratch.sampleTimeUs = getWallTimeUs();
+            scratch.currentCall = call;
+            auto t0 = std::chrono::steady_clock::now();
+            auto ret = fn(scratch);
+            float us = getElapsedUs(t0);
+
+            guard.lock();
+            for (size_t slot = 0; slot < scratch.valid.size(); slot++)
+            {
+                if (scratch.valid[slot])
+                    self->results.push_back({ call, (int)slot, scratch.values[slot], scratch.counters[slot], scratch.timesUs[slot] });
+            }
+            self->runs.push_back({ call, ret, us });
+            self->isQueued[call] = false;
+            self->runningCall = -1;
+        }
+    }
+};
+
+bool CallCadence::isDue()
+{
+    if (countdown > 0)
+    {
+        countdown--;
+        return false;
+    }
+    countdown = period - 1;
+    return true;
+}
+
+void CallCadence::record(float us)
+{
+    costUs = runs == 0 ? us : costUs * 0.75f + us * 0.25f;
+    maxCostUs = std::max(maxCostUs, us);
+    runs++;
+}
+
+bool CallCadence::slowDown()
+{
+    if (period >= MAX_PERIOD)
+        return false;
+    period *= 2;
+    return true;
+}
+
+double getNvmlValue(nvmlValueType_t type, const nvmlValue_t& value)
+{
+    switch (type)
+    {
+    case NVML_VALUE_TYPE_DOUBLE: return value.dVal;
+    case NVML_VALUE_TYPE_UNSIGNED_INT: return value.uiVal;
+    case NVML_VALUE_TYPE_UNSIGNED_LONG: return (double)value.ulVal;
+    case NVML_VALUE_TYPE_UNSIGNED_LONG_LONG: return (double)value.ullVal;
+    case NVML_VALUE_TYPE_SIGNED_LONG_LONG: return (double)value.sllVal;
+    default: return 0;
+    }
+}
+
+double getFieldValue(const nvmlFieldValue_t& field)
+{
+    return getNvmlValue(field.valueType, field.value);
+}
+
+int SamplingPlan::addSlot(const char* name)
+{
+    slotNames.push_back(name);
+    values.push_back(0);
+    valid.push_back(false);
+    counters.push_back(0);
+    timesUs.push_back(0);
+    slotOwners.push_back(-1);
+    return (int)slotNames.size() - 1;
+}
+
+void SamplingPlan::addField(int slot, unsigned int fieldId, unsigned int scopeId, const char* name, QueryFn fallback)
+{
+    int fallbackIdx = -1;
+    if (fallback)
+    {
+        calls.push_back({ name, fallback, false, {}, false });
+        fallbackIdx = (int)calls.size() - 1;
+    }
+    fields.push_back({ fieldId, scopeId, slot, fallbackIdx });
+}
+
+void SamplingPlan::addCall(const char* name, QueryFn fn)
+{
+    calls.push_back({ name, fn, true, {}, false });
+}
+
+void SamplingPlan::build(nvmlDevice_t device, FieldValuesFn getFieldValues)
+{
+    std::vector<nvmlFieldValue_t> probe(fields.size());
+    for (size_t i = 0; i < fields.size(); i++)
+    {
+        probe[i].fieldId = fields[i].fieldId;
+        probe[i].scopeId = fields[i].scopeId;
+    }
+    nvmlReturn_t ret = NVML_ERROR_FUNCTION_NOT_FOUND;
+    if (getFieldValues && !probe.empty())
+        ret = getFieldValues(device, (int)probe.size(), probe.data());
+
+    batch.clear();
+    batchSlots.clear();
+    for (size_t i = 0; i < fields.size(); i++)
+    {
+        const auto& field = fields[i];
+        bool supported = ret == NVML_SUCCESS && probe[i].nvmlReturn == NVML_SUCCESS;
+        if (supported)
+        {
+            nvmlFieldValue_t request = {};
+            request.fieldId = field.fieldId;
+            request.scopeId = field.scopeId;
+            batch.push_back(request);
+            batchSlots.push_back(field.slot);
+        }
+        if (field.fallback >= 0)
+            calls[field.fallback].enabled = !supported;
+    }
+}
+
+int SamplingPlan::sample(nvmlDevice_t device, FieldValuesFn getFieldValues)
+{
+    int callsMade = 0;
+    sampleTimeUs = getWallTimeUs();
+
+    // the slots read again this tick are cleared, the others hold their last value
+    isRunning.resize(calls.size());
+    for (size_t k = 0; k < calls.size(); k++)
+        isRunning[k] = calls[k].enabled && !calls[k].isOffloaded && calls[k].cadence.isDue();
+    for (size_t slot = 0; slot < valid.size(); slot++)
+    {
+        int owner = slotOwners[slot];
+        if (owner < 0 || isRunning[owner] || !calls[owner].enabled)
+        {
+            valid[slot] = false;
+            timesUs[slot] = 0;
+        }
+    }
+
+    if (!batch.empty())
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        auto ret = getFieldValues(device, (int)batch.size(), batch.data());
+        // the time a call hung in a driver reset says nothing about its cost
+        if (!isLostReturn(ret))
+            batchCadence.record(getElapsedUs(t0));
+        callsMade++;
+        isLost |= isLostReturn(ret);
+        if (isReportable(ret))
+            ShowErrorDetails(ret, "nvmlDeviceGetFieldValues");
+        if (ret == NVML_SUCCESS)
+        {
+            for (size_t i = 0; i < batch.size(); i++)
+            {
+                const auto& field = batch[i];
+                if (field.nvmlReturn != NVML_SUCCESS)
+                    continue;
+                if (field.valueType == NVML_VALUE_TYPE_UNSIGNED_LONG_LONG)
+                    setCounter(batchSlots[i], field.value.ullVal, field.timestamp);
+                else
+                    set(batchSlots[i], getFieldValue(field));
+            }
+        }
+    }
+
+    for (size_t k = 0; k < calls.size(); k++)
+    {
+        auto& call = calls[k];
+        if (!isRunning[k])
+            continue;
+        currentCall = (int)k;
+        auto t0 = std::chrono::steady_clock::now();
+        auto ret = call.fn(*this);
+        if (!isLostReturn(ret))
+            call.cadence.record(getElapsedUs(t0));
+        currentCall = -1;
+        callsMade++;
+        isLost |= isLostReturn(ret);
+        if (ret == NVML_ERROR_NOT_SUPPORTED)
+            call.enabled = false;
+        else if (isReportable(ret))
+            ShowErrorDetails(ret, call.name);
+    }
+
+    if (offload)
+    {
+        collectOffloaded();
+        scheduleOffloaded();
+    }
+    applyBudget();
+
+    return callsMade;
+}
+
+void SamplingPlan::collectOffloaded()
+{
+    std::lock_guard<std::mutex> guard(offload->lock);
+    for (const auto& result : offload->results)
+    {
+        values[result.slot] = result.value;
+        counters[result.slot] = result.counter;
+        timesUs[result.slot] = result.timeUs;
+        valid[result.slot] = true;
+        slotOwners[result.slot] = result.call;
+    }
+    offload->results.clear();
+    for (const auto& run : offload->runs)
+    {
+        auto& call = calls[run.call];
+        if (!isLostReturn(run.ret))
+            call.cadence.record(run.us);
+        isLost |= isLostReturn(run.ret);
+        if (run.ret == NVML_ERROR_NOT_SUPPORTED)
+            call.enabled = false;
+        else if (isReportable(run.ret))
+            ShowErrorDetails(run.ret, call.name);
+    }
+    offload->runs.clear();
+
+    // a call past its deadline holds up every offloaded call queued behind it,
+    // their slots are invalid until it returns, the values they gave last are not current anymore
+    stalledCall = nullptr;
+    stallUs = 0;
+    int call = offload->runningCall;
+    if (call >= 0)
+    {
+        float us = getElapsedUs(offload->runningSince);
+        if (us > OFFLOAD_DEADLINE_MS * 1000.0f)
+        {
+            stalledCall = calls[call].name;
+            stallUs = (long long)us;
+            for (size_t slot = 0; slot < valid.size(); slot++)
+            {
+                int owner = slotOwners[slot];
+                if (owner >= 0 && calls[owner].isOffloaded)
+                    valid[slot] = false;
+            }
+        }
+    }
+}
+
+void SamplingPlan::scheduleOffloaded()
+{
+    bool hasWork = false;
+    {
+        std::lock_guard<std::mutex> guard(offload->lock);
+        for (size_t k = 0; k < calls.size(); k++)
+        {
+            auto& call = calls[k];
+            // a call still running from an earlier tick is skipped, not queued twice
+            if (!call.enabled || !call.isOffloaded || offload->isQueued[k] || !call.cadence.isDue())
+                continue;
+            offload->isQueued[k] = true;
+            offload->queue.push_back((int)k);
+        }
+        hasWork = !offload->queue.empty();
+    }
+    // refused while a drain runs, that one picks the new calls up, or the next tick submits again
+    if (hasWork)
+    {
+        auto state = offload;
+        offloadWorker->submit("nvml slow calls", [state] { Offload::drain(state); });
+    }
+}
+
+void SamplingPlan::applyBudget()
+{
+    if (budgetUs <= 0)
+        return;
+
+    // a call eating half of the budget on its own would break it whenever it runs
+    for (size_t k = 0; k < calls.size(); k++)
+    {
+        auto& call = calls[k];
+        if (!call.enabled || call.isOffloaded || call.cadence.runs < CallCadence::MIN_RUNS
+            || call.cadence.costUs <= budgetUs / 2)
+            continue;
+        if (!offload)
+        {
+            offload = std::make_shared<Offload>();
+            offload->scratch.values = values;
+            offload->scratch.valid = valid;
+            offload->scratch.counters = counters;
+            offload->scratch.timesUs = timesUs;
+            offload->scratch.slotOwners = slotOwners;
+            offload->isQueued.assign(calls.size(), false);
+            offload->fns.resize(calls.size());
+            offloadWorker = std::make_shared<SupervisedWorker>();
+            offloadWorker->start("nvml slow calls");
+        }
+        {
+            std::lock_guard<std::mutex> guard(offload->lock);
+            offload->fns[k] = call.fn;
+        }
+        call.isOffloaded = true;
+        call.cadence.period = 1;
+        call.cadence.countdown = 0;
+        fprintf(stderr, "[SamplingPlan] - %s takes %.1f ms, moved to the background\r\n", call.name, call.cadence.costUs / 1000);
+    }
+
+    // then the average cost of a tick has to fit, the most expensive calls run less often
+    while (true)
+    {
+        double tickUs = batch.empty() ? 0 : batchCadence.costUs;
+        Call* worst = nullptr;
+        for (auto& call : calls)
+        {
+            if (!call.enabled || call.isOffloaded || call.cadence.runs < CallCadence::MIN_RUNS)
+                continue;
+            double share = call.cadence.costUs / call.cadence.period;
+            tickUs += share;
+            if (call.cadence.period < CallCadence::MAX_PERIOD && (!worst || share > worst->cadence.costUs / worst->cadence.period))
+                worst = &call;
+        }
+        if (tickUs <= budgetUs || !worst)
+            break;
+        worst->cadence.slowDown();
+        fprintf(stderr, "[SamplingPlan] - %s takes %.1f ms, now every %d ticks\r\n", worst->name, worst->cadence.costUs / 1000, worst->cadence.period);
+    }
+}
+
+bool SamplingPlan::stop(int timeoutMs)
+{
+    if (!offloadWorker)
+        return true;
+    {
+        // the calls that didn't start yet are dropped
+        std::lock_guard<std::mutex> guard(offload->lock);
+        offload->queue.clear();
+    }
+    bool isIdle = offloadWorker->stop(timeoutMs);
+    offloadWorker.reset();
+    return isIdle;
+}
+
+bool SamplingPlan::isOffloadBusy() const
+{
+    return offloadWorker && offloadWorker->isBusy();
+}
+
+bool SamplingPlan::waitOffload(long long deadlineUs)
+{
+    return !offloadWorker || offloadWorker->wait(deadlineUs);
+}
+
+void SamplingPlan::getReports(std::vector<CallReport>* reports) const
+{
+    reports->clear();
+    if (!batch.empty())
+        reports->push_back({ "nvmlDeviceGetFieldValues", batchCadence.costUs, batchCadence.maxCostUs, 1, false });
+    for (const auto& call : calls)
+    {
+        if (call.enabled)
+            reports->push_back({ call.name, call.cadence.costUs, call.cadence.maxCostUs, call.cadence.period, call.isOffloaded });
+    }
+}
+
+void SamplingPlan::set(int slot, double value)
+{
+    values[slot] = value;
+    counters[slot] = value > 0 ? (unsigned long long)value : 0;
+    timesUs[slot] = sampleTimeUs;
+    valid[slot] = true;
+    slotOwners[slot] = currentCall;
+}
+
+void SamplingPlan::setCounter(int slot, unsigned long long value, long long timeUs)
+{
+    values[slot] = (double)value;
+    counters[slot] = value;
+    timesUs[slot] = timeUs != 0 ? timeUs : sampleTimeUs;
+    valid[slot] = true;
+    slotOwners[slot] = currentCall;
+}
+
+bool SamplingPlan::isBatched(int slot) const
+{
+    return std::find(batchSlots.begin(), batchSlots.end(), slot) != batchSlots.end();
+}
+
+bool CounterRate::update(unsigned long long value, long long timeUs, int counterBits, double maxPerSecond, double* perSecond)
+{
+    if (!isPrimed || timeUs <= lastUs)
+    {
+        // the first read, or a repeat of the last one
+        if (!isPrimed || value != last)
+        {
+            last = value;
+            lastUs = timeUs;
+        }
+        isPrimed = true;
+        return false;
+    }
+
+    double seconds = (timeUs - lastUs) * 1e-6;
+    unsigned long long mask = counterBits >= 64 ? ~0ull : (1ull << counterBits) - 1;
+    unsigned long long delta = 0;
+    if (value >= last)
+    {
+        delta = value - last;
+    }
+    else
+    {
+        // around the top of the counter, or restarted from 0
+        unsigned long long wrapped = last <= mask ? (mask - last) + (value & mask) + 1 : ~0ull;
+        bool isWrap = last <= mask && (maxPerSecond > 0 ? wrapped <= maxPerSecond * seconds * 1.5 : last > mask / 2);
+        if (isWrap)
+        {
+            delta = wrapped;
+            wraps++;
+        }
+        else
+        {
+            delta = value;
+            resets++;
+        }
+    }
+
+    last = value;
+    lastUs = timeUs;
+    *perSecond = delta / seconds;
+    return true;
+}
+
+void SamplingPlan::setCallEnabled(const char* name, bool enabled)
+{
+    for (auto& call : calls)
+    {
+        if (strcmp(call.name, name) == 0)
+            call.enabled = enabled;
+    }
+}
+
+int SamplingPlan::callCount() const
+{
+    int count = batch.empty() ? 0 : 1;
+    for (const auto& call : calls)
+        count += call.enabled ? 1 : 0;
+    return count;
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include "../3rdparty/CUDA_SDK/nvml.h"
+
+// How often a query runs. Every run is timed, the cost control of SamplingPlan slows
+// down the ones that turn out too expensive for the tick budget.
+struct CallCadence
+{
+    static const int MAX_PERIOD = 64;
+    // runs before the cost is trusted, the first call often pays for some driver side setup
+    static const int MIN_RUNS = 3;
+
+    float costUs = 0;           // moving average
+    float maxCostUs = 0;
+    int runs = 0;
+    int period = 1;             // in ticks
+    int countdown = 0;
+
+    // true once every period ticks
+    bool isDue();
+    void record(float us);
+    // doubles the period, false once at MAX_PERIOD
+    bool slowDown();
+};
+
+struct SupervisedWorker;
+
+typedef nvmlReturn_t (*FieldValuesFn)(nvmlDevice_t device, int valuesCount, nvmlFieldValue_t* values);
+
+// Declarative list of the values read from one device every tick.
+// Values with an NVML field id are fetched together by a single nvmlDeviceGetFieldValues call,
+// the rest, and the fields the device turns out not to answer, by their own NVML call.
+//
+// With a budgetUs, a call costing more than half of it on its own moves to a supervised background
+// thread and the others are run less often, the most expensive first, until a tick fits in the budget.
+// The slots of a call that didn't run keep their last value and time, except for an offloaded call
+// hung past OFFLOAD_DEADLINE_MS, see stalledCall.
+struct SamplingPlan
+{
+    // reads one or more slots with a dedicated NVML call
+    typedef std::function<nvmlReturn_t(SamplingPlan& plan)> QueryFn;
+
+    struct Field
+    {
+        unsigned int fieldId;
+        unsigned int scopeId;
+        int slot;
+        int fallback;           // index in calls, -1 when there is none
+    };
+
+    struct Call
+    {
+        const char* name;
+        QueryFn fn;
+        bool enabled;           // false for a fallback while its field is batched, or once NOT_SUPPORTED
+        CallCadence cadence;
+        bool isOffloaded;       // runs on the background thread
+    };
+
+    // what the cost control did with a call, for the UI
+    struct CallReport
+    {
+        const char* name;
+        float costUs;
+        float maxCostUs;
+        int period;
+        bool isOffloaded;
+    };
+
+    std::vector<const char*> slotNames;
+    std::vector<double> values;
+    std::vector<bool> valid;
+    // exact value of the 64 bit counters, and when each slot was read in wall clock us
+    std::vector<unsigned long long> counters;
+    std::vector<long long> timesUs;
+    long long sampleTimeUs = 0;
+    std::vector<Field> fields;
+    std::vector<Call> calls;
+    std::vector<nvmlFieldValue_t> batch;    // the supported fields, in fields order
+    std::vector<int> batchSlots;
+    // a call answered UNINITIALIZED or GPU_IS_LOST, the device handle is no good anymore
+    bool isLost = false;
+
+    // cost control, 0 runs every call on every tick
+    double budgetUs = 0;
+    CallCadence batchCadence;
+    // the call that wrote each slot last, -1 for a field
+    std::vector<int> slotOwners;
+    int currentCall = -1;
+    std::vector<bool> isRunning;            // scratch of sample()
+    struct Offload;
+    std::shared_ptr<Offload> offload;       // the queue of the background thread, once a call moved there
+    std::shared_ptr<SupervisedWorker> offloadWorker;
+    // an offloaded call still running after this is taken as hung
+    static const int OFFLOAD_DEADLINE_MS = 1000;
+    // the hung offloaded call and for how long it runs, null while they answer,
+    // the slots of every offloaded call are invalid meanwhile
+    const char* stalledCall = nullptr;
+    long long stallUs = 0;
+
+    int addSlot(const char* name);
+    // a value NVML exposes as a field, fallback is used when the device doesn't answer it
+    void addField(int slot, unsigned int fieldId, unsigned int scopeId, const char* name, QueryFn fallback);
+    // a query without field id
+    void addCall(const char* name, QueryFn fn);
+
+    // Probes once which fields the device answers and enables the fallbacks of the others.
+    // getFieldValues may be null on drivers without field support.
+    void build(nvmlDevice_t device, FieldValuesFn getFieldValues);
+
+    // Reads every slot, returns the number of NVML calls it took.
+    int sample(nvmlDevice_t device, FieldValuesFn getFieldValues);
+
+    void set(int slot, double value);
+    void setCounter(int slot, unsigned long long value, long long timeUs = 0);
+    double get(int slot) const { return valid[slot] ? values[slot] : 0; }
+    unsigned long long getCounter(int slot) const { return counters[slot]; }
+    // the timestamp NVML gave the value, the time of the call when it gave none
+    long long getTimeUs(int slot) const { return timesUs[slot] != 0 ? timesUs[slot] : sampleTimeUs; }
+    bool isValid(int slot) const { return valid[slot]; }
+    // true when the slot comes from the field batch rather than its fallback
+    bool isBatched(int slot) const;
+    int callCount() const;
+    void setCallEnabled(const char* name, bool enabled);
+
+    void getReports(std::vector<CallReport>* reports) const;
+    // Stops the background thread before NVML shuts down, a call still running after timeoutMs
+    // is left behind. False when it had to, NVML isn't safe to shut down then.
+    bool stop(int timeoutMs);
+    // an offloaded call is queued or in the driver
+    bool isOffloadBusy() const;
+    // waits for the offloaded calls until deadlineUs, on the getSchedulerTimeUs() clock, true once none is in flight
+    bool waitOffload(long long deadlineUs);
+
+    // parts of sample()
+    void collectOffloaded();
+    void scheduleOffloaded();
+    void applyBudget();
+};
+
+// Turns a cumulative counter into a rate over the real time between two reads.
+// A counter going backwards either wrapped at counterBits or was reset, the wrap is only
+// believed when the traffic it implies fits under maxPerSecond (0 when unknown).
+struct CounterRate
+{
+    unsigned long long last = 0;
+    long long lastUs = 0;
+    bool isPrimed = false;
+    int wraps = 0;
+    int resets = 0;
+
+    // false while there is no earlier read to compare with, or the time didn't advance
+    bool update(unsigned long long value, long long timeUs, int counterBits, double maxPerSecond, double* perSecond);
+};
+
+double getNvmlValue(nvmlValueType_t type, const nvmlValue_t& value);
+double getFieldValue(const nvmlFieldValue_t& field);
@@ -0,0 +1,1089 @@
+#include "nvml_stub.h"
+#include "quantile_sketch.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// Tape layout, little endian:
+//   "NVMLTAPE", u32 version, u32 entry count, then the entry names as u8 length + chars
+//   one record per call: u16 entry, u64 key, i32 return code, u8 output count,
+//   then for every output pointer in argument order u32 byte count + bytes
+// The key is the device (or other handle) the call is about, the index for the calls taking one.
+
+namespace
+{
+    enum EntryId
+    {
+#define ENTRY(func) id_##func,
+#include "../3rdparty/CUDA_SDK/nvml.def"
+#undef ENTRY
+        ENTRY_COUNT
+    };
+
+    const char* const kEntryNames[] =
+    {
+#define ENTRY(func) #func,
+#include "../3rdparty/CUDA_SDK/nvml.def"
+#undef ENTRY
+    };
+
+    const char kTapeMagic[8] = { 'N', 'V', 'M', 'L', 'T', 'A', 'P', 'E' };
+    const uint32_t kTapeVersion = 1;
+
+    // The calls filling an array, the other pointers are single values.
+    // count is the argument holding the number of elements, by value or through a pointer.
+    struct ArraySpec
+    {
+        const char* name;
+        int array;
+        int count;
+    };
+
+    const ArraySpec kArraySpecs[] =
+    {
+        { "nvmlDeviceGetFieldValues", 2, 1 },
+        { "nvmlDeviceGetSamples", 5, 4 },
+        { "nvmlDeviceGetAccountingPids", 2, 1 },
+        { "nvmlDeviceGetProcessUtilization", 1, 2 },
+        { "nvmlDeviceGetComputeRunningProcesses_v3", 2, 1 },
+        { "nvmlDeviceGetGraphicsRunningProcesses_v3", 2, 1 },
+        { "nvmlDeviceGetMPSComputeRunningProcesses_v3", 2, 1 },
+        { "nvmlDeviceGetTopologyNearestGpus", 3, 2 },
+        { "nvmlSystemGetTopologyGpuSet", 2, 1 },
+        { "nvmlDeviceGetSupportedMemoryClocks", 2, 1 },
+        { "nvmlDeviceGetSupportedGraphicsClocks", 3, 2 },
+        { "nvmlDeviceGetRetiredPages", 3, 2 },
+    };
+
+    ArraySpec arraySpecs[ENTRY_COUNT];
+
+    void initArraySpecs()
+    {
+        for (auto& spec : arraySpecs)
+            spec = { nullptr, -1, -1 };
+        for (const auto& spec : kArraySpecs)
+        {
+            for (int id = 0; id < ENTRY_COUNT; id++)
+            {
+                if (strcmp(kEntryNames[id], spec.name) == 0)
+                    arraySpecs[id] = spec;
+            }
+        }
+    }
+
+    template <typename T, typename = void> struct IsComplete : false_type {};
+    template <typename T> struct IsComplete<T, void_t<decltype(sizeof(T))>> : true_type {};
+
+    // what NVML writes through an argument, void when it writes nothing
+    template <typename A> struct OutputOf { typedef void type; };
+    template <typename T> struct OutputOf<T*>
+    {
+        typedef conditional_t<!is_const<T>::value && IsComplete<T>::value, T, void> type;
+    };
+
+    // the count or length an argument holds or points to, 0 for the rest
+    template <typename A> size_t integerOf(A a)
+    {
+        if constexpr (is_integral<A>::value)
+        {
+            return (size_t)a;
+        }
+        else if constexpr (is_pointer<A>::value)
+        {
+            typedef remove_cv_t<remove_pointer_t<A>> T;
+            if constexpr (is_integral<T>::value && !is_same<T, char>::value)
+                return a ? (size_t)*a : 0;
+        }
+        return 0;
+    }
+
+    inline uint64_t keyOf() { return 0; }
+
+    template <typename A, typename... Rest> uint64_t keyOf(A a, Rest...)
+    {
+        typedef remove_pointer_t<A> T;
+        if constexpr (is_pointer<A>::value && !is_void<T>::value && !IsComplete<T>::value)
+            return (uint64_t)(uintptr_t)a;     // nvmlDevice_t and the other opaque handles
+        else if constexpr (is_integral<A>::value)
+            return (uint64_t)a;
+        else
+            return 0;
+    }
+
+    // bytes the output argument i holds, before[] are the counts as the caller passed them
+    template <typename T>
+    size_t outputCapacity(int id, size_t i, const size_t* before, size_t argCount)
+    {
+        const auto& spec = arraySpecs[id];
+        if ((int)i == spec.array)
+            return before[spec.count] * sizeof(T);
+        // char *name, unsigned int length
+        if (is_same<T, char>::value)
+            return i + 1 < argCount ? before[i + 1] : 0;
+        return sizeof(T);
+    }
+
+    struct TapeWriter
+    {
+        FILE* file = nullptr;
+        mutex lock;
+        vector<uint8_t> record;
+
+        void put(const void* data, size_t bytes)
+        {
+            auto p = (const uint8_t*)data;
+            record.insert(record.end(), p, p + bytes);
+        }
+
+        template <typename T> void put(T value) { put(&value, sizeof(value)); }
+    };
+
+    TapeWriter writer;
+
+    struct TapeReader
+    {
+        // a call as read back: its return code and outputs
+        struct Track
+        {
+            vector<size_t> records;     // offsets in data, just past the key
+            size_t cursor = 0;
+        };
+
+        vector<uint8_t> data;
+        map<pair<int, uint64_t>, Track> tracks;
+        mutex lock;
+
+        // the record to replay for this call, null when the tape has none
+        const uint8_t* next(int id, uint64_t key)
+        {
+            lock_guard<mutex> guard(lock);
+            auto it = tracks.find({ id, key });
+            if (it == tracks.end())
+                return nullptr;
+            auto& track = it->second;
+            auto offset = track.records[track.cursor];
+            track.cursor = (track.cursor + 1) % track.records.size();
+            return data.data() + offset;
+        }
+    };
+
+    TapeReader reader;
+
+    // per entry point, filled by the timing wrappers from any thread
+    struct EntryCost
+    {
+        mutex lock;
+        QuantileSketch sketch;
+        uint64_t calls = 0;
+        double totalUs = 0;
+        float maxUs = 0;
+    };
+
+    EntryCost entryCosts[ENTRY_COUNT];
+    NvmlCallHook callHook = nullptr;
+
+    template <typename T> T load(const uint8_t*& p)
+    {
+        T value;
+        memcpy(&value, p, sizeof(value));
+        p += sizeof(value);
+        return value;
+    }
+
+    template <int Id, typename Fn> struct Entry;
+
+    template <int Id, typename R, typename... Args>
+    struct Entry<Id, R(Args...)>
+    {
+        static const size_t N = sizeof...(Args);
+        static inline R (*real)(Args...) = nullptr;
+
+        template <typename A>
+        static void writeOutput(size_t i, A a, const size_t* before, const size_t* after, nvmlReturn_t ret)
+        {
+            typedef typename OutputOf<A>::type T;
+            if constexpr (!is_void<T>::value)
+            {
+                size_t bytes = 0;
+                if (a)
+                {
+                    const auto& spec = arraySpecs[Id];
+                    if ((int)i == spec.array)
+                        bytes = (std::min)(before[spec.count], after[spec.count]) * sizeof(T);
+                    else if constexpr (is_same<T, char>::value)
+                    {
+                        size_t capacity = outputCapacity<T>(Id, i, before, N);
+                        bytes = ret == NVML_SUCCESS && capacity > 0 ? (std::min)(strnlen(a, capacity) + 1, capacity) : 0;
+                    }
+                    else
+                        bytes = sizeof(T);
+                }
+                writer.put((uint32_t)bytes);
+                writer.put(a, bytes);
+            }
+        }
+
+        template <typename A>
+        static void readOutput(size_t i, A a, const size_t* before, const uint8_t*& p, int& outputsLeft)
+        {
+            typedef typename OutputOf<A>::type T;
+            if constexpr (!is_void<T>::value)
+            {
+                if (outputsLeft-- <= 0)
+                    return;
+                auto bytes = load<uint32_t>(p);
+                if (a)
+                    memcpy(a, p, (std::min)((size_t)bytes, outputCapacity<T>(Id, i, before, N)));
+                p += bytes;
+            }
+        }
+
+        static R record(Args... args)
+        {
+            if constexpr (!is_same<R, nvmlReturn_t>::value)
+            {
+                return real(args...);
+            }
+            else
+            {
+                size_t before[N + 1] = { integerOf(args)... };
+                R ret = real(args...);
+                size_t after[N + 1] = { integerOf(args)... };
+
+                int outputs = 0;
+                (void)initializer_list<int>{ (outputs += !is_void<typename OutputOf<Args>::type>::value, 0)... };
+
+                lock_guard<mutex> guard(writer.lock);
+                if (!writer.file)
+                    return ret;
+                writer.record.clear();
+                writer.put((uint16_t)Id);
+                writer.put(keyOf(args...));
+                writer.put((int32_t)ret);
+                writer.put((uint8_t)outputs);
+                size_t i = 0;
+                (void)initializer_list<int>{ (writeOutput(i++, args, before, after, ret), 0)... };
+                fwrite(writer.record.data(), 1, writer.record.size(), writer.file);
+                return ret;
+            }
+        }
+
+        static R replay(Args... args)
+        {
+            if constexpr (!is_same<R, nvmlReturn_t>::value)
+            {
+                return R();
+            }
+            else
+            {
+                auto p = reader.next(Id, keyOf(args...));
+                if (!p)
+                    return NVML_ERROR_NOT_SUPPORTED;
+                size_t before[N + 1] = { integerOf(args)... };
+                auto ret = (nvmlReturn_t)load<int32_t>(p);
+                int outputsLeft = load<uint8_t>(p);
+                size_t i = 0;
+                (void)initializer_list<int>{ (readOutput(i++, args, before, p, outputsLeft), 0)... };
+                return ret;
+            }
+        }
+
+        static inline R (*timedReal)(Args...) = nullptr;
+
+        static R timed(Args... args)
+        {
+            auto hook = callHook;
+            if (hook)
+                hook(kEntryNames[Id]);
+            auto t0 = chrono::steady_clock::now();
+            R ret = timedReal(args...);
+            if (hook)
+                hook(nullptr);
+            float us = chrono::duration<float, micro>(chrono::steady_clock::now() - t0).count();
+
+            auto& cost = entryCosts[Id];
+            lock_guard<mutex> guard(cost.lock);
+            cost.sketch.add(us);
+            cost.calls++;
+            cost.totalUs += us;
+            cost.maxUs = (std::max)(cost.maxUs, us);
+            return ret;
+        }
+
+        static R unsupported(Args...)
+        {
+            if constexpr (is_same<R, nvmlReturn_t>::value)
+                return NVML_ERROR_NOT_SUPPORTED;
+            else
+                return R();
+        }
+    };
+
+    template <int Id, typename R, typename... Args>
+    void bindRecord(R (*&fn)(Args...))
+    {
+        if (!fn)
+            return;
+        Entry<Id, R(Args...)>::real = fn;
+        fn = Entry<Id, R(Args...)>::record;
+    }
+
+    template <int Id, typename R, typename... Args>
+    void bindReplay(R (*&fn)(Args...))
+    {
+        fn = Entry<Id, R(Args...)>::replay;
+    }
+
+    template <int Id, typename R, typename... Args>
+    void bindTimed(R (*&fn)(Args...))
+    {
+        if (!fn || Id == id_nvmlEventSetWait_v2)
+            return;
+        Entry<Id, R(Args...)>::timedReal = fn;
+        fn = Entry<Id, R(Args...)>::timed;
+    }
+
+    template <int Id, typename R, typename... Args>
+    void bindUnsupported(R (*&fn)(Args...))
+    {
+        fn = Entry<Id, R(Args...)>::unsupported;
+    }
+
+    const char* stubErrorString(nvmlReturn_t result)
+    {
+        switch (result)
+        {
+        case NVML_SUCCESS: return "Success";
+        case NVML_ERROR_UNINITIALIZED: return "Uninitialized";
+        case NVML_ERROR_INVALID_ARGUMENT: return "Invalid Argument";
+        case NVML_ERROR_NOT_SUPPORTED: return "Not Supported";
+        case NVML_ERROR_NO_PERMISSION: return "Insufficient Permissions";
+        case NVML_ERROR_NOT_FOUND: return "Not Found";
+        case NVML_ERROR_INSUFFICIENT_SIZE: return "Insufficient Size";
+        case NVML_ERROR_TIMEOUT: return "Timeout";
+        case NVML_ERROR_GPU_IS_LOST: return "GPU is lost";
+        default: return "Unknown Error";
+        }
+    }
+
+    decltype(_nvmlEventSetWait_v2) replayEventSetWait = nullptr;
+
+    // synthetic devices, the handles are the device index + 1
+    int fakeDeviceCount = 0;
+    const unsigned long long kFakeSamplePeriodUs = 20 * 1000;
+    const unsigned long long kFakeSampleCount = 100;
+
+    int fakeIndex(nvmlDevice_t device)
+    {
+        int i = (int)(uintptr_t)device - 1;
+        return i >= 0 && i < fakeDeviceCount ? i : -1;
+    }
+
+    unsigned long long wallUs()
+    {
+        using namespace std::chrono;
+        return duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+    }
+
+    // load in [0, 1], out of phase between the devices
+    double fakeLoad(int i, unsigned long long timeUs)
+    {
+        double t = (timeUs % (1000ull * 1000 * 1000 * 1000)) * 1e-6;
+        double load = 0.5 + 0.35 * sin(t * 0.4 + i * 1.7) + 0.15 * sin(t * 3.1 + i);
+        return (std::min)(1.0, (std::max)(0.0, load));
+    }
+
+    // with more than one device, every one has kFakeLinkCount links to its peers
+    const unsigned int kFakeLinkCount = 4;
+    const unsigned int kFakeLinkSpeedMBps = 25000;
+    unsigned long long fakeStartUs = 0;
+
+    unsigned int fakeLinkCount()
+    {
+        return fakeDeviceCount > 1 ? kFakeLinkCount : 0;
+    }
+
+    int fakeLinkPeer(int i, unsigned int link)
+    {
+        return (i + 1 + link % (fakeDeviceCount - 1)) % fakeDeviceCount;
+    }
+
+    // KiB sent (or received) over a link since the start, the integral of
+    // speed * (0.3 + 0.25 sin(w t + phase))
+    unsigned long long fakeLinkKiB(int i, unsigned int link, bool isTx, unsigned long long timeUs)
+    {
+        double t = (timeUs - fakeStartUs) * 1e-6;
+        double w = 0.5 + 0.2 * link;
+        double phase = i * 1.3 + link * 0.7 + (isTx ? 0 : 2.1);
+        double bytes = kFakeLinkSpeedMBps * 1e6 * (0.3 * t + 0.25 / w * (cos(phase) - cos(w * t + phase)));
+        return (unsigned long long)(bytes / 1024);
+    }
+
+    // one of the devices changes its pstate every kFakeEventPeriodUs, every tenth time it's an XID
+    const unsigned long long kFakeEventPeriodUs = 3 * 1000 * 1000;
+    const nvmlEventSet_t kFakeEventSet = (nvmlEventSet_t)(uintptr_t)1;
+    unsigned long long fakeEventCount = 0;
+
+    // every kFakeResetEvery events the XID is a reset instead: the sampling calls of that device
+    // block for kFakeResetUs like the driver during a recovery, then answer UNINITIALIZED until nvmlInit
+    const unsigned long long kFakeResetEvery = 50;
+    const unsigned long long kFakeResetUs = 6 * 1000 * 1000;
+
+    struct FakeReset
+    {
+        atomic<unsigned long long> untilUs{ 0 };
+        atomic<bool> isPending{ false };
+    };
+    unique_ptr<FakeReset[]> fakeResets;
+
+    nvmlReturn_t fakeRecovery(int i)
+    {
+        auto& reset = fakeResets[i];
+        if (!reset.isPending)
+            return NVML_SUCCESS;
+        auto now = wallUs();
+        if (reset.untilUs > now)
+            this_thread::sleep_for(chrono::microseconds(reset.untilUs - now));
+        return NVML_ERROR_UNINITIALIZED;
+    }
+
+    // three long running processes per device and a short lived one replaced every 5 s
+    const int kFakeProcessCount = 4;
+    const unsigned long long kFakeProcessPeriodUs = 200 * 1000;
+
+    unsigned int fakeProcessId(int i, int k, unsigned long long timeUs)
+    {
+        if (k < kFakeProcessCount - 1)
+            return 1000 + i * 10 + k;
+        return 100000 + i * 10000 + (unsigned int)(timeUs / (5 * 1000 * 1000) % 10000);
+    }
+
+    unsigned int fakeValue(nvmlSamplingType_t type, int i, unsigned long long timeUs)
+    {
+        double load = fakeLoad(i, timeUs);
+        switch (type)
+        {
+        case NVML_TOTAL_POWER_SAMPLES: return (unsigned int)(60000 + 190000 * load);
+        case NVML_GPU_UTILIZATION_SAMPLES: return (unsigned int)(100 * load);
+        case NVML_MEMORY_UTILIZATION_SAMPLES: return (unsigned int)(60 * load);
+        case NVML_ENC_UTILIZATION_SAMPLES: return load > 0.8 ? 25 : 0;
+        case NVML_DEC_UTILIZATION_SAMPLES: return load > 0.9 ? 10 : 0;
+        case NVML_PROCESSOR_CLK_SAMPLES: return (unsigned int)(1200 + 700 * load);
+        case NVML_MEMORY_CLK_SAMPLES: return 9501;
+        default: return 0;
+        }
+    }
+
+    void bindFakes()
+    {
+        _nvmlInit_v2 = []
+        {
+            // the devices are back once their reset is over
+            auto now = wallUs();
+            for (int i = 0; i < fakeDeviceCount; i++)
+            {
+                if (fakeResets[i].untilUs <= now)
+                    fakeResets[i].isPending = false;
+            }
+            return NVML_SUCCESS;
+        };
+        _nvmlInitWithFlags = [](unsigned int) { return NVML_SUCCESS; };
+        _nvmlShutdown = [] { return NVML_SUCCESS; };
+
+        _nvmlSystemGetDriverVersion = [](char* version, unsigned int length)
+        {
+            snprintf(version, length, "stub");
+            return NVML_SUCCESS;
+        };
+        _nvmlSystemGetNVMLVersion = [](char* version, unsigned int length)
+        {
+            snprintf(version, length, "stub");
+            return NVML_SUCCESS;
+        };
+        _nvmlSystemGetCudaDriverVersion = [](int* version)
+        {
+            *version = 12000;
+            return NVML_SUCCESS;
+        };
+        _nvmlDeviceGetCount_v2 = [](unsigned int* count)
+        {
+            *count = fakeDeviceCount;
+            return NVML_SUCCESS;
+        };
+        _nvmlDeviceGetHandleByIndex_v2 = [](unsigned int index, nvmlDevice_t* device)
+        {
+            if (index >= (unsigned int)fakeDeviceCount)
+                return NVML_ERROR_INVALID_ARGUMENT;
+            *device = (nvmlDevice_t)(uintptr_t)(index + 1);
+            return NVML_SUCCESS;
+        };
+        _nvmlDeviceGetHandleByPciBusId_v2 = [](const char* busId, nvmlDevice_t* device)
+        {
+            unsigned int domain, bus;
+            if (sscanf(busId, "%x:%x:", &domain, &bus) != 2 || bus < 1 || bus > (unsigned int)fakeDeviceCount)
+                return NVML_ERROR_NOT_FOUND;
+            *device = (nvmlDevice_t)(uintptr_t)bus;
+            return NVML_SUCCESS;
+        };
+
+        // static properties
+        _nvmlDeviceGetName = [](nvmlDevice_t device, char* name, unsigned int length)
+        {
+            int i = fakeIndex(device);
+            if (i < 0)
+                return NVML_ERROR_INVALID_ARGUMENT;
+            snprintf(name, length, "Fake GPU %d", i);
+            return NVML_SUCCESS;
+        };
+        _nvmlDeviceGetPciInfo_v3 = [](nvmlDevice_t device, nvmlPciInfo_t* pci)
+        {
+            int i = fakeIndex(device);
+            if (i < 0)
+                return NVML_ERROR_INVALID_ARGUMENT;
+            memset(pci, 0, sizeof(*pci));
+            pci->bus = i + 1;
+            pci->pciDeviceId = 0x220410DE;
+            snprintf(pci->busId, sizeof(pci->busId), "00000000:%02X:00.0", pci->bus);
+            snprintf(pci->busIdLegacy, sizeof(pci->busIdLegacy), "0000:%02X:00.0", pci->bus);
+            return NVML_SUCCESS;
+        };
+        _nvmlDeviceGetBrand = [](nvmlDevice_t device, nvmlBrandType_t* type)
+        {
+            *type = NVML_BRAND_GEFORCE_RTX;
+            return fakeIndex(device) < 0 ? NVML_ERROR_INVALID_ARGUMENT : NVML_SUCCESS;
+        };
+        _nvmlDeviceGetArchitecture = [](nvmlDevice_t device, nvmlDeviceArchitecture_t* arch)
+        {
+            *arch = NVML_DEVICE_ARCH_AMPERE;
+            return fakeIndex(device) < 0 ? NVML_ERROR_INVALID_ARGUMENT : NVML_SUCCESS;
+        };
+        _nvmlDeviceGetNumGpuCores = [](nvmlDevice_t device, unsigned int* cores)
+        {
+            *cores = 10496;
+            return fakeIndex(device) < 0 ? NVML_ERROR_INVALID_ARGUMENT : NVML_SUCCESS;
+        };
+        _nvmlDeviceGetMemoryBusWidth = [](nvmlDevice_t device, unsigned int* width)
+        {
+            *width = 384;
+            return fakeIndex(device) < 0 ? NVML_ERROR_INVALID_ARGUMENT : NVML_SUCCESS;
+        };
+        _nvmlDeviceGetCurrPcieLinkWidth = [](nvmlDevice_t device, unsigned int* width)
+        {
+            *width = 16;
+            return fakeIndex(device) < 0 ? NVML_ERROR_INVALID_ARGUMENT : NVML_SUCCESS;
+        };
+        _nvmlDeviceGetCurrPcieLinkGeneration = [](nvmlDevice_t device, unsigned int* generation)
+        {
+            *generation = 4;
+            return fakeIndex(device) < 0 ? NVML_ERROR_INVALID_ARGUMENT : NVML_SUCCESS;
+        };
+        _nvmlDeviceGetPcieSpeed = [](nvmlDevice_t device, unsigned int* speed)
+        {
+            *speed = 16000;
+            return fakeIndex(device) < 0 ? NVML_ERROR_INVALID_ARGUMENT : NVML_SUCCESS;
+        };
+        _nvmlDeviceGetAccountingMode = [](nvmlDevice_t device, nvmlEnableState_t* mode)
+        {
+            *mode = NVML_FEATURE_DISABLED;
+            return fakeIndex(device) < 0 ? NVML_ERROR_INVALID_ARGUMENT : NVML_SUCCESS;
+        };
+
+        // what the collector polls
+        _nvmlDeviceGetUtilizationRates = [](nvmlDevice_t device, nvmlUtilization_t* utilization)
+        {
+            int i = fakeIndex(device);
+            if (i < 0)
+                return NVML_ERROR_INVALID_ARGUMENT;
+            if (auto ret = fakeRecovery(i))
+                return ret;
+            auto now = wallUs();
+            utilization->gpu = fakeValue(NVML_GPU_UTILIZATION_SAMPLES, i, now);
+            utilization->memory = fakeValue(NVML_MEMORY_UTILIZATION_SAMPLES, i, now);
+            return NVML_SUCCESS;
+        };
+        _nvmlDeviceGetMemoryInfo = [](nvmlDevice_t device, nvmlMemory_t* memory)
+        {
+            int i = fakeIndex(device);
+            if (i < 0)
+                return NVML_ERROR_INVALID_ARGUMENT;
+            memory->total = 24ull << 30;
+            memory->used = (unsigned long long)((2 + 16 * fakeLoad(i, wallUs())) * (1 << 30));
+            memory->free = memory->total - memory->used;
+            return NVML_SUCCESS;
+        };
+        _nvmlDeviceGetTemperature = [](nvmlDevice_t device, nvmlTemperatureSensors_t, unsigned int* temp)
+        {
+            int i = fakeIndex(device);
+            if (i < 0)
+                return NVML_ERROR_INVALID_ARGUMENT;
+            *temp = (unsigned int)(35 + 45 * fakeLoad(i, wallUs()));
+            return NVML_SUCCESS;
+        };
+        _nvmlDeviceGetPowerUsage = [](nvmlDevice_t device, unsigned int* power)
+        {
+            int i = fakeIndex(device);
+            if (i < 0)
+                return NVML_ERROR_INVALID_ARGUMENT;
+            *power = fakeValue(NVML_TOTAL_POWER_SAMPLES, i, wallUs());
+            return NVML_SUCCESS;
+        };
+        _nvmlDeviceGetEncoderUtilization = [](nvmlDevice_t device, unsigned int* util, unsigned int* periodUs)
+        {
+            int i = fakeIndex(device);
+            if (i < 0)
+                return NVML_ERROR_INVALID_ARGUMENT;
+            *util = fakeValue(NVML_ENC_UTILIZATION_SAMPLES, i, wallUs());
+            *periodUs = (unsigned int)kFakeSamplePeriodUs;
+            return NVML_SUCCESS;
+        };
+        _nvmlDeviceGetDecoderUtilization = [](nvmlDevice_t device, unsigned int* util, unsigned int* periodUs)
+        {
+            int i = fakeIndex(device);
+            if (i < 0)
+                return NVML_ERROR_INVALID_ARGUMENT;
+            *util = fakeValue(NVML_DEC_UTILIZATION_SAMPLES, i, wallUs());
+            *periodUs = (unsigned int)kFakeSamplePeriodUs;
+            return NVML_SUCCESS;
+        };
+        _nvmlDeviceGetClockInfo = [](nvmlDevice_t device, nvmlClockType_t type, unsigned int* clock)
+        {
+            int i = fakeIndex(device);
+            if (i < 0)
+                return NVML_ERROR_INVALID_ARGUMENT;
+            *clock = fakeValue(type == NVML_CLOCK_MEM ? NVML_MEMORY_CLK_SAMPLES : NVML_PROCESSOR_CLK_SAMPLES, i, wallUs());
+            return NVML_SUCCESS;
+        };
+        _nvmlDeviceGetMaxClockInfo = [](nvmlDevice_t device, nvmlClockType_t type, unsigned int* clock)
+        {
+            *clock = type == NVML_CLOCK_MEM ? 10501 : 2100;
+            return fakeIndex(device) < 0 ? NVML_ERROR_INVALID_ARGUMENT : NVML_SUCCESS;
+        };
+        _nvmlDeviceGetSupportedClocksThrottleReasons = [](nvmlDevice_t device, unsigned long long* reasons)
+        {
+            *reasons = nvmlClocksThrottleReasonAll;
+            return fakeIndex(device) < 0 ? NVML_ERROR_INVALID_ARGUMENT : NVML_SUCCESS;
+        };
+        // idle at low load, power capped and then thermally throttled at the top
+        _nvmlDeviceGetCurrentClocksThrottleReasons = [](nvmlDevice_t device, unsigned long long* reasons)
+        {
+            int i = fakeIndex(device);
+            if (i < 0)
+                return NVML_ERROR_INVALID_ARGUMENT;
+            double load = fakeLoad(i, wallUs());
+            *reasons = 0;
+            if (load < 0.2)
+                *reasons |= nvmlClocksThrottleReasonGpuIdle;
+            if (load > 0.8)
+                *reasons |= nvmlClocksThrottleReasonSwPowerCap;
+            if (load > 0.95)
+                *reasons |= nvmlClocksThrottleReasonSwThermalSlowdown;
+            return NVML_SUCCESS;
+        };
+        _nvmlDeviceGetPcieThroughput = [](nvmlDevice_t device, nvmlPcieUtilCounter_t counter, unsigned int* value)
+        {
+            int i = fakeIndex(device);
+            if (i < 0)
+                return NVML_ERROR_INVALID_ARGUMENT;
+            // like the driver, which measures over 20 ms before it returns
+            this_thread::sleep_for(chrono::milliseconds(20));
+            double kbps = 4e6 * fakeLoad(i, wallUs());
+            *value = (unsigned int)(counter == NVML_PCIE_UTIL_TX_BYTES ? kbps : kbps / 2);
+            return NVML_SUCCESS;
+        };
+
+        // the nvlink fields, every other field is unsupported
+        _nvmlDeviceGetFieldValues = [](nvmlDevice_t device, int valuesCount, nvmlFieldValue_t* values)
+        {
+            int i = fakeIndex(device);
+            if (i < 0)
+                return NVML_ERROR_INVALID_ARGUMENT;
+            if (auto ret = fakeRecovery(i))
+                return ret;
+            auto now = wallUs();
+            for (int k = 0; k < valuesCount; k++)
+            {
+                auto& field = values[k];
+                field.timestamp = (long long)now;
+                field.latencyUsec = 0;
+                field.valueType = NVML_VALUE_TYPE_UNSIGNED_INT;
+                field.value.ullVal = 0;
+                field.nvmlReturn = NVML_SUCCESS;
+                auto link = field.scopeId;
+                switch (field.fieldId)
+                {
+                case NVML_FI_DEV_NVLINK_LINK_COUNT:
+                    field.value.uiVal = fakeLinkCount();
+                    break;
+                case NVML_FI_DEV_NVLINK_SPEED_MBPS_COMMON:
+                    field.value.uiVal = fakeLinkCount() > 0 ? kFakeLinkSpeedMBps : 0;
+                    break;
+                case NVML_FI_DEV_NVLINK_SPEED_MBPS_L0:
+                case NVML_FI_DEV_NVLINK_SPEED_MBPS_L1:
+                case NVML_FI_DEV_NVLINK_SPEED_MBPS_L2:
+                case NVML_FI_DEV_NVLINK_SPEED_MBPS_L3:
+                    field.value.uiVal = field.fieldId - NVML_FI_DEV_NVLINK_SPEED_MBPS_L0 < fakeLinkCount() ? kFakeLinkSpeedMBps : 0;
+                    break;
+                case NVML_FI_DEV_NVLINK_THROUGHPUT_DATA_TX:
+                case NVML_FI_DEV_NVLINK_THROUGHPUT_DATA_RX:
+                    if (link >= fakeLinkCount())
+                    {
+                        field.nvmlReturn = NVML_ERROR_INVALID_ARGUMENT;
+                        break;
+                    }
+                    field.valueType = NVML_VALUE_TYPE_UNSIGNED_LONG_LONG;
+                    field.value.ullVal = fakeLinkKiB(i, link, field.fieldId == NVML_FI_DEV_NVLINK_THROUGHPUT_DATA_TX, now);
+                    break;
+                default:
+                    field.nvmlReturn = NVML_ERROR_NOT_SUPPORTED;
+                    break;
+                }
+            }
+            return NVML_SUCCESS;
+        };
+        _nvmlDeviceGetNvLinkState = [](nvmlDevice_t device, unsigned int link, nvmlEnableState_t* isActive)
+        {
+            if (fakeIndex(device) < 0 || link >= fakeLinkCount())
+                return NVML_ERROR_INVALID_ARGUMENT;
+            *isActive = NVML_FEATURE_ENABLED;
+            return NVML_SUCCESS;
+        };
+        _nvmlDeviceGetNvLinkRemotePciInfo_v2 = [](nvmlDevice_t device, unsigned int link, nvmlPciInfo_t* pci)
+        {
+            int i = fakeIndex(device);
+            if (i < 0 || link >= fakeLinkCount())
+                return NVML_ERROR_INVALID_ARGUMENT;
+            return _nvmlDeviceGetPciInfo_v3((nvmlDevice_t)(uintptr_t)(fakeLinkPeer(i, link) + 1), pci);
+        };
+        _nvmlDeviceGetTopologyCommonAncestor = [](nvmlDevice_t device1, nvmlDevice_t device2, nvmlGpuTopologyLevel_t* level)
+        {
+            if (fakeIndex(device1) < 0 || fakeIndex(device2) < 0)
+                return NVML_ERROR_INVALID_ARGUMENT;
+            *level = NVML_TOPOLOGY_HOSTBRIDGE;
+            return NVML_SUCCESS;
+        };
+        _nvmlDeviceSetNvLinkUtilizationControl = [](nvmlDevice_t device, unsigned int link, unsigned int,
+            nvmlNvLinkUtilizationControl_t*, unsigned int)
+        {
+            return fakeIndex(device) < 0 || link >= fakeLinkCount() ? NVML_ERROR_INVALID_ARGUMENT : NVML_SUCCESS;
+        };
+
+        // the events, delivered at the time they are due
+        _nvmlEventSetCreate = [](nvmlEventSet_t* set)
+        {
+            *set = kFakeEventSet;
+            return NVML_SUCCESS;
+        };
+        _nvmlEventSetFree = [](nvmlEventSet_t set)
+        {
+            return set == kFakeEventSet ? NVML_SUCCESS : NVML_ERROR_INVALID_ARGUMENT;
+        };
+        _nvmlDeviceGetSupportedEventTypes = [](nvmlDevice_t device, unsigned long long* eventTypes)
+        {
+            *eventTypes = nvmlEventTypePState | nvmlEventTypeXidCriticalError;
+            return fakeIndex(device) < 0 ? NVML_ERROR_INVALID_ARGUMENT : NVML_SUCCESS;
+        };
+        _nvmlDeviceRegisterEvents = [](nvmlDevice_t device, unsigned long long, nvmlEventSet_t set)
+        {
+            return fakeIndex(device) < 0 || set != kFakeEventSet ? NVML_ERROR_INVALID_ARGUMENT : NVML_SUCCESS;
+        };
+        _nvmlEventSetWait_v2 = [](nvmlEventSet_t set, nvmlEventData_t* data, unsigned int timeoutms)
+        {
+            if (set != kFakeEventSet)
+                return NVML_ERROR_INVALID_ARGUMENT;
+            auto now = wallUs();
+            auto dueUs = fakeStartUs + (fakeEventCount + 1) * kFakeEventPeriodUs;
+            if (dueUs > now + timeoutms * 1000ull)
+            {
+                this_thread::sleep_for(chrono::milliseconds(timeoutms));
+                return NVML_ERROR_TIMEOUT;
+            }
+            if (dueUs > now)
+                this_thread::sleep_for(chrono::microseconds(dueUs - now));
+            auto k = ++fakeEventCount;
+            int i = (int)(k % fakeDeviceCount);
+            memset(data, 0, sizeof(*data));
+            data->device = (nvmlDevice_t)(uintptr_t)(i + 1);
+            data->eventType = k % 10 == 0 ? nvmlEventTypeXidCriticalError : nvmlEventTypePState;
+            data->eventData = k % 10 == 0 ? 13 : 0;
+            if (k % kFakeResetEvery == 0)
+            {
+                data->eventData = 43;
+                fakeResets[i].untilUs = wallUs() + kFakeResetUs;
+                fakeResets[i].isPending = true;
+            }
+            data->gpuInstanceId = 0xFFFFFFFF;
+            data->computeInstanceId = 0xFFFFFFFF;
+            return NVML_SUCCESS;
+        };
+        _nvmlDeviceGetPerformanceState = [](nvmlDevice_t device, nvmlPstates_t* pstate)
+        {
+            int i = fakeIndex(device);
+            if (i < 0)
+                return NVML_ERROR_INVALID_ARGUMENT;
+            *pstate = fakeLoad(i, wallUs()) > 0.3 ? NVML_PSTATE_0 : NVML_PSTATE_8;
+            return NVML_SUCCESS;
+        };
+
+        // one sample per process every kFakeProcessPeriodUs, the load split between them
+        _nvmlDeviceGetProcessUtilization = [](nvmlDevice_t device, nvmlProcessUtilizationSample_t* utilization,
+            unsigned int* processSamplesCount, unsigned long long lastSeenTimeStamp)
+        {
+            int i = fakeIndex(device);
+            if (i < 0 || !processSamplesCount)
+                return NVML_ERROR_INVALID_ARGUMENT;
+            auto newest = wallUs() / kFakeProcessPeriodUs * kFakeProcessPeriodUs;
+            auto oldest = newest - (kFakeSampleCount - 1) * kFakeProcessPeriodUs;
+            auto first = (std::max)(oldest, (lastSeenTimeStamp / kFakeProcessPeriodUs + 1) * kFakeProcessPeriodUs);
+            if (first > newest)
+                return NVML_ERROR_NOT_FOUND;
+            auto count = (unsigned int)((newest - first) / kFakeProcessPeriodUs + 1) * kFakeProcessCount;
+            if (!utilization || *processSamplesCount < count)
+            {
+                *processSamplesCount = count;
+                return NVML_ERROR_INSUFFICIENT_SIZE;
+            }
+            unsigned int n = 0;
+            for (auto timeUs = first; timeUs <= newest; timeUs += kFakeProcessPeriodUs)
+            {
+                double load = fakeLoad(i, timeUs);
+                for (int k = 0; k < kFakeProcessCount; k++)
+                {
+                    auto& sample = utilization[n++];
+                    sample.pid = fakeProcessId(i, k, timeUs);
+                    sample.timeStamp = timeUs;
+                    sample.smUtil = (unsigned int)(100 * load * (k + 1) / 10);
+                    sample.memUtil = sample.smUtil / 2;
+                    sample.encUtil = k == 1 ? fakeValue(NVML_ENC_UTILIZATION_SAMPLES, i, timeUs) : 0;
+                    sample.decUtil = 0;
+                }
+            }
+            *processSamplesCount = n;
+            return NVML_SUCCESS;
+        };
+
+        // the driver buffer holds the last kFakeSampleCount samples, one every kFakeSamplePeriodUs
+        _nvmlDeviceGetSamples = [](nvmlDevice_t device, nvmlSamplingType_t type, unsigned long long lastSeenTimeStamp,
+            nvmlValueType_t* sampleValType, unsigned int* sampleCount, nvmlSample_t* samples)
+        {
+            int i = fakeIndex(device);
+            if (i < 0 || !sampleValType || !sampleCount)
+                return NVML_ERROR_INVALID_ARGUMENT;
+            if (auto ret = fakeRecovery(i))
+                return ret;
+            auto newest = wallUs() / kFakeSamplePeriodUs * kFakeSamplePeriodUs;
+            auto oldest = newest - (kFakeSampleCount - 1) * kFakeSamplePeriodUs;
+            auto first = (std::max)(oldest, (lastSeenTimeStamp / kFakeSamplePeriodUs + 1) * kFakeSamplePeriodUs);
+            if (first > newest)
+                return NVML_ERROR_NOT_FOUND;
+            auto count = (unsigned int)((newest - first) / kFakeSamplePeriodUs + 1);
+            *sampleValType = NVML_VALUE_TYPE_UNSIGNED_INT;
+            if (samples)
+            {
+                count = (std::min)(count, *sampleCount);
+                for (unsigned int k = 0; k < count; k++)
+                {
+                    samples[k].timeStamp = first + k * kFakeSamplePeriodUs;
+                    samples[k].sampleValue.uiVal = fakeValue(type, i, samples[k].timeStamp);
+                }
+            }
+            *sampleCount = count;
+            return NVML_SUCCESS;
+        };
+    }
+}
+
+bool nvml_stub_replay(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        fprintf(stderr, "[nvml_stub_replay] - can't open %s\r\n", path);
+        return false;
+    }
+    vector<uint8_t> data;
+    uint8_t chunk[64 * 1024];
+    size_t bytes;
+    while ((bytes = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        data.insert(data.end(), chunk, chunk + bytes);
+    fclose(file);
+
+    initArraySpecs();
+
+    // the tape names its entries, map them onto the ones of this build
+    const uint8_t* p = data.data();
+    auto end = p + data.size();
+    auto has = [&](size_t n) { return (size_t)(end - p) >= n; };
+    if (!has(sizeof(kTapeMagic) + 8) || memcmp(p, kTapeMagic, sizeof(kTapeMagic)) != 0)
+    {
+        fprintf(stderr, "[nvml_stub_replay] - %s is not an NVML tape\r\n", path);
+        return false;
+    }
+    p += sizeof(kTapeMagic);
+    auto version = load<uint32_t>(p);
+    auto entryCount = load<uint32_t>(p);
+    if (version != kTapeVersion)
+    {
+        fprintf(stderr, "[nvml_stub_replay] - %s is version %u, expected %u\r\n", path, version, kTapeVersion);
+        return false;
+    }
+    vector<int> entryIds(entryCount, -1);
+    for (uint32_t k = 0; k < entryCount && has(1); k++)
+    {
+        size_t length = *p++;
+        if (!has(length))
+            break;
+        for (int id = 0; id < ENTRY_COUNT; id++)
+        {
+            if (strlen(kEntryNames[id]) == length && memcmp(kEntryNames[id], p, length) == 0)
+                entryIds[k] = id;
+        }
+        p += length;
+    }
+
+    reader.tracks.clear();
+    size_t recordCount = 0;
+    while (has(2 + 8 + 4 + 1))
+    {
+        auto entry = load<uint16_t>(p);
+        auto key = load<uint64_t>(p);
+        auto offset = (size_t)(p - data.data());
+        p += 4;
+        int outputs = *p++;
+        bool truncated = false;
+        for (int k = 0; k < outputs && !truncated; k++)
+        {
+            truncated = !has(4);
+            if (truncated)
+                break;
+            auto outputBytes = load<uint32_t>(p);
+            truncated = !has(outputBytes);
+            p += truncated ? 0 : outputBytes;
+        }
+        if (truncated)
+            break;
+        if (entry < entryIds.size() && entryIds[entry] >= 0)
+            reader.tracks[{ entryIds[entry], key }].records.push_back(offset);
+        recordCount++;
+    }
+    reader.data = move(data);
+
+#define ENTRY(func) bindReplay<id_##func>(_##func);
+#include "../3rdparty/CUDA_SDK/nvml.def"
+#undef ENTRY
+    _nvmlErrorString = stubErrorString;
+    // the tape holds what the waits returned but not how long they blocked,
+    // without this the event thread would spin through them
+    replayEventSetWait = _nvmlEventSetWait_v2;
+    _nvmlEventSetWait_v2 = [](nvmlEventSet_t set, nvmlEventData_t* data, unsigned int timeoutms)
+    {
+        this_thread::sleep_for(chrono::milliseconds(timeoutms));
+        return replayEventSetWait(set, data, timeoutms);
+    };
+
+    printf("NVML replay of %s, %zu calls\n", path, recordCount);
+    return true;
+}
+
+bool nvml_stub_fake(int deviceCount)
+{
+    fakeDeviceCount = deviceCount;
+    fakeStartUs = wallUs();
+    fakeResets.reset(new FakeReset[deviceCount]);
+
+#define ENTRY(func) bindUnsupported<id_##func>(_##func);
+#include "../3rdparty/CUDA_SDK/nvml.def"
+#undef ENTRY
+    _nvmlErrorString = stubErrorString;
+    bindFakes();
+
+    return true;
+}
+
+bool nvml_stub_record(const char* path)
+{
+    initArraySpecs();
+
+    lock_guard<mutex> guard(writer.lock);
+    writer.file = fopen(path, "wb");
+    if (!writer.file)
+    {
+        fprintf(stderr, "[nvml_stub_record] - can't open %s\r\n", path);
+        return false;
+    }
+
+    writer.record.clear();
+    writer.put(kTapeMagic, sizeof(kTapeMagic));
+    writer.put(kTapeVersion);
+    writer.put((uint32_t)ENTRY_COUNT);
+    for (auto name : kEntryNames)
+    {
+        writer.put((uint8_t)strlen(name));
+        writer.put(name, strlen(name));
+    }
+    fwrite(writer.record.data(), 1, writer.record.size(), writer.file);
+
+#define ENTRY(func) bindRecord<id_##func>(_##func);
+#include "../3rdparty/CUDA_SDK/nvml.def"
+#undef ENTRY
+
+    return true;
+}
+
+void nvml_stub_close()
+{
+    lock_guard<mutex> guard(writer.lock);
+    if (writer.file)
+    {
+        fclose(writer.file);
+        writer.file = nullptr;
+    }
+}
+
+void nvml_stub_time()
+{
+    static bool isTimed = false;
+    if (isTimed)
+        return;
+    isTimed = true;
+#define ENTRY(func) bindTimed<id_##func>(_##func);
+#include "../3rdparty/CUDA_SDK/nvml.def"
+#undef ENTRY
+}
+
+void nvml_stub_set_call_hook(NvmlCallHook hook)
+{
+    callHook = hook;
+}
+
+void nvml_stub_get_costs(vector<NvmlCallCost>* costs)
+{
+    costs->clear();
+    for (int id = 0; id < ENTRY_COUNT; id++)
+    {
+        auto& cost = entryCosts[id];
+        lock_guard<mutex> guard(cost.lock);
+        if (cost.calls == 0)
+            continue;
+        NvmlCallCost entry;
+        entry.name = kEntryNames[id];
+        entry.calls = cost.calls;
+        entry.totalUs = cost.totalUs;
+        entry.p50Us = cost.sketch.quantile(0.5f);
+        entry.p99Us = cost.sketch.quantile(0.99f);
+        entry.maxUs = cost.maxUs;
+        costs->push_back(entry);
+    }
+    sort(costs->begin(), costs->end(), [](const NvmlCallCost& a, const NvmlCallCost& b) { return a.totalUs > b.totalUs; });
+}
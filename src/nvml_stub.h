@@ -0,0 +1,48 @@
+#pragma once
+
+#include "../3rdparty/CUDA_SDK/nvml.h"
+#include <stdint.h>
+#include <vector>
+
+// The NVML entry points, bound by LoadNVML() to nvml.dll or by one of the functions below.
+#define ENTRY(func) extern decltype(func)* _##func;
+#include "../3rdparty/CUDA_SDK/nvml.def"
+#undef ENTRY
+
+// Binds the entry points to a tape written by nvml_stub_record(). Every device replays its own
+// calls in order and loops back to the start once the tape runs out, calls the tape never saw
+// answer NVML_ERROR_NOT_SUPPORTED.
+bool nvml_stub_replay(const char* path);
+
+// Binds the entry points to deviceCount synthetic devices with a slowly varying load.
+bool nvml_stub_fake(int deviceCount);
+
+// Wraps the bound entry points, every call, its return code and what it wrote through its
+// pointers is appended to path.
+bool nvml_stub_record(const char* path);
+
+// Flushes and closes the tape.
+void nvml_stub_close();
+
+// Latency of the calls made through one entry point since nvml_stub_time().
+struct NvmlCallCost
+{
+    const char* name;
+    uint64_t calls;
+    double totalUs;
+    float p50Us;
+    float p99Us;
+    float maxUs;
+};
+
+// Wraps the bound entry points, whatever they are bound to, to time every call.
+// nvmlEventSetWait blocks on purpose and isn't timed.
+void nvml_stub_time();
+
+// Called with the name of the entry point before every timed call and with null after it,
+// on the calling thread. Set it before the sampling threads start.
+typedef void (*NvmlCallHook)(const char* entryName);
+void nvml_stub_set_call_hook(NvmlCallHook hook);
+
+// The entry points called at least once, the most expensive in total first. Thread safe.
+void nvml_stub_get_costs(std::vector<NvmlCallCost>* costs);
@@ -0,0 +1,214 @@
+#include "process_cache.h"
+#include "metric_series.h"
+#include "self_profile.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#ifdef _WIN32
+#include "util_win32.h"
+#else
+#include <dirent.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+    // ETW asks about new pids every 16 ms tick
+    const int64_t kMinRefreshMs = 16;
+    // forgets the processes that exited
+    const int64_t kMaxAgeMs = 1000;
+
+    struct ProcessCache
+    {
+        mutex lock;
+        unordered_map<uint32_t, ProcessMeta> processes;
+        unordered_map<uint32_t, ProcessMeta> scratch;
+        int64_t lastRefreshMs = 0;
+        bool isEmpty = true;
+        ProcessSource source = nullptr;
+        vector<ProcessMeta> sourced;
+    };
+
+    ProcessCache cache;
+
+#ifdef _WIN32
+    uint64_t queryStartTime(uint32_t pid)
+    {
+        HANDLE handle = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+        if (!handle)
+            return 0;
+        FILETIME creation, exit, kernel, user;
+        uint64_t startTime = 0;
+        if (GetProcessTimes(handle, &creation, &exit, &kernel, &user))
+            startTime = (uint64_t(creation.dwHighDateTime) << 32) | creation.dwLowDateTime;
+        CloseHandle(handle);
+        return startTime;
+    }
+
+    // calls fn(meta) for every running process, startTime is left to 0
+    template <typename Fn>
+    void enumerateProcesses(Fn fn)
+    {
+        HANDLE hSnapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+        if (hSnapshot == INVALID_HANDLE_VALUE)
+            return;
+        PROCESSENTRY32 pe32 = { sizeof(PROCESSENTRY32) };
+        ProcessMeta meta;
+        if (Process32First(hSnapshot, &pe32))
+        {
+            do
+            {
+                meta.pid = pe32.th32ProcessID;
+                meta.parentPid = pe32.th32ParentProcessID;
+                meta.threadCount = pe32.cntThreads;
+                meta.exeName = pe32.szExeFile;
+                fn(meta);
+            } while (Process32Next(hSnapshot, &pe32));
+        }
+        CloseHandle(hSnapshot);
+    }
+#else
+    // /proc/<pid>/stat has it already
+    uint64_t queryStartTime(uint32_t)
+    {
+        return 0;
+    }
+
+    // "pid (comm) state ppid ...", comm can hold spaces and parentheses
+    bool parseStat(const char* stat, ProcessMeta* meta)
+    {
+        auto open = strchr(stat, '(');
+        auto close = strrchr(stat, ')');
+        if (!open || !close || close < open)
+            return false;
+        meta->exeName.assign(open + 1, close);
+
+        // fields 3 and on, 1 based as in proc(5)
+        const char* p = close + 1;
+        for (int field = 3; field <= 22 && *p; field++)
+        {
+            while (*p == ' ') p++;
+            if (field == 4) meta->parentPid = (uint32_t)strtoul(p, nullptr, 10);
+            if (field == 20) meta->threadCount = (uint32_t)strtoul(p, nullptr, 10);
+            if (field == 22) meta->startTime = strtoull(p, nullptr, 10);
+            while (*p && *p != ' ') p++;
+        }
+        return meta->startTime != 0;
+    }
+
+    // calls fn(meta) for every running process
+    template <typename Fn>
+    void enumerateProcesses(Fn fn)
+    {
+        DIR* proc = opendir("/proc");
+        if (!proc)
+            return;
+        ProcessMeta meta;
+        char path[64];
+        char stat[512];
+        while (auto entry = readdir(proc))
+        {
+            char* end;
+            auto pid = strtoul(entry->d_name, &end, 10);
+            if (*end != '\0' || end == entry->d_name)
+                continue;
+            snprintf(path, sizeof(path), "/proc/%lu/stat", pid);
+            FILE* file = fopen(path, "r");
+            if (!file)
+                continue;
+            auto bytes = fread(stat, 1, sizeof(stat) - 1, file);
+            fclose(file);
+            stat[bytes] = '\0';
+            meta.pid = (uint32_t)pid;
+            if (parseStat(stat, &meta))
+                fn(meta);
+        }
+        closedir(proc);
+    }
+#endif
+
+    // one enumeration, the processes already in the table are moved over untouched
+    void refresh(int64_t now)
+    {
+        PROFILE_ZONE("refreshProcessCache");
+
+        auto& processes = cache.processes;
+        auto& next = cache.scratch;
+        next.clear();
+        auto visit = [&](const ProcessMeta& meta)
+        {
+            auto it = processes.find(meta.pid);
+            bool isKnown = it != processes.end();
+            if (isKnown && meta.startTime != 0)
+                isKnown = it->second.startTime == meta.startTime;
+            else if (isKnown)
+                isKnown = it->second.parentPid == meta.parentPid && it->second.exeName == meta.exeName;
+
+            if (isKnown)
+            {
+                it->second.threadCount = meta.threadCount;
+                next.emplace(meta.pid, move(it->second));
+            }
+            else
+            {
+                // a new process, or the pid was reused
+                auto& entry = next[meta.pid];
+                entry = meta;
+                if (entry.startTime == 0)
+                    entry.startTime = queryStartTime(meta.pid);
+            }
+        };
+        if (cache.source)
+        {
+            cache.sourced.clear();
+            cache.source(&cache.sourced);
+            for (const auto& meta : cache.sourced)
+                visit(meta);
+        }
+        else
+        {
+            enumerateProcesses(visit);
+        }
+        swap(processes, next);
+        cache.lastRefreshMs = now;
+        cache.isEmpty = false;
+    }
+}
+
+bool lookupProcess(uint32_t pid, ProcessMeta* meta)
+{
+    lock_guard<mutex> guard(cache.lock);
+    auto now = getMetricTimeMs();
+    auto age = now - cache.lastRefreshMs;
+
+    auto it = cache.processes.find(pid);
+    if (cache.isEmpty || age >= kMaxAgeMs || (it == cache.processes.end() && age >= kMinRefreshMs))
+    {
+        refresh(now);
+        it = cache.processes.find(pid);
+    }
+    if (it == cache.processes.end())
+        return false;
+    *meta = it->second;
+    return true;
+}
+
+size_t refreshProcessCache()
+{
+    lock_guard<mutex> guard(cache.lock);
+    refresh(getMetricTimeMs());
+    return cache.processes.size();
+}
+
+void setProcessSource(ProcessSource source)
+{
+    lock_guard<mutex> guard(cache.lock);
+    cache.source = source;
+    cache.processes.clear();
+    cache.isEmpty = true;
+}
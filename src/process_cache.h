@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// What the collectors show about a process.
+struct ProcessMeta
+{
+    uint32_t pid = 0;
+    uint32_t parentPid = 0;
+    uint64_t startTime = 0;     // FILETIME on Windows, clock ticks since boot on Linux, tells a reused pid apart
+    uint32_t threadCount = 0;
+    std::string exeName;
+};
+
+// Process metadata keyed by (pid, start time), shared by the collectors.
+// One enumeration of the running processes refreshes the whole table, at most once every
+// kMinRefreshMs and only when a pid is unknown or the table is older than kMaxAgeMs,
+// only the processes that are new since the last one are queried further.
+// Thread safe.
+bool lookupProcess(uint32_t pid, ProcessMeta* meta);
+
+// Forces a refresh, returns the number of processes in the table.
+size_t refreshProcessCache();
+
+// Replaces the enumeration of the running processes, for the tests and the benchmark,
+// nullptr goes back to the system. The table is emptied either way.
+typedef void (*ProcessSource)(std::vector<ProcessMeta>* processes);
+void setProcessSource(ProcessSource source);
@@ -0,0 +1,130 @@
+#include "quantile_sketch.h"
+#include <math.h>
+#include <algorithm>
+
+namespace
+{
+    // gamma = (1 + a) / (1 - a) for a relative accuracy a of 1%
+    const double kGamma = 1.01 / 0.99;
+    const double kLogGamma = log(kGamma);
+    const double kInvLogGamma = 1.0 / kLogGamma;
+    // key of MIN_VALUE, keys are stored relative to it
+    const int kKeyOffset = (int)ceil(log(1e-3) * kInvLogGamma);
+}
+
+const float QuantileSketch::MIN_VALUE = 1e-3f;
+
+int QuantileSketch::getKey(float value)
+{
+    if (!(value >= MIN_VALUE))
+        return -1;
+    int key = (int)ceil(log((double)value) * kInvLogGamma) - kKeyOffset;
+    return std::min(key, BIN_COUNT - 1);
+}
+
+void QuantileSketch::addKey(int key)
+{
+    count++;
+    if (key < 0)
+    {
+        zeroCount++;
+        return;
+    }
+    if (bins.empty())
+        bins.assign(BIN_COUNT, 0);
+    bins[key]++;
+}
+
+void QuantileSketch::merge(const QuantileSketch& other)
+{
+    count += other.count;
+    zeroCount += other.zeroCount;
+    if (other.bins.empty())
+        return;
+    if (bins.empty())
+    {
+        bins = other.bins;
+        return;
+    }
+    for (int i = 0; i < BIN_COUNT; i++)
+        bins[i] += other.bins[i];
+}
+
+void QuantileSketch::reset()
+{
+    std::fill(bins.begin(), bins.end(), 0);
+    zeroCount = 0;
+    count = 0;
+}
+
+float QuantileSketch::quantile(float q) const
+{
+    if (count == 0)
+        return 0;
+
+    uint64_t rank = (uint64_t)(q * (count - 1));
+    if (rank < zeroCount || bins.empty())
+        return 0;
+
+    uint64_t seen = zeroCount;
+    for (int i = 0; i < BIN_COUNT; i++)
+    {
+        seen += bins[i];
+        if (seen > rank)
+        {
+            // middle of the bin (gamma^(k-1), gamma^k] in the relative error sense
+            int key = i + kKeyOffset;
+            return (float)(2.0 * exp(key * kLogGamma) / (kGamma + 1));
+        }
+    }
+    return 0;
+}
+
+void MetricSketch::add(float value, int64_t timeMs)
+{
+    int64_t start = timeMs - timeMs % CHUNK_MS;
+    if (headStart < 0)
+    {
+        headStart = start;
+    }
+    else if (start > headStart)
+    {
+        // recycle the chunks that slid out of the window
+        int64_t steps = std::min<int64_t>((start - headStart) / CHUNK_MS, CHUNK_COUNT);
+        for (int64_t i = 0; i < steps; i++)
+        {
+            head = (head + 1) % CHUNK_COUNT;
+            chunks[head].reset();
+        }
+        headStart = start;
+    }
+
+    int key = QuantileSketch::getKey(value);
+    session.addKey(key);
+    chunks[head].addKey(key);
+}
+
+void MetricSketch::reset()
+{
+    session.reset();
+    for (auto& chunk : chunks)
+        chunk.reset();
+    head = 0;
+    headStart = -1;
+}
+
+void MetricSketch::windowQuantiles(const float* qs, float* results, int n, int64_t windowMs) const
+{
+    int chunkCount = (int)std::min<int64_t>((windowMs + CHUNK_MS - 1) / CHUNK_MS, CHUNK_COUNT);
+    QuantileSketch merged;
+    for (int i = 0; i < chunkCount; i++)
+        merged.merge(chunks[(head - i + CHUNK_COUNT) % CHUNK_COUNT]);
+    for (int i = 0; i < n; i++)
+        results[i] = merged.quantile(qs[i]);
+}
+
+void MetricSketch::sessionQuantiles(const float* qs, float* results, int n) const
+{
+    for (int i = 0; i < n; i++)
+        results[i] = session.quantile(qs[i]);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// DDSketch style quantile sketch: values are counted in logarithmic bins so any
+// quantile is answered within 1% relative error, and two sketches merge by adding bins.
+// Values below MIN_VALUE (including negative ones) share the zero bin, values above
+// the top bin are clamped into it, so memory is bounded to BIN_COUNT counters.
+struct QuantileSketch
+{
+    static const int BIN_COUNT = 1200;
+    static const float MIN_VALUE;
+
+    std::vector<uint32_t> bins;     // allocated by the first add()
+    uint64_t zeroCount = 0;
+    uint64_t count = 0;
+
+    static int getKey(float value);
+
+    void add(float value) { addKey(getKey(value)); }
+    void addKey(int key);
+    void merge(const QuantileSketch& other);
+    void reset();
+
+    // q in [0, 1]
+    float quantile(float q) const;
+};
+
+// A session wide sketch plus a ring of time chunks for sliding window queries.
+struct MetricSketch
+{
+    static const int CHUNK_COUNT = 6;
+    static const int CHUNK_MS = 10 * 1000;
+    // longest sliding window that can be queried
+    static const int WINDOW_MS = CHUNK_COUNT * CHUNK_MS;
+
+    QuantileSketch session;
+    QuantileSketch chunks[CHUNK_COUNT];
+    int head = 0;               // chunk receiving the samples
+    int64_t headStart = -1;     // start time of the head chunk
+
+    void add(float value, int64_t timeMs);
+    void reset();
+
+    // Quantiles over the last windowMs milliseconds, rounded up to whole chunks.
+    void windowQuantiles(const float* qs, float* results, int n, int64_t windowMs) const;
+    void sessionQuantiles(const float* qs, float* results, int n) const;
+};
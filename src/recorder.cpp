@@ -0,0 +1,146 @@
+#include "recorder.h"
+#include "self_profile.h"
+#include <stdio.h>
+#include <chrono>
+
+using namespace std;
+
+namespace
+{
+    FILE* file = nullptr;
+    mutex queuesLock;
+    vector<shared_ptr<SampleQueue>> queues;
+    int64_t droppedReported = 0;
+
+    // a text with a comma, a quote or a line break is quoted and its quotes doubled, as in RFC 4180,
+    // process series carry exe names
+    string csvField(const string& text)
+    {
+        if (text.find_first_of(",\"\r\n") == string::npos)
+            return text;
+        string quoted = "\"";
+        for (char c : text)
+        {
+            if (c == '"')
+                quoted += '"';
+            quoted += c;
+        }
+        quoted += '"';
+        return quoted;
+    }
+}
+
+void SampleQueue::declare(MetricHandle handle, const MetricKey& key)
+{
+    lock_guard<mutex> guard(lock);
+    declared.emplace_back(handle, key);
+}
+
+void SampleQueue::push(MetricHandle handle, int64_t timeMs, float value)
+{
+    lock_guard<mutex> guard(lock);
+    if ((int)samples.size() >= CAPACITY)
+    {
+        dropped++;
+        return;
+    }
+    samples.push_back({ handle, timeMs, value });
+}
+
+int recorder_setup(const char* path)
+{
+    file = fopen(path, "w");
+    if (!file)
+    {
+        fprintf(stderr, "[recorder_setup] - can't open %s\r\n", path);
+        return -1;
+    }
+
+    deferMetricReuse(true);
+    using namespace std::chrono;
+    auto unixMs = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+    fprintf(file, "T,%lld,%lld\n", (long long)getMetricTimeMs(), (long long)unixMs);
+    return 0;
+}
+
+bool recorder_is_open()
+{
+    return file != nullptr;
+}
+
+shared_ptr<SampleQueue> recorder_add_queue()
+{
+    if (!file)
+        return nullptr;
+    auto queue = make_shared<SampleQueue>();
+    queue->samples.reserve(1024);
+    lock_guard<mutex> guard(queuesLock);
+    queues.push_back(queue);
+    return queue;
+}
+
+int recorder_update()
+{
+    if (!file)
+        return 0;
+    PROFILE_ZONE("recorder_update");
+
+    // the samples of these were queued before they were released, they are all written below
+    auto released = takeReleasedMetrics();
+    vector<shared_ptr<SampleQueue>> current;
+    {
+        lock_guard<mutex> guard(queuesLock);
+        current = queues;
+    }
+
+    // swap the buffers out so the collectors only wait for a pointer exchange
+    vector<RecordedSample> samples;
+    vector<pair<MetricHandle, MetricKey>> declared;
+    int64_t dropped = 0;
+    for (auto& queue : current)
+    {
+        {
+            lock_guard<mutex> guard(queue->lock);
+            samples.swap(queue->samples);
+            declared.swap(queue->declared);
+            dropped += queue->dropped;
+        }
+        for (const auto& d : declared)
+        {
+            const auto& key = d.second;
+            fprintf(file, "S,%d,%s,%d,%s,%s\n", d.first, csvField(key.source).c_str(), key.device,
+                csvField(key.name).c_str(), csvField(key.unit).c_str());
+        }
+        for (const auto& s : samples)
+            fprintf(file, "V,%lld,%d,%g\n", (long long)s.timeMs, s.handle, s.value);
+        samples.clear();
+        declared.clear();
+    }
+    auto now = getMetricTimeMs();
+    for (const auto& z : getIntervalZoneStats())
+    {
+        fprintf(file, "P,%lld,%s,%s,%lld,%.1f,%.1f,%.1f,%.1f\n", (long long)now, csvField(z.thread).c_str(), csvField(z.zone).c_str(),
+            (long long)z.calls, z.totalNs * 1e-3, z.p50Us, z.p99Us, z.maxNs * 1e-3);
+    }
+    fflush(file);
+    recycleMetrics(released);
+
+    if (dropped > droppedReported)
+    {
+        fprintf(stderr, "[recorder_update] - %lld samples dropped, the disk can't keep up\r\n", (long long)(dropped - droppedReported));
+        droppedReported = dropped;
+    }
+
+    return 0;
+}
+
+int recorder_cleanup()
+{
+    if (!file)
+        return 0;
+    recorder_update();
+    fclose(file);
+    file = nullptr;
+    deferMetricReuse(false);
+    return 0;
+}
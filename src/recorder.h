@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "metric_registry.h"
+
+struct RecordedSample
+{
+    MetricHandle handle;
+    int64_t timeMs;
+    float value;
+};
+
+// Bounded hand-off of the samples of one collector to the recorder, drained once a second.
+// Samples arriving while it is full are dropped and counted, the collector never waits on the disk.
+struct SampleQueue
+{
+    static const int CAPACITY = 1 << 16;
+
+    std::mutex lock;
+    std::vector<RecordedSample> samples;
+    std::vector<std::pair<MetricHandle, MetricKey>> declared;
+    int64_t dropped = 0;
+
+    void declare(MetricHandle handle, const MetricKey& key);
+    void push(MetricHandle handle, int64_t timeMs, float value);
+};
+
+// Appends every sample to a text file, one record per line, the texts with a comma or a quote
+// are quoted as in RFC 4180:
+//   T,<steady ms>,<unix ms>                           clock reference, written once
+//   S,<id>,<source>,<device>,<name>,<unit>            declares a series, an id is only redeclared after
+//                                                     the last sample of the series released before
+//   V,<steady ms>,<id>,<value>                        one sample
+//   P,<steady ms>,<thread>,<zone>,<calls>,<total us>,<p50 us>,<p99 us>,<max us>
+//                                                     gpuprof's own cost since the previous flush
+int recorder_setup(const char* path);
+bool recorder_is_open();
+// a queue for one collector, nullptr when nothing is recorded
+std::shared_ptr<SampleQueue> recorder_add_queue();
+// drains the queues into the file
+int recorder_update();
+int recorder_cleanup();
@@ -0,0 +1,198 @@
+#include "scheduler.h"
+#include "self_profile.h"
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include "../3rdparty/imgui/imgui.h"
+
+using namespace std;
+
+int64_t getSchedulerTimeUs()
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void Scheduler::add(const char* taskName, int periodMs, function<int()> fn)
+{
+    ScheduledTask task;
+    task.name = taskName;
+    task.periodUs = max(periodMs, 1) * 1000ll;
+    task.fn = fn;
+    task.zone = registerProfileZone(taskName);
+    tasks.emplace_back(move(task));
+}
+
+int Scheduler::runOnce()
+{
+    int64_t now = getSchedulerTimeUs();
+    for (auto& task : tasks)
+    {
+        if (task.deadlineUs > now)
+            continue;
+
+        float late = (now - task.deadlineUs) * 1e-3f;
+        int result = 0;
+        {
+            ProfileScope scope(task.zone);
+            result = task.fn();
+        }
+        int64_t end = getSchedulerTimeUs();
+
+        {
+            lock_guard<mutex> lock(statsLock);
+            task.runs++;
+            task.busyUs += end - now;
+            task.lateness.add(late);
+            task.latenessMax = max(task.latenessMax, late);
+
+            // next slot on the grid, the ones already in the past are skipped rather than bunched up
+            task.deadlineUs += task.periodUs;
+            if (task.deadlineUs <= end)
+            {
+                int64_t skipped = (end - task.deadlineUs) / task.periodUs + 1;
+                task.missed += skipped;
+                task.deadlineUs += skipped * task.periodUs;
+            }
+        }
+        now = end;
+
+        if (result != 0)
+            return result;
+    }
+
+    int64_t next = INT64_MAX;
+    for (const auto& task : tasks)
+        next = min(next, task.deadlineUs);
+    if (next != INT64_MAX && next > now)
+    {
+        unique_lock<mutex> lock(wakeLock);
+        wakeup.wait_until(lock, chrono::steady_clock::time_point(chrono::microseconds(next)),
+            [this] { return stopRequested.load(); });
+    }
+
+    return 0;
+}
+
+int Scheduler::run()
+{
+    setProfileThreadName(name.c_str());
+
+    // every task runs right away, the deadline grids are anchored there
+    {
+        lock_guard<mutex> lock(statsLock);
+        startUs = getSchedulerTimeUs();
+        for (auto& task : tasks)
+            task.deadlineUs = startUs;
+    }
+
+    while (!stopRequested)
+    {
+        int result = runOnce();
+        if (result != 0)
+            return result;
+    }
+    return 0;
+}
+
+void Scheduler::start(function<void()> init)
+{
+    stopRequested = false;
+    thread = std::thread([this, init]
+    {
+        if (init)
+        {
+            setProfileThreadName(name.c_str());
+            init();
+        }
+        run();
+    });
+}
+
+void Scheduler::stop()
+{
+    {
+        lock_guard<mutex> lock(wakeLock);
+        stopRequested = true;
+    }
+    wakeup.notify_all();
+    if (thread.joinable())
+        thread.join();
+}
+
+vector<TaskStats> Scheduler::getStats() const
+{
+    lock_guard<mutex> lock(statsLock);
+    int64_t elapsed = max<int64_t>(getSchedulerTimeUs() - startUs, 1);
+    vector<TaskStats> stats;
+    for (const auto& task : tasks)
+    {
+        TaskStats s;
+        s.name = task.name;
+        s.periodMs = int(task.periodUs / 1000);
+        s.runs = task.runs;
+        s.missed = task.missed;
+        s.latenessP50 = task.lateness.quantile(0.5f);
+        s.latenessP99 = task.lateness.quantile(0.99f);
+        s.latenessMax = task.latenessMax;
+        s.busyPercent = task.busyUs * 100.0f / elapsed;
+        stats.emplace_back(s);
+    }
+    return stats;
+}
+
+void Scheduler::resetStats()
+{
+    lock_guard<mutex> lock(statsLock);
+    startUs = getSchedulerTimeUs();
+    for (auto& task : tasks)
+    {
+        task.runs = 0;
+        task.missed = 0;
+        task.busyUs = 0;
+        task.latenessMax = 0;
+        task.lateness.reset();
+    }
+}
+
+void Scheduler::printStats() const
+{
+    printf("%-16s %8s %8s %8s %8s %8s %8s %6s\n", "task", "period", "runs", "missed", "p50 ms", "p99 ms", "max ms", "busy");
+    for (const auto& s : getStats())
+    {
+        printf("%-16s %6dms %8lld %8lld %8.2f %8.2f %8.2f %5.1f%%\n",
+            s.name.c_str(), s.periodMs, (long long)s.runs, (long long)s.missed, s.latenessP50, s.latenessP99, s.latenessMax, s.busyPercent);
+    }
+}
+
+void Scheduler::drawStatsImgui()
+{
+    if (!ImGui::CollapsingHeader(name.c_str()))
+        return;
+    ImGui::PushID(this);
+
+    if (ImGui::BeginTable("tasks", 8, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+    {
+        const char* headers[] = { "task", "period", "runs", "missed", "late p50", "late p99", "late max", "busy" };
+        for (auto header : headers)
+            ImGui::TableSetupColumn(header);
+        ImGui::TableHeadersRow();
+        for (const auto& s : getStats())
+        {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn(); ImGui::Text("%s", s.name.c_str());
+            ImGui::TableNextColumn(); ImGui::Text("%d ms", s.periodMs);
+            ImGui::TableNextColumn(); ImGui::Text("%lld", (long long)s.runs);
+            ImGui::TableNextColumn(); ImGui::Text("%lld", (long long)s.missed);
+            ImGui::TableNextColumn(); ImGui::Text("%.2f ms", s.latenessP50);
+            ImGui::TableNextColumn(); ImGui::Text("%.2f ms", s.latenessP99);
+            ImGui::TableNextColumn(); ImGui::Text("%.2f ms", s.latenessMax);
+            ImGui::TableNextColumn(); ImGui::Text("%.1f%%", s.busyPercent);
+        }
+        ImGui::EndTable();
+    }
+    if (ImGui::Button("Reset timing"))
+        resetStats();
+    ImGui::PopID();
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <vector>
+#include "quantile_sketch.h"
+
+// Microseconds from a monotonic clock, the time base of the scheduler.
+int64_t getSchedulerTimeUs();
+
+// Measured timing of one task, copied out for the UI.
+struct TaskStats
+{
+    std::string name;
+    int periodMs = 0;
+    int64_t runs = 0;
+    int64_t missed = 0;         // deadlines skipped because a run started more than a period late
+    float latenessP50 = 0;      // ms between the deadline and the actual start
+    float latenessP99 = 0;
+    float latenessMax = 0;
+    float busyPercent = 0;      // share of the period spent running
+};
+
+// Periodic task driven by absolute deadlines: run n is due at start + n * period, so neither
+// the time a run takes nor how late it starts accumulates into drift.
+struct ScheduledTask
+{
+    std::string name;
+    int64_t periodUs = 0;
+    std::function<int()> fn;
+    int64_t deadlineUs = 0;
+    int zone = 0;               // self profiling zone of the runs
+
+    int64_t runs = 0;
+    int64_t missed = 0;
+    int64_t busyUs = 0;
+    float latenessMax = 0;
+    QuantileSketch lateness;
+};
+
+// Runs a handful of periodic tasks on one thread, sleeping until the earliest deadline.
+// A linear scan beats a heap or a timer wheel at this size.
+// Either run() it on the calling thread or start() it on a thread of its own.
+struct Scheduler
+{
+    std::string name;
+    std::vector<ScheduledTask> tasks;
+    int64_t startUs = 0;
+    mutable std::mutex statsLock;
+
+    std::thread thread;
+    std::atomic<bool> stopRequested{ false };
+    std::mutex wakeLock;
+    std::condition_variable wakeup;
+
+    Scheduler(const char* name) : name(name) {}
+
+    // fn returning non-zero stops run(), tasks have to be added before run() or start()
+    void add(const char* name, int periodMs, std::function<int()> fn);
+
+    // Runs every task that is due, then sleeps until the next deadline or stop().
+    // Returns the first non-zero task result.
+    int runOnce();
+
+    // Runs the tasks until one of them returns non-zero or stop() is called.
+    int run();
+    // init runs first on the new thread, for the setup of a source too slow to hold up the others,
+    // the deadline grids are anchored once it returned
+    void start(std::function<void()> init = nullptr);
+    void stop();
+
+    std::vector<TaskStats> getStats() const;
+    void resetStats();
+    void printStats() const;
+    void drawStatsImgui();
+};
@@ -1,3 +1,3 @@
-#pragma once
-
-void gdiscreen();
+#pragma once
+
+void gdiscreen();
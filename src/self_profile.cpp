@@ -0,0 +1,306 @@
+#include "self_profile.h"
+#include <math.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include "../3rdparty/imgui/imgui.h"
+
+using namespace std;
+
+namespace
+{
+    const int kMaxZones = 64;
+    const int kRingSize = 4096;
+    // 4 buckets per power of two of the duration in ns, about 19% wide
+    const int kBucketsPerOctave = 4;
+    const int kBucketCount = 40 * kBucketsPerOctave;
+
+    // events are written by the owning thread only and read by the drain
+    struct ZoneEvent
+    {
+        atomic<int64_t> start;
+        atomic<int64_t> packed;     // duration << 16 | zone
+    };
+
+    struct ThreadProfile
+    {
+        string name;
+        ZoneEvent ring[kRingSize];
+        atomic<int64_t> head{ 0 };
+        int64_t tail = 0;           // owned by the drain
+        atomic<bool> isExited{ false };
+    };
+
+    struct ZoneHistogram
+    {
+        int64_t calls = 0;
+        int64_t totalNs = 0;
+        int64_t maxNs = 0;
+        uint32_t buckets[kBucketCount] = {};
+
+        void add(int64_t ns);
+        float quantileUs(float q) const;
+    };
+
+    mutex profileLock;
+    vector<string> zoneNames;
+    vector<unique_ptr<ThreadProfile>> threads;
+    // [thread][zone], only touched by the drain and the readers, under profileLock
+    vector<vector<ZoneHistogram>> sessionStats;
+    vector<vector<ZoneHistogram>> intervalStats;
+    int64_t droppedEvents = 0;
+    int64_t startNs = getProfileTimeNs();
+    int64_t lastDrainNs = 0;
+    int64_t drainedEvents = 0;
+    float zoneCostNs = -1;
+
+    // the profile of the calling thread, handed back when the thread exits
+    struct CurrentThread
+    {
+        ThreadProfile* profile = nullptr;
+        ~CurrentThread()
+        {
+            if (profile)
+                profile->isExited = true;
+        }
+    };
+    thread_local CurrentThread currentThread;
+
+    int getBucket(int64_t ns)
+    {
+        if (ns < 1)
+            return 0;
+        int msb = 63;
+        while (!(ns >> msb)) msb--;
+        // the two bits below the msb pick the quarter of the octave
+        int fraction = msb >= 2 ? int((ns >> (msb - 2)) & 3) : 0;
+        return min(msb * kBucketsPerOctave + fraction, kBucketCount - 1);
+    }
+
+    float getBucketMidNs(int bucket)
+    {
+        int msb = bucket / kBucketsPerOctave;
+        int fraction = bucket % kBucketsPerOctave;
+        return ldexpf(1.0f + (fraction + 0.5f) / kBucketsPerOctave, msb);
+    }
+
+    void ZoneHistogram::add(int64_t ns)
+    {
+        calls++;
+        totalNs += ns;
+        maxNs = max(maxNs, ns);
+        buckets[getBucket(ns)]++;
+    }
+
+    float ZoneHistogram::quantileUs(float q) const
+    {
+        if (calls == 0)
+            return 0;
+        int64_t rank = int64_t(q * (calls - 1));
+        int64_t seen = 0;
+        for (int i = 0; i < kBucketCount; i++)
+        {
+            seen += buckets[i];
+            if (seen > rank)
+                return min(getBucketMidNs(i), (float)maxNs) * 1e-3f;
+        }
+        return maxNs * 1e-3f;
+    }
+
+    // The collectors and the workers are started again on every NVML restart, a new thread takes
+    // over the profile of an exited one of the same name once the drain emptied it, with its stats.
+    // Under profileLock.
+    ThreadProfile* takeThreadProfile(const char* name)
+    {
+        for (auto& profile : threads)
+        {
+            if (name && profile->isExited && profile->name == name && profile->tail == profile->head.load(memory_order_acquire))
+            {
+                profile->isExited = false;
+                return profile.get();
+            }
+        }
+        threads.emplace_back(make_unique<ThreadProfile>());
+        auto profile = threads.back().get();
+        profile->name = name ? name : "thread " + to_string(threads.size());
+        return profile;
+    }
+
+    ThreadProfile* getThreadProfile()
+    {
+        if (!currentThread.profile)
+        {
+            lock_guard<mutex> lock(profileLock);
+            currentThread.profile = takeThreadProfile(nullptr);
+        }
+        return currentThread.profile;
+    }
+
+    vector<ZoneStats> collectStats(const vector<vector<ZoneHistogram>>& stats)
+    {
+        vector<ZoneStats> result;
+        for (size_t t = 0; t < stats.size(); t++)
+        {
+            for (size_t z = 0; z < stats[t].size(); z++)
+            {
+                const auto& h = stats[t][z];
+                if (h.calls == 0)
+                    continue;
+                ZoneStats s;
+                s.thread = threads[t]->name;
+                s.zone = zoneNames[z];
+                s.calls = h.calls;
+                s.totalNs = h.totalNs;
+                s.maxNs = h.maxNs;
+                s.p50Us = h.quantileUs(0.5f);
+                s.p99Us = h.quantileUs(0.99f);
+                result.emplace_back(s);
+            }
+        }
+        return result;
+    }
+
+    // cost of an empty zone, measured once on the drain thread
+    float measureZoneCost()
+    {
+        const int kCount = 10000;
+        static const int zone = registerProfileZone("(empty zone)");
+        ThreadProfile* profile = getThreadProfile();
+        int64_t begin = getProfileTimeNs();
+        for (int i = 0; i < kCount; i++)
+        {
+            ProfileScope scope(zone);
+        }
+        float cost = float(getProfileTimeNs() - begin) / kCount;
+        // the calibration events are not worth keeping
+        profile->tail = profile->head;
+        return cost;
+    }
+}
+
+int64_t getProfileTimeNs()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+int registerProfileZone(const char* name)
+{
+    lock_guard<mutex> lock(profileLock);
+    if ((int)zoneNames.size() >= kMaxZones)
+        return kMaxZones - 1;
+    zoneNames.push_back(name);
+    return (int)zoneNames.size() - 1;
+}
+
+void setProfileThreadName(const char* name)
+{
+    lock_guard<mutex> lock(profileLock);
+    if (!currentThread.profile)
+        currentThread.profile = takeThreadProfile(name);
+    else
+        currentThread.profile->name = name;
+}
+
+void pushProfileEvent(int zone, int64_t startNs, int64_t durationNs)
+{
+    auto profile = getThreadProfile();
+    int64_t head = profile->head.load(memory_order_relaxed);
+    auto& e = profile->ring[head % kRingSize];
+    e.start.store(startNs, memory_order_relaxed);
+    e.packed.store(durationNs << 16 | zone, memory_order_relaxed);
+    profile->head.store(head + 1, memory_order_release);
+}
+
+int self_profile_update()
+{
+    if (zoneCostNs < 0)
+        zoneCostNs = measureZoneCost();
+
+    lock_guard<mutex> lock(profileLock);
+    for (size_t t = 0; t < threads.size(); t++)
+    {
+        auto& profile = *threads[t];
+        if (sessionStats.size() <= t)
+        {
+            sessionStats.resize(t + 1);
+            intervalStats.resize(t + 1);
+        }
+        sessionStats[t].resize(kMaxZones);
+        intervalStats[t].resize(kMaxZones);
+
+        int64_t head = profile.head.load(memory_order_acquire);
+        if (head - profile.tail > kRingSize)
+        {
+            droppedEvents += head - profile.tail - kRingSize;
+            profile.tail = head - kRingSize;
+        }
+        for (; profile.tail < head; profile.tail++)
+        {
+            int64_t packed = profile.ring[profile.tail % kRingSize].packed.load(memory_order_relaxed);
+            int zone = int(packed & 0xFFFF);
+            int64_t ns = packed >> 16;
+            sessionStats[t][zone].add(ns);
+            intervalStats[t][zone].add(ns);
+            drainedEvents++;
+        }
+    }
+    lastDrainNs = getProfileTimeNs();
+
+    return 0;
+}
+
+vector<ZoneStats> getZoneStats()
+{
+    lock_guard<mutex> lock(profileLock);
+    return collectStats(sessionStats);
+}
+
+vector<ZoneStats> getIntervalZoneStats()
+{
+    lock_guard<mutex> lock(profileLock);
+    auto result = collectStats(intervalStats);
+    for (auto& zones : intervalStats)
+        zones.assign(zones.size(), ZoneHistogram());
+    return result;
+}
+
+int self_profile_draw_imgui()
+{
+    if (!ImGui::CollapsingHeader("Profiler overhead"))
+        return 0;
+
+    auto stats = getZoneStats();
+    float seconds = max((getProfileTimeNs() - startNs) * 1e-9f, 1e-3f);
+    {
+        lock_guard<mutex> lock(profileLock);
+        ImGui::Text("%.0f ns per zone, %.0f zones/s, %lld dropped",
+            zoneCostNs, drainedEvents / seconds, (long long)droppedEvents);
+    }
+
+    if (ImGui::BeginTable("zones", 8, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+    {
+        const char* headers[] = { "thread", "zone", "calls/s", "mean", "p50", "p99", "max", "core" };
+        for (auto header : headers)
+            ImGui::TableSetupColumn(header);
+        ImGui::TableHeadersRow();
+        for (const auto& s : stats)
+        {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn(); ImGui::Text("%s", s.thread.c_str());
+            ImGui::TableNextColumn(); ImGui::Text("%s", s.zone.c_str());
+            ImGui::TableNextColumn(); ImGui::Text("%.1f", s.calls / seconds);
+            ImGui::TableNextColumn(); ImGui::Text("%.1f us", s.totalNs * 1e-3f / s.calls);
+            ImGui::TableNextColumn(); ImGui::Text("%.1f us", s.p50Us);
+            ImGui::TableNextColumn(); ImGui::Text("%.1f us", s.p99Us);
+            ImGui::TableNextColumn(); ImGui::Text("%.1f us", s.maxNs * 1e-3f);
+            // inclusive, nested zones are counted in their parents too
+            ImGui::TableNextColumn(); ImGui::Text("%.2f%%", s.totalNs * 1e-7f / seconds);
+        }
+        ImGui::EndTable();
+    }
+
+    return 0;
+}
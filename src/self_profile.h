@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Scoped zones timing gpuprof's own hot paths.
+// Each thread appends (zone, start, duration) events to a ring of its own, the recorder thread
+// drains the rings into per zone histograms so the instrumented code never takes a lock.
+//
+//     void nvidia_update()
+//     {
+//         PROFILE_ZONE("nvidia_update");
+//         ...
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name) \
+    static const int PROFILE_CONCAT(profileZone_, __LINE__) = registerProfileZone(name); \
+    ProfileScope PROFILE_CONCAT(profileScope_, __LINE__)(PROFILE_CONCAT(profileZone_, __LINE__))
+
+int64_t getProfileTimeNs();
+int registerProfileZone(const char* name);
+// shown next to the zones of the calling thread, a thread restarted under the same name
+// carries on with the ring and the stats of the exited one
+void setProfileThreadName(const char* name);
+void pushProfileEvent(int zone, int64_t startNs, int64_t durationNs);
+
+struct ProfileScope
+{
+    int zone;
+    int64_t start;
+
+    ProfileScope(int zone) : zone(zone), start(getProfileTimeNs()) {}
+    ~ProfileScope() { pushProfileEvent(zone, start, getProfileTimeNs() - start); }
+};
+
+// Aggregate of one zone on one thread.
+struct ZoneStats
+{
+    std::string thread;
+    std::string zone;
+    int64_t calls = 0;
+    int64_t totalNs = 0;
+    int64_t maxNs = 0;
+    float p50Us = 0;
+    float p99Us = 0;
+};
+
+// Drains the rings of every thread, called periodically from one thread.
+int self_profile_update();
+// Since the start, or since the previous call for getIntervalZoneStats().
+std::vector<ZoneStats> getZoneStats();
+std::vector<ZoneStats> getIntervalZoneStats();
+int self_profile_draw_imgui();
@@ -0,0 +1,225 @@
+#include "series_block.h"
+#include <string.h>
+
+namespace
+{
+    uint32_t floatBits(float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    float bitsFloat(uint32_t bits)
+    {
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    int countLeadingZeros(uint32_t x)
+    {
+        int n = 0;
+        for (uint32_t mask = 0x80000000u; mask && !(x & mask); mask >>= 1) n++;
+        return n;
+    }
+
+    int countTrailingZeros(uint32_t x)
+    {
+        int n = 0;
+        for (uint32_t mask = 1u; mask && !(x & mask); mask <<= 1) n++;
+        return n;
+    }
+
+    int64_t signExtend(uint64_t bits, int n)
+    {
+        uint64_t sign = 1ull << (n - 1);
+        return (int64_t)((bits ^ sign) - sign);
+    }
+}
+
+int64_t CompressedHistory::retentionMs = 8 * 60 * 60 * 1000ll;
+
+void SeriesBlock::writeBits(uint64_t bits, int n)
+{
+    while (n > 0)
+    {
+        int word = bitCount / 64;
+        int offset = bitCount % 64;
+        if (word == (int)words.size())
+            words.push_back(0);
+        int count = n < 64 - offset ? n : 64 - offset;
+        uint64_t chunk = (bits >> (n - count)) & (count == 64 ? ~0ull : ((1ull << count) - 1));
+        words[word] |= chunk << (64 - offset - count);
+        bitCount += count;
+        n -= count;
+    }
+}
+
+bool SeriesBlock::append(int64_t timeMs, float value)
+{
+    if (full())
+        return false;
+
+    uint32_t bits = floatBits(value);
+    if (sampleCount == 0)
+    {
+        words.reserve(BLOCK_BYTES / 8);
+        firstTime = lastTime = timeMs;
+        writeBits(bits, 32);
+        prevValue = bits;
+        sampleCount = 1;
+        return true;
+    }
+
+    // timestamp, delta of delta, each bucket holds the two's complement range of its width
+    int64_t delta = timeMs - lastTime;
+    int64_t dod = delta - prevDelta;
+    if (dod == 0)
+        writeBits(0, 1);
+    else if (dod >= -64 && dod <= 63)
+    {
+        writeBits(0x2, 2);
+        writeBits((uint64_t)dod, 7);
+    }
+    else if (dod >= -256 && dod <= 255)
+    {
+        writeBits(0x6, 3);
+        writeBits((uint64_t)dod, 9);
+    }
+    else if (dod >= -2048 && dod <= 2047)
+    {
+        writeBits(0xE, 4);
+        writeBits((uint64_t)dod, 12);
+    }
+    else
+    {
+        writeBits(0xF, 4);
+        writeBits((uint64_t)dod, 32);
+    }
+    prevDelta = delta;
+    lastTime = timeMs;
+
+    // value, xor against the previous one
+    uint32_t x = bits ^ prevValue;
+    if (x == 0)
+    {
+        writeBits(0, 1);
+    }
+    else
+    {
+        int leading = countLeadingZeros(x);
+        int trailing = countTrailingZeros(x);
+        if (prevLeading >= 0 && leading >= prevLeading && trailing >= prevTrailing)
+        {
+            // fits in the previous meaningful window
+            writeBits(0x2, 2);
+            writeBits(x >> prevTrailing, 32 - prevLeading - prevTrailing);
+        }
+        else
+        {
+            int length = 32 - leading - trailing;
+            writeBits(0x3, 2);
+            writeBits(leading, 5);
+            writeBits(length - 1, 5);
+            writeBits(x >> trailing, length);
+            prevLeading = leading;
+            prevTrailing = trailing;
+        }
+    }
+    prevValue = bits;
+    sampleCount++;
+
+    return true;
+}
+
+uint64_t BlockDecoder::readBits(int n)
+{
+    uint64_t result = 0;
+    while (n > 0)
+    {
+        int word = bitPos / 64;
+        int offset = bitPos % 64;
+        int count = n < 64 - offset ? n : 64 - offset;
+        uint64_t chunk = block.words[word] >> (64 - offset - count);
+        if (count < 64)
+            chunk &= (1ull << count) - 1;
+        result = count == 64 ? chunk : (result << count) | chunk;
+        bitPos += count;
+        n -= count;
+    }
+    return result;
+}
+
+bool BlockDecoder::next(int64_t* timeMs, float* valueOut)
+{
+    if (index >= block.sampleCount)
+        return false;
+
+    if (index == 0)
+    {
+        time = block.firstTime;
+        value = (uint32_t)readBits(32);
+    }
+    else
+    {
+        int64_t dod = 0;
+        if (readBits(1) == 0)
+            dod = 0;
+        else if (readBits(1) == 0)
+            dod = signExtend(readBits(7), 7);
+        else if (readBits(1) == 0)
+            dod = signExtend(readBits(9), 9);
+        else if (readBits(1) == 0)
+            dod = signExtend(readBits(12), 12);
+        else
+            dod = signExtend(readBits(32), 32);
+        delta += dod;
+        time += delta;
+
+        if (readBits(1) == 1)
+        {
+            if (readBits(1) == 1)
+            {
+                leading = (int)readBits(5);
+                int length = (int)readBits(5) + 1;
+                trailing = 32 - leading - length;
+            }
+            uint32_t x = (uint32_t)readBits(32 - leading - trailing) << trailing;
+            value ^= x;
+        }
+    }
+
+    index++;
+    *timeMs = time;
+    *valueOut = bitsFloat(value);
+    return true;
+}
+
+void CompressedHistory::append(int64_t timeMs, float value)
+{
+    if (!open.append(timeMs, value))
+    {
+        sealedBytes += open.bytes();
+        sealedSamples += open.sampleCount;
+        sealed.emplace_back(std::move(open));
+        open = SeriesBlock();
+        open.append(timeMs, value);
+
+        // drop the blocks that fell out of the retention window
+        while (!sealed.empty() && sealed.front().lastTime < timeMs - retentionMs)
+        {
+            sealedBytes -= sealed.front().bytes();
+            sealedSamples -= sealed.front().sampleCount;
+            sealed.pop_front();
+        }
+    }
+}
+
+void CompressedHistory::reset()
+{
+    sealed.clear();
+    open = SeriesBlock();
+    sealedBytes = 0;
+    sealedSamples = 0;
+}
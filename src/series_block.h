@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+#include <vector>
+
+// Gorilla style compressed samples: timestamps are stored as delta-of-delta and values
+// as the XOR against the previous value, both with variable length bit codes.
+// A block is sealed once it reaches BLOCK_BYTES and is immutable from then on.
+struct SeriesBlock
+{
+    static const int BLOCK_BYTES = 1024;
+    // worst case encoding of one sample, 4 + 32 bits of time and 2 + 5 + 5 + 32 bits of value
+    static const int MAX_SAMPLE_BITS = 80;
+
+    std::vector<uint64_t> words;
+    int bitCount = 0;
+    int sampleCount = 0;
+    int64_t firstTime = 0;
+    int64_t lastTime = 0;
+
+    // encoder state
+    int64_t prevDelta = 0;
+    uint32_t prevValue = 0;
+    int prevLeading = -1;
+    int prevTrailing = 0;
+
+    // false when the block is full and has to be sealed
+    bool append(int64_t timeMs, float value);
+    bool full() const { return bitCount + MAX_SAMPLE_BITS > BLOCK_BYTES * 8; }
+    size_t bytes() const { return (bitCount + 7) / 8; }
+
+    void writeBits(uint64_t bits, int n);
+};
+
+// Streams the samples of one block back, in order.
+struct BlockDecoder
+{
+    const SeriesBlock& block;
+    int bitPos = 0;
+    int index = 0;
+    int64_t time = 0;
+    int64_t delta = 0;
+    uint32_t value = 0;
+    int leading = 0;
+    int trailing = 0;
+
+    BlockDecoder(const SeriesBlock& block) : block(block) {}
+
+    bool next(int64_t* timeMs, float* value);
+    uint64_t readBits(int n);
+};
+
+// Sealed blocks of the last retentionMs milliseconds plus the open one.
+struct CompressedHistory
+{
+    static int64_t retentionMs;
+
+    std::deque<SeriesBlock> sealed;
+    SeriesBlock open;
+    size_t sealedBytes = 0;
+    size_t sealedSamples = 0;
+
+    void append(int64_t timeMs, float value);
+    void reset();
+
+    size_t sampleCount() const { return sealedSamples + open.sampleCount; }
+    size_t bytes() const { return sealedBytes + open.bytes(); }
+
+    // Calls fn(timeMs, value) for every sample in [beginMs, endMs], oldest first.
+    template <typename Fn>
+    void forEach(int64_t beginMs, int64_t endMs, Fn fn) const
+    {
+        auto visit = [&](const SeriesBlock& block)
+        {
+            if (block.sampleCount == 0 || block.lastTime < beginMs || block.firstTime > endMs)
+                return;
+            BlockDecoder decoder(block);
+            int64_t t;
+            float v;
+            while (decoder.next(&t, &v))
+            {
+                if (t > endMs) break;
+                if (t >= beginMs) fn(t, v);
+            }
+        };
+        for (const auto& block : sealed)
+            visit(block);
+        visit(open);
+    }
+};
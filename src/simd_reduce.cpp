@@ -0,0 +1,206 @@
+#include "simd_reduce.h"
+#include <math.h>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_REDUCE_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SIMD_TARGET_AVX2
+#else
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+namespace
+{
+    // lanes accumulate in float for this many samples before being flushed to double
+    const size_t kBlockSize = 1024;
+
+    typedef SpanStats (*ReduceFn)(const float*, size_t);
+
+#ifdef SIMD_REDUCE_X86
+    SpanStats reduceSse2(const float* values, size_t count)
+    {
+        SpanStats stats;
+        if (count == 0)
+            return stats;
+
+        __m128 vmin = _mm_set1_ps(values[0]);
+        __m128 vmax = vmin;
+        size_t i = 0;
+        while (i + 4 <= count)
+        {
+            size_t end = std::min(count & ~size_t(3), i + kBlockSize);
+            __m128 vsum = _mm_setzero_ps();
+            __m128 vsq = _mm_setzero_ps();
+            for (; i < end; i += 4)
+            {
+                __m128 v = _mm_loadu_ps(values + i);
+                vmin = _mm_min_ps(vmin, v);
+                vmax = _mm_max_ps(vmax, v);
+                vsum = _mm_add_ps(vsum, v);
+                vsq = _mm_add_ps(vsq, _mm_mul_ps(v, v));
+            }
+            alignas(16) float lanes[4];
+            _mm_store_ps(lanes, vsum);
+            stats.sum += (double)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+            _mm_store_ps(lanes, vsq);
+            stats.sumSq += (double)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        }
+
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, vmin);
+        stats.min = std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+        _mm_store_ps(lanes, vmax);
+        stats.max = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+        stats.count = i;
+
+        stats.merge(reduceSpanScalar(values + i, count - i));
+        return stats;
+    }
+
+    SIMD_TARGET_AVX2 SpanStats reduceAvx2(const float* values, size_t count)
+    {
+        SpanStats stats;
+        if (count == 0)
+            return stats;
+
+        __m256 vmin = _mm256_set1_ps(values[0]);
+        __m256 vmax = vmin;
+        size_t i = 0;
+        while (i + 8 <= count)
+        {
+            size_t end = std::min(count & ~size_t(7), i + kBlockSize);
+            __m256 vsum = _mm256_setzero_ps();
+            __m256 vsq = _mm256_setzero_ps();
+            for (; i < end; i += 8)
+            {
+                __m256 v = _mm256_loadu_ps(values + i);
+                vmin = _mm256_min_ps(vmin, v);
+                vmax = _mm256_max_ps(vmax, v);
+                vsum = _mm256_add_ps(vsum, v);
+                vsq = _mm256_fmadd_ps(v, v, vsq);
+            }
+            alignas(32) float lanes[8];
+            _mm256_store_ps(lanes, vsum);
+            for (float lane : lanes) stats.sum += lane;
+            _mm256_store_ps(lanes, vsq);
+            for (float lane : lanes) stats.sumSq += lane;
+        }
+
+        alignas(32) float lanes[8];
+        _mm256_store_ps(lanes, vmin);
+        stats.min = *std::min_element(lanes, lanes + 8);
+        _mm256_store_ps(lanes, vmax);
+        stats.max = *std::max_element(lanes, lanes + 8);
+        stats.count = i;
+
+        stats.merge(reduceSpanScalar(values + i, count - i));
+        return stats;
+    }
+
+    bool isAvx2Supported()
+    {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        bool fma = (info[2] & (1 << 12)) != 0;
+        if (!osxsave || !avx || !fma)
+            return false;
+        // the OS has to save the ymm registers
+        if ((_xgetbv(0) & 0x6) != 0x6)
+            return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+    }
+#endif
+
+    const char* kernelName = "scalar";
+
+    ReduceFn selectKernel()
+    {
+#ifdef SIMD_REDUCE_X86
+        if (isAvx2Supported())
+        {
+            kernelName = "AVX2";
+            return reduceAvx2;
+        }
+        // SSE2 is part of x64
+        kernelName = "SSE2";
+        return reduceSse2;
+#else
+        return reduceSpanScalar;
+#endif
+    }
+
+    ReduceFn getKernel()
+    {
+        static ReduceFn kernel = selectKernel();
+        return kernel;
+    }
+}
+
+void SpanStats::merge(const SpanStats& other)
+{
+    if (other.count == 0)
+        return;
+    if (count == 0)
+    {
+        *this = other;
+        return;
+    }
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+    sum += other.sum;
+    sumSq += other.sumSq;
+    count += other.count;
+}
+
+float SpanStats::stddev() const
+{
+    if (count == 0)
+        return 0;
+    double m = sum / count;
+    double variance = sumSq / count - m * m;
+    return variance > 0 ? (float)sqrt(variance) : 0;
+}
+
+SpanStats reduceSpanScalar(const float* values, size_t count)
+{
+    SpanStats stats;
+    if (count == 0)
+        return stats;
+
+    stats.min = stats.max = values[0];
+    for (size_t i = 0; i < count; i++)
+    {
+        float v = values[i];
+        stats.min = std::min(stats.min, v);
+        stats.max = std::max(stats.max, v);
+        stats.sum += v;
+        stats.sumSq += (double)v * v;
+    }
+    stats.count = count;
+    return stats;
+}
+
+SpanStats reduceSpan(const float* values, size_t count)
+{
+    return getKernel()(values, count);
+}
+
+const char* getReduceKernelName()
+{
+    getKernel();
+    return kernelName;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stddef.h>
+
+// min / max / mean / stddev of a span of samples.
+struct SpanStats
+{
+    float min = 0;
+    float max = 0;
+    double sum = 0;
+    double sumSq = 0;
+    size_t count = 0;
+
+    void merge(const SpanStats& other);
+    float mean() const { return count > 0 ? float(sum / count) : 0; }
+    float stddev() const;
+};
+
+// Reduces values[0, count) with the widest kernel the CPU supports (AVX2, SSE2 or scalar),
+// picked once at the first call.
+SpanStats reduceSpan(const float* values, size_t count);
+SpanStats reduceSpanScalar(const float* values, size_t count);
+const char* getReduceKernelName();
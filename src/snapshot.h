@@ -0,0 +1,32 @@
+#pragma once
+
+#include <atomic>
+
+// Wait-free single producer / single consumer snapshot exchange (triple buffering).
+// The producer fills writeBuffer() and publish()es it, the consumer calls read()
+// and always gets the latest complete snapshot, neither side ever blocks or retries.
+template <typename T>
+struct SnapshotBuffer
+{
+    static const int INDEX_MASK = 0x3;
+    static const int DIRTY_BIT = 0x4;
+
+    T buffers[3];
+    int back = 0;                   // owned by the producer
+    std::atomic<int> middle{ 1 };   // index of the exchange buffer, DIRTY_BIT when it is newer than front
+    int front = 2;                  // owned by the consumer
+
+    T& writeBuffer() { return buffers[back]; }
+
+    void publish()
+    {
+        back = middle.exchange(back | DIRTY_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    const T& read()
+    {
+        if (middle.load(std::memory_order_relaxed) & DIRTY_BIT)
+            front = middle.exchange(front, std::memory_order_acq_rel) & INDEX_MASK;
+        return buffers[front];
+    }
+};
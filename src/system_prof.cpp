@@ -1,116 +1,200 @@
-#include "system_prof.h"
-#include "../3rdparty/PDH/CPdh.h"
-#include "../3rdparty/CImg.h"
-#include "metrics_info.h"
-using namespace cimg_library;
-using namespace std;
-
-// TODO
-extern vector<shared_ptr<CImgDisplay>> windows;
-extern bool isCimgVisible;
-
-namespace
-{
-    CPDH pdh;
-
-    MetricsInfo metrics;
-    shared_ptr<CImgDisplay> window;
-
-    // TODO: refactor
-
-    /// Add Counter ///
-    int nIdx_CpuUsage = -1;
-    int nIdx_MemUsage = -1;
-    int nIdx_DiskRead = -1;
-    int nIdx_DiskWrite = -1;
-    int nIdx_NetRead = -1;
-    int nIdx_NetWrite = -1;
-    int nIdx_NetBandwidth = -1;
-    double dCpu = 0;
-    double dMem = 0;
-    double diskRead = 0;
-    double diskWrite = 0;
-
-    double netRead = 0;
-    double netWrite = 0;
-    double netBandwidth = 0;
-
-};
-
-int system_setup()
-{
-
-    pdh.AddCounter(df_PDH_CPUUSAGE_TOTAL, nIdx_CpuUsage);
-    pdh.AddCounter(df_PDH_MEMINUSE_PERCENT, nIdx_MemUsage);
-    pdh.AddCounter(df_PDH_DISK_READ_TOTAL, nIdx_DiskRead);
-    pdh.AddCounter(df_PDH_DISK_WRITE_TOTAL, nIdx_DiskWrite);
-
-    pdh.AddCounter(df_PDH_ETHERNETRECV_BYTES, nIdx_NetRead);
-    pdh.AddCounter(df_PDH_ETHERNETSEND_BYTES, nIdx_NetWrite);
-    pdh.AddCounter(df_PDH_ETHERNET_BANDWIDTH, nIdx_NetBandwidth);
-
-
-    if (isCimgVisible)
-    {
-        window = make_shared<CImgDisplay>(WINDOW_W, WINDOW_H, "System", 3);
-        window->move(400, 100);
-        windows.push_back(window);
-    }
-
-    return 0;
-}
-
-int system_update()
-{
-    if (pdh.CollectQueryData())
-        return 1;
-
-    /// Update Counters ///
-    if (!pdh.GetCounterValue(nIdx_CpuUsage, &dCpu)) dCpu = 0;
-    if (!pdh.GetCounterValue(nIdx_MemUsage, &dMem)) dMem = 0;
-    if (!pdh.GetCounterValue(nIdx_DiskRead, &diskRead)) diskRead = 0;
-    if (!pdh.GetCounterValue(nIdx_DiskWrite, &diskWrite)) diskWrite = 0;
-
-    if (!pdh.GetCounterValue(nIdx_NetRead, &netRead)) netRead = 0;
-    if (!pdh.GetCounterValue(nIdx_NetWrite, &netWrite)) netWrite = 0;
-    if (!pdh.GetCounterValue(nIdx_NetBandwidth, &netBandwidth)) netBandwidth = 0.0f;
-
-#if 0
-    double dMin = 0, dMax = 0, dMean = 0;
-    if (pdh.GetStatistics(&dMin, &dMax, &dMean, nIdx_CpuUsage))
-        wprintf(L" (Min %.1f / Max %.1f / Mean %.1f)", dMin, dMax, dMean);
-#endif
-    metrics.addMetric(METRIC_CPU_SOL, dCpu);
-    metrics.addMetric(METRIC_SYS_MEM_SOL, dMem);
-    metrics.addMetric(METRIC_DISK_READ_SOL, diskRead);
-    metrics.addMetric(METRIC_DISK_WRITE_SOL, diskWrite);
-
-	metrics.addMetric(METRIC_NET_READ_SOL, netRead * 800 / (netBandwidth + 0.1f));
-	metrics.addMetric(METRIC_NET_WRITE_SOL, netWrite * 800 / (netBandwidth + 0.1f));
-
-    return 0;
-}
-
-int system_draw(bool show_legends)
-{
-    CImg<unsigned char> img(window->width(), window->height(), 1, 3, 50);
-    img.draw_grid(-50 * 100.0f / window->width(), -50 * 100.0f / 256, 0, 0, false, true, colors[0], 0.2f, 0xCCCCCCCC, 0xCCCCCCCC);
-
-    metrics.draw(window, img, METRIC_CPU_SOL, METRIC_NET_WRITE_SOL, show_legends);
-
-    img.display(*window);
-    return 0;
-}
-
-int system_draw_imgui()
-{
-    metrics.drawImgui("System", METRIC_CPU_SOL, METRIC_NET_WRITE_SOL);
-
-    return 0;
-}
-
-int system_cleanup()
-{
-    return 0;
-}
-
+#include "system_prof.h"
+#include "../3rdparty/PDH/CPdh.h"
+#include "../3rdparty/CImg.h"
+#include "metrics_info.h"
+#include "self_profile.h"
+#include "scheduler.h"
+#include "watchdog.h"
+using namespace cimg_library;
+using namespace std;
+
+// TODO
+extern vector<shared_ptr<CImgDisplay>> windows;
+extern bool isCimgVisible;
+
+namespace
+{
+    CPDH pdh;
+
+    MetricsInfo metrics;
+    shared_ptr<CImgDisplay> window;
+
+    // TODO: refactor
+
+    /// Add Counter ///
+    int nIdx_CpuUsage = -1;
+    int nIdx_MemUsage = -1;
+    int nIdx_DiskRead = -1;
+    int nIdx_DiskWrite = -1;
+    int nIdx_NetRead = -1;
+    int nIdx_NetWrite = -1;
+    int nIdx_NetBandwidth = -1;
+    double dCpu = 0;
+    double dMem = 0;
+    double diskRead = 0;
+    double diskWrite = 0;
+
+    double netRead = 0;
+    double netWrite = 0;
+    double netBandwidth = 0;
+
+    MetricHandle cpuMetric = INVALID_METRIC;
+    MetricHandle memMetric = INVALID_METRIC;
+    MetricHandle diskReadMetric = INVALID_METRIC;
+    MetricHandle diskWriteMetric = INVALID_METRIC;
+    MetricHandle netReadMetric = INVALID_METRIC;
+    MetricHandle netWriteMetric = INVALID_METRIC;
+
+    // PdhCollectQueryData can hang like a driver call, it runs on a supervised worker and
+    // the panel shows a gap for as long as it doesn't come back
+    const int kPdhDeadlineMs = 500;
+    // a query stuck that long is opened again once it returns
+    const int64_t kPdhReopenMs = 10000;
+    SupervisedWorker pdhWorker;
+    // the counter values above and this are written by the worker, read once it's idle
+    int collectResult = 0;
+    // metric time of the call that didn't come back in time, 0 while PDH answers
+    int64_t stallStartMs = 0;
+
+    void addCounters()
+    {
+        pdh.AddCounter(df_PDH_CPUUSAGE_TOTAL, nIdx_CpuUsage);
+        pdh.AddCounter(df_PDH_MEMINUSE_PERCENT, nIdx_MemUsage);
+        pdh.AddCounter(df_PDH_DISK_READ_TOTAL, nIdx_DiskRead);
+        pdh.AddCounter(df_PDH_DISK_WRITE_TOTAL, nIdx_DiskWrite);
+
+        pdh.AddCounter(df_PDH_ETHERNETRECV_BYTES, nIdx_NetRead);
+        pdh.AddCounter(df_PDH_ETHERNETSEND_BYTES, nIdx_NetWrite);
+        pdh.AddCounter(df_PDH_ETHERNET_BANDWIDTH, nIdx_NetBandwidth);
+    }
+
+    int collect()
+    {
+        if (pdh.CollectQueryData())
+            return 1;
+
+        /// Update Counters ///
+        if (!pdh.GetCounterValue(nIdx_CpuUsage, &dCpu)) dCpu = 0;
+        if (!pdh.GetCounterValue(nIdx_MemUsage, &dMem)) dMem = 0;
+        if (!pdh.GetCounterValue(nIdx_DiskRead, &diskRead)) diskRead = 0;
+        if (!pdh.GetCounterValue(nIdx_DiskWrite, &diskWrite)) diskWrite = 0;
+
+        if (!pdh.GetCounterValue(nIdx_NetRead, &netRead)) netRead = 0;
+        if (!pdh.GetCounterValue(nIdx_NetWrite, &netWrite)) netWrite = 0;
+        if (!pdh.GetCounterValue(nIdx_NetBandwidth, &netBandwidth)) netBandwidth = 0.0f;
+        return 0;
+    }
+
+    // true once the worker is idle, the panel shows the gap meanwhile
+    bool superviseCollect(bool isSubmitted)
+    {
+        auto nowMs = getMetricTimeMs();
+        bool isIdle = isSubmitted ? pdhWorker.wait(getSchedulerTimeUs() + kPdhDeadlineMs * 1000) : !pdhWorker.isBusy();
+        if (!isIdle)
+        {
+            if (stallStartMs == 0)
+            {
+                stallStartMs = nowMs;
+                metrics.addEvent(nowMs, EVENT_CRITICAL, "PdhCollectQueryData not responding");
+                fprintf(stderr, "[system_update] - PdhCollectQueryData hasn't returned in %d ms\r\n", kPdhDeadlineMs);
+            }
+            metrics.addGap(stallStartMs, getMetricTimeMs());
+            metrics.publish();
+            return false;
+        }
+
+        if (stallStartMs != 0)
+        {
+            char text[64];
+            snprintf(text, sizeof(text), "responding again after %.1f s", (nowMs - stallStartMs) / 1000.0);
+            metrics.addGap(stallStartMs, nowMs);
+            metrics.addEvent(nowMs, EVENT_WARNING, text);
+            fprintf(stderr, "[system_update] - PdhCollectQueryData %s\r\n", text);
+            if (nowMs - stallStartMs > kPdhReopenMs)
+            {
+                pdh.Clean();
+                pdh.Init();
+                addCounters();
+            }
+            stallStartMs = 0;
+        }
+        return true;
+    }
+};
+
+int system_setup()
+{
+    addCounters();
+    pdhWorker.start("pdh worker");
+
+    cpuMetric = metrics.addSeries("system", -1, "CPU", "%");
+    memMetric = metrics.addSeries("system", -1, "RAM", "%");
+    diskReadMetric = metrics.addSeries("system", -1, "DISK R", "%");
+    diskWriteMetric = metrics.addSeries("system", -1, "DISK W", "%");
+    netReadMetric = metrics.addSeries("system", -1, "NET R", "%");
+    netWriteMetric = metrics.addSeries("system", -1, "NET W", "%");
+
+    if (isCimgVisible)
+    {
+        window = make_shared<CImgDisplay>(WINDOW_W, WINDOW_H, "System", 3);
+        window->move(400, 100);
+        windows.push_back(window);
+    }
+
+    return 0;
+}
+
+int system_update()
+{
+    // the call of an earlier tick that didn't come back in time, its reading is dropped
+    if (stallStartMs != 0 && !superviseCollect(false))
+        return 1;
+    pdhWorker.submit("PdhCollectQueryData", [] { collectResult = collect(); });
+    if (!superviseCollect(true) || collectResult)
+        return 1;
+
+#if 0
+    double dMin = 0, dMax = 0, dMean = 0;
+    if (pdh.GetStatistics(&dMin, &dMax, &dMean, nIdx_CpuUsage))
+        wprintf(L" (Min %.1f / Max %.1f / Mean %.1f)", dMin, dMax, dMean);
+#endif
+    metrics.addMetric(cpuMetric, dCpu);
+    metrics.addMetric(memMetric, dMem);
+    metrics.addMetric(diskReadMetric, diskRead);
+    metrics.addMetric(diskWriteMetric, diskWrite);
+
+	metrics.addMetric(netReadMetric, netRead * 800 / (netBandwidth + 0.1f));
+	metrics.addMetric(netWriteMetric, netWrite * 800 / (netBandwidth + 0.1f));
+
+    metrics.publish();
+
+    return 0;
+}
+
+int system_draw(bool show_legends)
+{
+    CImg<unsigned char> img(window->width(), window->height(), 1, 3, 50);
+    img.draw_grid(-50 * 100.0f / window->width(), -50 * 100.0f / 256, 0, 0, false, true, colors[0], 0.2f, 0xCCCCCCCC, 0xCCCCCCCC);
+
+    metrics.draw(window, img, 0, -1, show_legends);
+
+    {
+        PROFILE_ZONE("img.display");
+        img.display(*window);
+    }
+    return 0;
+}
+
+int system_draw_imgui()
+{
+    metrics.drawImgui("System", 0, -1);
+
+    return 0;
+}
+
+int system_cleanup()
+{
+    pdhWorker.stop(kPdhDeadlineMs);
+    return 0;
+}
+
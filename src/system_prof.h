@@ -1,7 +1,7 @@
-#pragma once
-
-int system_setup();
-int system_update();
-int system_draw(bool show_legends);
-int system_draw_imgui();
-int system_cleanup();
+#pragma once
+
+int system_setup();
+int system_update();
+int system_draw(bool show_legends);
+int system_draw_imgui();
+int system_cleanup();
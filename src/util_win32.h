@@ -1,8 +1,17 @@
-#pragma once
-
-#define NOMINMAX
-#include <Windows.h>
-#include <tlhelp32.h>
-
-void GoToXY(int column, int line);
-PROCESSENTRY32 getEntryFromPID(DWORD pid);
+#pragma once
+
+#define NOMINMAX
+#include <Windows.h>
+#include <tlhelp32.h>
+
+void GoToXY(int column, int line);
+
+// CPU time (user + kernel) and working set of the current process.
+struct ProcessUsage
+{
+    double cpuSeconds = 0;
+    double wallSeconds = 0;     // since the process started
+    size_t rssBytes = 0;
+    size_t peakRssBytes = 0;
+};
+ProcessUsage getProcessUsage();
@@ -0,0 +1,146 @@
+#include "watchdog.h"
+#include "scheduler.h"
+#include "self_profile.h"
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+using namespace std;
+
+struct SupervisedWorker::State
+{
+    mutex lock;
+    condition_variable wake;
+    condition_variable done;
+    function<void()> job;
+    const char* name = nullptr;
+    atomic<const char*> step{ nullptr };
+    int64_t startUs = 0;
+    bool isBusy = false;
+    bool quit = false;
+};
+
+namespace
+{
+    // the worker the current thread belongs to, for setWatchdogStep()
+    thread_local SupervisedWorker::State* currentState = nullptr;
+}
+
+void SupervisedWorker::start(const char* name)
+{
+    state = make_shared<State>();
+    string threadName = name;
+    // the thread only holds on to the state, never to this
+    auto s = state;
+    thread = std::thread([s, threadName]
+    {
+        setProfileThreadName(threadName.c_str());
+        currentState = s.get();
+        unique_lock<mutex> guard(s->lock);
+        while (true)
+        {
+            s->wake.wait(guard, [&] { return s->quit || s->job; });
+            if (!s->job)
+                return;
+            auto job = move(s->job);
+            s->job = nullptr;
+            guard.unlock();
+
+            job();
+
+            guard.lock();
+            s->step = nullptr;
+            s->isBusy = false;
+            s->done.notify_all();
+        }
+    });
+}
+
+bool SupervisedWorker::stop(int timeoutMs)
+{
+    if (!state)
+        return true;
+    bool isIdle;
+    {
+        unique_lock<mutex> guard(state->lock);
+        state->quit = true;
+        // a call that didn't start yet is dropped, nothing runs then and the waiters can go
+        if (state->job)
+        {
+            state->job = nullptr;
+            state->isBusy = false;
+            state->done.notify_all();
+        }
+        state->wake.notify_one();
+        isIdle = state->done.wait_for(guard, chrono::milliseconds(timeoutMs), [this] { return !state->isBusy; });
+    }
+    if (isIdle)
+    {
+        thread.join();
+    }
+    else
+    {
+        fprintf(stderr, "[SupervisedWorker::stop] - %s still hasn't returned, left behind\r\n", state->name);
+        thread.detach();
+    }
+    state.reset();
+    return isIdle;
+}
+
+bool SupervisedWorker::submit(const char* name, function<void()> fn)
+{
+    if (!state)
+        return false;
+    {
+        lock_guard<mutex> guard(state->lock);
+        if (state->isBusy)
+            return false;
+        state->job = move(fn);
+        state->name = name;
+        state->step = nullptr;
+        state->startUs = getSchedulerTimeUs();
+        state->isBusy = true;
+    }
+    state->wake.notify_one();
+    return true;
+}
+
+bool SupervisedWorker::wait(int64_t deadlineUs)
+{
+    if (!state)
+        return true;
+    unique_lock<mutex> guard(state->lock);
+    auto timeout = chrono::microseconds(max<int64_t>(deadlineUs - getSchedulerTimeUs(), 0));
+    return state->done.wait_for(guard, timeout, [this] { return !state->isBusy; });
+}
+
+bool SupervisedWorker::isBusy() const
+{
+    if (!state)
+        return false;
+    lock_guard<mutex> guard(state->lock);
+    return state->isBusy;
+}
+
+bool SupervisedWorker::getRunning(const char** name, const char** step, int64_t* elapsedUs) const
+{
+    if (!state)
+        return false;
+    lock_guard<mutex> guard(state->lock);
+    if (!state->isBusy)
+        return false;
+    *name = state->name;
+    *step = state->step;
+    *elapsedUs = getSchedulerTimeUs() - state->startUs;
+    return true;
+}
+
+void setWatchdogStep(const char* step)
+{
+    if (currentState)
+        currentState->step = step;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+#include <functional>
+#include <memory>
+#include <thread>
+
+// Runs the calls of one backend on a thread of its own so the caller can stop waiting for them.
+// A call past its deadline is left to finish, the worker stays busy and refuses new calls
+// until it does, so a hung driver holds up its own backend only.
+struct SupervisedWorker
+{
+    // shared with the thread, outlives the worker when stop() gives up on a hung call
+    struct State;
+    std::shared_ptr<State> state;
+    std::thread thread;
+
+    SupervisedWorker() = default;
+    SupervisedWorker(SupervisedWorker&&) = default;
+    ~SupervisedWorker() { stop(0); }
+
+    void start(const char* name);
+    // Joins the thread, a call still running after timeoutMs is given up on and the thread detached.
+    // False when it had to give up.
+    bool stop(int timeoutMs);
+
+    // false while the previous call is still running
+    bool submit(const char* name, std::function<void()> fn);
+    // waits for the submitted call until deadlineUs, on the getSchedulerTimeUs() clock,
+    // true once the worker is idle
+    bool wait(int64_t deadlineUs);
+    bool isBusy() const;
+
+    // the running call, and its current step when it called setWatchdogStep(), false when idle
+    bool getRunning(const char** name, const char** step, int64_t* elapsedUs) const;
+};
+
+// Tells the supervisor what the calling worker is blocked in, e.g. the NVML entry point,
+// null once it returned. Ignored on any other thread.
+void setWatchdogStep(const char* step);
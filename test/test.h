@@ -0,0 +1,49 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+// A handful of self registering checks, run by test_main.cpp. No framework, the tree
+// builds with nothing but the compiler.
+typedef void (*TestFn)();
+int registerTest(const char* name, TestFn fn);
+void reportFailure(const char* file, int line, const char* expression);
+
+#define TEST(name) \
+    static void name(); \
+    static int name##_registered = registerTest(#name, name); \
+    static void name()
+
+#define CHECK(expression) \
+    do { if (!(expression)) reportFailure(__FILE__, __LINE__, #expression); } while (0)
+
+#define CHECK_NEAR(a, b, tolerance) \
+    CHECK(fabs((double)(a) - (double)(b)) <= (tolerance))
+
+// Benchmarks, only run by "gpuprof-tests -bench [name filter]", from the Release build.
+// They print their figures and CHECK the targets the code was written against.
+int registerBenchmark(const char* name, TestFn fn);
+int64_t getBenchTimeNs();
+
+#define BENCH(name) \
+    static void name(); \
+    static int name##_registered = registerBenchmark(#name, name); \
+    static void name()
+
+// ns per operation of fn(), which does ops of them, the best of a few rounds
+template <typename Fn>
+double measureNsPerOp(int64_t ops, Fn&& fn)
+{
+    double best = 1e300;
+    for (int round = 0; round < 5; round++)
+    {
+        int64_t start = getBenchTimeNs();
+        fn();
+        double ns = double(getBenchTimeNs() - start) / ops;
+        best = ns < best ? ns : best;
+    }
+    return best;
+}
+
+// keeps the optimizer from dropping a result
+void keepResult(double value);
@@ -0,0 +1,84 @@
+#include "test.h"
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    struct TestCase
+    {
+        const char* name;
+        TestFn fn;
+    };
+
+    // registered from static initializers, has to exist before the first one runs
+    vector<TestCase>& getTests()
+    {
+        static vector<TestCase> tests;
+        return tests;
+    }
+
+    vector<TestCase>& getBenchmarks()
+    {
+        static vector<TestCase> benchmarks;
+        return benchmarks;
+    }
+
+    int failures = 0;
+    volatile double sink = 0;
+}
+
+int registerTest(const char* name, TestFn fn)
+{
+    getTests().push_back({ name, fn });
+    return 0;
+}
+
+int registerBenchmark(const char* name, TestFn fn)
+{
+    getBenchmarks().push_back({ name, fn });
+    return 0;
+}
+
+int64_t getBenchTimeNs()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void keepResult(double value)
+{
+    sink = sink + value;
+}
+
+void reportFailure(const char* file, int line, const char* expression)
+{
+    fprintf(stderr, "%s(%d): CHECK(%s) failed\r\n", file, line, expression);
+    failures++;
+}
+
+// gpuprof-tests [-bench] [name filter]
+int main(int argc, char* argv[])
+{
+    bool isBench = argc > 1 && strcmp(argv[1], "-bench") == 0;
+    const char* filter = argc > (isBench ? 2 : 1) ? argv[isBench ? 2 : 1] : nullptr;
+    int failedTests = 0;
+    int runTests = 0;
+    for (const auto& test : isBench ? getBenchmarks() : getTests())
+    {
+        if (filter && !strstr(test.name, filter))
+            continue;
+        int before = failures;
+        test.fn();
+        runTests++;
+        bool isPassed = failures == before;
+        printf("%s %s\n", isPassed ? "[ OK ]" : "[FAIL]", test.name);
+        if (!isPassed)
+            failedTests++;
+    }
+    printf("%d of %d tests passed\n", runTests - failedTests, runTests);
+    return failedTests == 0 ? 0 : 1;
+}
@@ -0,0 +1,213 @@
+#include "test.h"
+#include "../src/metric_series.h"
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+TEST(ringKeepsTheNewestSamplesAcrossTheWrap)
+{
+    MetricSeries series;
+    series.setCapacity(4);
+    for (int i = 0; i < 10; i++)
+        series.push((float)i, 1000 + i * 100);
+
+    CHECK(series.count == 4);
+    CHECK(series.back() == 9);
+    CHECK(series.newestTime == 1900);
+    CHECK(series.oldestTime == 1600);
+    CHECK_NEAR(series.samplePeriodMs(), 100, 1e-3);
+
+    // 0 is the oldest of the last n
+    for (int i = 0; i < 4; i++)
+        CHECK(series.latest(i, 4) == 6 + i);
+    CHECK(series.latest(0, 6) == 0);
+
+    // every wrap position, the copy is split in two memcpy once the head passed the end
+    for (int extra = 0; extra < 4; extra++)
+    {
+        series.push(10.0f + extra, 2000 + extra * 100);
+        float copy[6];
+        series.copyLatest(copy, 6);
+        CHECK(copy[0] == 0 && copy[1] == 0);
+        for (int i = 0; i < 4; i++)
+            CHECK(copy[2 + i] == 7 + extra + i);
+    }
+}
+
+TEST(ringPartiallyFilled)
+{
+    MetricSeries series;
+    series.setCapacity(8);
+    series.push(1, 0);
+    series.push(2, 50);
+    series.push(3, 100);
+
+    float copy[5];
+    series.copyLatest(copy, 5);
+    CHECK(copy[0] == 0 && copy[1] == 0 && copy[2] == 1 && copy[3] == 2 && copy[4] == 3);
+    CHECK(series.oldestTime == 0);
+    CHECK_NEAR(series.samplePeriodMs(), 50, 1e-3);
+}
+
+TEST(ringWindowStatsAfterTheWrap)
+{
+    MetricSeries series;
+    series.setCapacity(16);
+    for (int i = 0; i < 100; i++)
+        series.push(i % 2 ? 10.0f : 0.0f, i * 100);
+
+    // every sample weighted by the time since the previous one, clipped to the window
+    auto stats = series.query(9100, 9900);
+    CHECK(stats.count == 9);
+    CHECK(stats.min == 0 && stats.max == 10);
+    CHECK(stats.durationMs == 800);
+    CHECK_NEAR(stats.mean, 5, 1e-3);
+}
+
+TEST(ringWindowStatsMatchABruteForceScan)
+{
+    // windows that end on either side of the wrap point, the min / max come from two spans then
+    MetricSeries series;
+    series.setCapacity(37);
+    vector<float> all;
+    for (int i = 0; i < 100; i++)
+    {
+        float v = float((i * 7919) % 113) - 50;
+        series.push(v, i * 10);
+        all.push_back(v);
+    }
+    for (int first = 64; first < 100; first += 5)
+    {
+        for (int last = first; last < 100; last += 7)
+        {
+            auto stats = series.query(first * 10, last * 10);
+            float lo = all[first], hi = all[first];
+            double weighted = 0;
+            for (int i = first; i <= last; i++)
+            {
+                lo = min(lo, all[i]);
+                hi = max(hi, all[i]);
+                weighted += i > first ? all[i] * 10.0 : 0;
+            }
+            CHECK(stats.count == last - first + 1);
+            CHECK(stats.min == lo && stats.max == hi);
+            if (last > first)
+                CHECK_NEAR(stats.mean, weighted / ((last - first) * 10), 1e-3);
+        }
+    }
+}
+
+TEST(ringKeepsGapsLongerThan16Bits)
+{
+    // a 10 minute stall, then more than a ring of samples so the gap wraps out
+    MetricSeries series;
+    series.setCapacity(8);
+    for (int i = 0; i < 4; i++)
+        series.push(1, i * 100);
+    const int64_t resumeMs = 300 + 10 * 60 * 1000;
+    for (int i = 0; i < 4; i++)
+        series.push(2, resumeMs + i * 100);
+
+    CHECK(series.oldestTime == 0);
+    CHECK(series.newestTime == resumeMs + 300);
+    auto stats = series.query(0, series.newestTime);
+    CHECK(stats.count == 8);
+    CHECK(stats.durationMs == series.newestTime);
+    // the stall weighs on the first value after it
+    CHECK_NEAR(stats.mean, (1.0 * 300 + 2.0 * (resumeMs - 300 + 300)) / series.newestTime, 1e-4);
+
+    // the resampled window sees the samples before the stall where they were
+    float points[4];
+    series.resample(points, 4, 400, 400);
+    CHECK(points[3] == 1);
+
+    // the oldest time steps over the gap once the samples before it are gone
+    for (int i = 4; i < 9; i++)
+        series.push(3, resumeMs + i * 100);
+    CHECK(series.oldestTime == resumeMs + 100);
+    CHECK(series.longDeltas.empty());
+    CHECK_NEAR(series.samplePeriodMs(), 100, 1e-3);
+}
+
+TEST(ringGrowKeepsEverySample)
+{
+    // a 20 ms series, wrapped with a long gap inside, then grown to cover a 20 s view
+    MetricSeries series;
+    series.setCapacity(200);
+    for (int i = 0; i < 150; i++)
+        series.push(1, i * 20);
+    const int64_t resumeMs = 149 * 20 + 70000;
+    for (int i = 0; i < 130; i++)
+        series.push(float(i), resumeMs + i * 20);
+    int64_t oldest = series.oldestTime;
+
+    series.grow(1001);
+    CHECK(series.capacity() == 1001);
+    CHECK(series.count == 200);
+    CHECK(series.oldestTime == oldest);
+    CHECK(series.newestTime == resumeMs + 129 * 20);
+    for (int i = 0; i < 130; i++)
+        CHECK(series.latest(70 + i, 200) == float(i));
+    CHECK(series.deltaAt(70) == 70000);
+
+    // fills up to the new capacity before it drops anything
+    for (int i = 130; i < 1001; i++)
+        series.push(float(i), resumeMs + i * 20);
+    CHECK(series.count == 1001);
+    CHECK(series.oldestTime == resumeMs);
+    CHECK(series.latest(0, 1001) == 0);
+    CHECK(series.query(series.newestTime - 20000, series.newestTime).count == 1001);
+}
+
+TEST(ringGrowDoesNotHideTheEvictedSamples)
+{
+    // 300 samples through a 200 slot ring, then grown, the first 100 are only in the tiers and the archive
+    MetricSeries series;
+    series.setCapacity(200);
+    for (int i = 0; i < 300; i++)
+        series.push(i < 100 ? 1.0f : 2.0f, i * 20);
+    series.grow(1001);
+    CHECK(series.count < series.capacity());
+    CHECK(series.hasEvicted);
+    CHECK(series.oldestTime == 100 * 20);
+
+    // older than the ring, from the archive rather than the partial raw ring
+    WindowStats stats = series.query(0, 1000);
+    CHECK(stats.count == 51);
+    CHECK(stats.min == 1 && stats.max == 1);
+
+    // a view reaching before the ring isn't zero padded
+    float points[100];
+    series.resample(points, 100, 6000, series.newestTime);
+    CHECK(points[1] == 1);
+    CHECK(points[99] == 2);
+}
+
+BENCH(ringAppendCostIsFlat)
+{
+    // steady state append, the ring already full and wrapping, from the default size to a million samples
+    const int capacities[] = { 200, 10000, 100000, 1000000 };
+    const int64_t ops = 2000000;
+    double fastest = 1e300, slowest = 0;
+    for (int capacity : capacities)
+    {
+        MetricSeries series;
+        series.setCapacity(capacity);
+        int64_t timeMs = 0;
+        for (int i = 0; i < capacity; i++)
+            series.push(float(i & 127), timeMs += 20);
+
+        double ns = measureNsPerOp(ops, [&]
+        {
+            for (int64_t i = 0; i < ops; i++)
+                series.push(float(i & 127), timeMs += 20);
+        });
+        keepResult(series.values[series.head]);
+        printf("    %8d samples: %6.1f ns per append\n", capacity, ns);
+        fastest = ns < fastest ? ns : fastest;
+        slowest = ns > slowest ? ns : slowest;
+    }
+    CHECK(slowest < fastest * 2);
+}
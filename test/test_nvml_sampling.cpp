@@ -0,0 +1,442 @@
+#include "test.h"
+#include "../src/nvml_sampling.h"
+#include "../src/nvml_stub.h"
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// nvidia_prof.cpp isn't part of the tests, the plan only reports through this
+void ShowErrorDetails(const nvmlReturn_t, const char*)
+{
+}
+
+// and the benchmark binds its entry points to the fake devices of nvml_stub.cpp
+#define ENTRY(func) decltype(func)* _##func = nullptr;
+#include "../3rdparty/CUDA_SDK/nvml.def"
+#undef ENTRY
+
+namespace
+{
+    // the fake device answers every field but the memory temperature
+    int fieldValuesCalls = 0;
+    vector<unsigned int> lastRequest;
+
+    nvmlReturn_t fakeFieldValues(nvmlDevice_t, int valuesCount, nvmlFieldValue_t* values)
+    {
+        fieldValuesCalls++;
+        lastRequest.clear();
+        for (int i = 0; i < valuesCount; i++)
+        {
+            auto& field = values[i];
+            lastRequest.push_back(field.fieldId);
+            if (field.fieldId == NVML_FI_DEV_MEMORY_TEMP)
+            {
+                field.nvmlReturn = NVML_ERROR_NOT_SUPPORTED;
+                continue;
+            }
+            field.nvmlReturn = NVML_SUCCESS;
+            field.valueType = NVML_VALUE_TYPE_UNSIGNED_INT;
+            field.value.uiVal = field.fieldId * 10;
+        }
+        return NVML_SUCCESS;
+    }
+
+    struct TestPlan
+    {
+        SamplingPlan plan;
+        int energy, replays, memoryTemp, clock, fan;
+        int memoryTempCalls = 0;
+        int clockCalls = 0;
+        int fanCalls = 0;
+
+        TestPlan()
+        {
+            energy = plan.addSlot("energy");
+            replays = plan.addSlot("replays");
+            memoryTemp = plan.addSlot("memory temp");
+            clock = plan.addSlot("clock");
+            fan = plan.addSlot("fan");
+            plan.addField(energy, NVML_FI_DEV_TOTAL_ENERGY_CONSUMPTION, 0, nullptr, nullptr);
+            plan.addField(replays, NVML_FI_DEV_PCIE_REPLAY_COUNTER, 0, "replays", [this](SamplingPlan& p)
+            {
+                p.set(replays, -1);
+                return NVML_SUCCESS;
+            });
+            plan.addField(memoryTemp, NVML_FI_DEV_MEMORY_TEMP, 0, "memory temp", [this](SamplingPlan& p)
+            {
+                memoryTempCalls++;
+                p.set(memoryTemp, 70);
+                return NVML_SUCCESS;
+            });
+            plan.addCall("clock", [this](SamplingPlan& p)
+            {
+                clockCalls++;
+                p.set(clock, 1500);
+                return NVML_SUCCESS;
+            });
+            plan.addCall("fan", [this](SamplingPlan&)
+            {
+                fanCalls++;
+                return NVML_ERROR_NOT_SUPPORTED;
+            });
+        }
+    };
+}
+
+TEST(planBatchesTheFieldsTheDeviceAnswers)
+{
+    TestPlan t;
+    fieldValuesCalls = 0;
+    t.plan.build(nullptr, fakeFieldValues);
+    CHECK(fieldValuesCalls == 1);
+
+    // energy and replays in one call, the memory temperature through its fallback
+    CHECK(t.plan.isBatched(t.energy) && t.plan.isBatched(t.replays));
+    CHECK(!t.plan.isBatched(t.memoryTemp));
+
+    int calls = t.plan.sample(nullptr, fakeFieldValues);
+    CHECK(lastRequest.size() == 2);
+    CHECK(lastRequest[0] == NVML_FI_DEV_TOTAL_ENERGY_CONSUMPTION && lastRequest[1] == NVML_FI_DEV_PCIE_REPLAY_COUNTER);
+    // the batch, the memory temperature, the clock and the fan
+    CHECK(calls == 4);
+    CHECK(t.plan.get(t.energy) == NVML_FI_DEV_TOTAL_ENERGY_CONSUMPTION * 10);
+    // the fallback of a batched field is never called
+    CHECK(t.plan.get(t.replays) == NVML_FI_DEV_PCIE_REPLAY_COUNTER * 10);
+    CHECK(t.memoryTempCalls == 1 && t.plan.get(t.memoryTemp) == 70);
+    CHECK(t.plan.get(t.clock) == 1500);
+}
+
+TEST(planFallsBackWithoutFieldSupport)
+{
+    // an old driver without nvmlDeviceGetFieldValues
+    TestPlan t;
+    t.plan.build(nullptr, nullptr);
+    CHECK(!t.plan.isBatched(t.energy) && !t.plan.isBatched(t.replays));
+
+    fieldValuesCalls = 0;
+    t.plan.sample(nullptr, nullptr);
+    CHECK(fieldValuesCalls == 0);
+    // no fallback for the energy, it stays invalid
+    CHECK(!t.plan.isValid(t.energy));
+    CHECK(t.plan.isValid(t.replays) && t.plan.get(t.replays) == -1);
+    CHECK(t.memoryTempCalls == 1 && t.plan.get(t.memoryTemp) == 70);
+}
+
+TEST(planDropsTheCallsAnsweringNotSupported)
+{
+    TestPlan t;
+    t.plan.build(nullptr, fakeFieldValues);
+    // the batch, the memory temperature, the clock and the fan
+    CHECK(t.plan.callCount() == 4);
+
+    t.plan.sample(nullptr, fakeFieldValues);
+    CHECK(t.fanCalls == 1);
+    CHECK(t.plan.callCount() == 3);
+
+    for (int i = 0; i < 5; i++)
+        CHECK(t.plan.sample(nullptr, fakeFieldValues) == 3);
+    CHECK(t.fanCalls == 1);
+    CHECK(t.clockCalls == 6);
+    CHECK(!t.plan.isValid(t.fan));
+
+    vector<SamplingPlan::CallReport> reports;
+    t.plan.getReports(&reports);
+    CHECK(reports.size() == 3);
+    for (const auto& report : reports)
+        CHECK(string(report.name) != "fan");
+}
+
+TEST(planLeavesAHungOffloadedCallBehind)
+{
+    // shared with the call, the worker may still run it after the plan is gone
+    auto isHung = make_shared<atomic<bool>>(false);
+    auto runs = make_shared<atomic<int>>(0);
+    SamplingPlan plan;
+    int slot = plan.addSlot("slow");
+    plan.addCall("slow", [isHung, runs, slot](SamplingPlan& p)
+    {
+        this_thread::sleep_for(chrono::milliseconds(3));
+        while (*isHung)
+            this_thread::sleep_for(chrono::milliseconds(1));
+        p.set(slot, 42);
+        (*runs)++;
+        return NVML_SUCCESS;
+    });
+    plan.budgetUs = 2000;
+    plan.build(nullptr, nullptr);
+
+    // timed on the tick first, then moved to the background
+    for (int i = 0; i < CallCadence::MIN_RUNS; i++)
+        plan.sample(nullptr, nullptr);
+    CHECK(plan.calls[0].isOffloaded);
+    for (int i = 0; i < 200 && *runs <= CallCadence::MIN_RUNS; i++)
+    {
+        this_thread::sleep_for(chrono::milliseconds(5));
+        plan.sample(nullptr, nullptr);
+    }
+    plan.sample(nullptr, nullptr);
+    CHECK(plan.isValid(slot) && plan.get(slot) == 42);
+    CHECK(plan.stalledCall == nullptr);
+
+    *isHung = true;
+    auto t0 = chrono::steady_clock::now();
+    while (!plan.stalledCall && chrono::steady_clock::now() - t0 < chrono::seconds(5))
+    {
+        this_thread::sleep_for(chrono::milliseconds(20));
+        plan.sample(nullptr, nullptr);
+    }
+    CHECK(plan.stalledCall && strcmp(plan.stalledCall, "slow") == 0);
+    CHECK(plan.stallUs >= SamplingPlan::OFFLOAD_DEADLINE_MS * 1000);
+    // the last value isn't passed off as a current one
+    CHECK(!plan.isValid(slot));
+
+    // stop() gives up on it rather than waiting for the driver
+    t0 = chrono::steady_clock::now();
+    CHECK(!plan.stop(50));
+    CHECK(chrono::steady_clock::now() - t0 < chrono::milliseconds(500));
+    CHECK(!plan.isOffloadBusy());
+
+    // the call left behind still finishes
+    int before = *runs;
+    *isHung = false;
+    for (int i = 0; i < 200 && *runs == before; i++)
+        this_thread::sleep_for(chrono::milliseconds(5));
+    CHECK(*runs == before + 1);
+}
+
+TEST(counterRateOverTheRealTime)
+{
+    CounterRate rate;
+    double perSecond = 0;
+    // nothing to compare the first read with, nor a repeat of it
+    CHECK(!rate.update(1000, 1000000, 64, 0, &perSecond));
+    CHECK(!rate.update(1000, 1000000, 64, 0, &perSecond));
+    CHECK(rate.update(3000, 1500000, 64, 0, &perSecond));
+    CHECK_NEAR(perSecond, 4000, 1e-6);
+    CHECK(rate.wraps == 0 && rate.resets == 0);
+}
+
+TEST(counterRateWrapOrReset)
+{
+    double perSecond = 0;
+
+    // 32 bit counter just below the top, 512 bytes later it went around
+    CounterRate wrap;
+    wrap.update(0xFFFFFF00ull, 0, 32, 1e6, &perSecond);
+    CHECK(wrap.update(0x100, 1000000, 32, 1e6, &perSecond));
+    CHECK_NEAR(perSecond, 512, 1e-6);
+    CHECK(wrap.wraps == 1 && wrap.resets == 0);
+
+    // the same wrap would mean 4 GB in a second on a 1 MB/s link, the counter restarted from 0
+    CounterRate reset;
+    reset.update(0x10000000ull, 0, 32, 1e6, &perSecond);
+    CHECK(reset.update(0x100, 1000000, 32, 1e6, &perSecond));
+    CHECK_NEAR(perSecond, 256, 1e-6);
+    CHECK(reset.wraps == 0 && reset.resets == 1);
+
+    // without a known maximum only a counter in the upper half is believed to wrap
+    CounterRate upper, lower;
+    upper.update(0xF0000000ull, 0, 32, 0, &perSecond);
+    CHECK(upper.update(0x10, 1000000, 32, 0, &perSecond));
+    CHECK_NEAR(perSecond, 0x10000010ull, 1e-6);
+    CHECK(upper.wraps == 1);
+    lower.update(0x70000000ull, 0, 32, 0, &perSecond);
+    CHECK(lower.update(0x10, 1000000, 32, 0, &perSecond));
+    CHECK_NEAR(perSecond, 0x10, 1e-6);
+    CHECK(lower.resets == 1);
+
+    // a value above counterBits can't have wrapped there
+    CounterRate wide;
+    wide.update(0x1FFFFFFFFull, 0, 32, 0, &perSecond);
+    CHECK(wide.update(0x20, 1000000, 32, 0, &perSecond));
+    CHECK_NEAR(perSecond, 0x20, 1e-6);
+    CHECK(wide.resets == 1);
+
+    // 64 bit counters wrap over the whole range
+    CounterRate full;
+    full.update(~0ull - 99, 0, 64, 0, &perSecond);
+    CHECK(full.update(100, 2000000, 64, 0, &perSecond));
+    CHECK_NEAR(perSecond, 100, 1e-6);
+    CHECK(full.wraps == 1);
+}
+
+namespace
+{
+    // what a driver call costs on top of the fake, spent in the call hook
+    int64_t simulatedCallNs = 0;
+    int64_t nvmlCalls = 0;
+
+    void spinInDriver(const char* entryName)
+    {
+        if (!entryName)
+            return;
+        nvmlCalls++;
+        int64_t until = getBenchTimeNs() + simulatedCallNs;
+        while (getBenchTimeNs() < until)
+            ;
+    }
+
+    // the per-tick queries of NvidiaInfo::update(), without PCIe which waits 20 ms for its counters
+    struct PlanBench
+    {
+        nvmlDevice_t device = nullptr;
+        SamplingPlan plan;
+        int links = 0;
+
+        void build()
+        {
+            auto device = this->device;
+            int sm = plan.addSlot("SM");
+            int fb = plan.addSlot("FB used");
+            int temp = plan.addSlot("TEMP");
+            int enc = plan.addSlot("ENC");
+            int dec = plan.addSlot("DEC");
+            int throttle = plan.addSlot("THROTTLE");
+            plan.addCall("nvmlDeviceGetUtilizationRates", [=](SamplingPlan& plan)
+            {
+                nvmlUtilization_t util = {};
+                auto ret = _nvmlDeviceGetUtilizationRates(device, &util);
+                plan.set(sm, util.gpu);
+                return ret;
+            });
+            plan.addCall("nvmlDeviceGetMemoryInfo", [=](SamplingPlan& plan)
+            {
+                nvmlMemory_t memory = {};
+                auto ret = _nvmlDeviceGetMemoryInfo(device, &memory);
+                plan.set(fb, double(memory.used));
+                return ret;
+            });
+            plan.addCall("nvmlDeviceGetTemperature", [=](SamplingPlan& plan)
+            {
+                unsigned int value = 0;
+                auto ret = _nvmlDeviceGetTemperature(device, NVML_TEMPERATURE_GPU, &value);
+                plan.set(temp, value);
+                return ret;
+            });
+            plan.addCall("nvmlDeviceGetEncoderUtilization", [=](SamplingPlan& plan)
+            {
+                unsigned int util = 0, periodUs = 0;
+                auto ret = _nvmlDeviceGetEncoderUtilization(device, &util, &periodUs);
+                plan.set(enc, util);
+                return ret;
+            });
+            plan.addCall("nvmlDeviceGetDecoderUtilization", [=](SamplingPlan& plan)
+            {
+                unsigned int util = 0, periodUs = 0;
+                auto ret = _nvmlDeviceGetDecoderUtilization(device, &util, &periodUs);
+                plan.set(dec, util);
+                return ret;
+            });
+            for (int type = 0; type < NVML_CLOCK_COUNT; type++)
+            {
+                int slot = plan.addSlot("CLK");
+                plan.addCall("nvmlDeviceGetClockInfo", [=](SamplingPlan& plan)
+                {
+                    unsigned int clock = 0;
+                    auto ret = _nvmlDeviceGetClockInfo(device, (nvmlClockType_t)type, &clock);
+                    plan.set(slot, clock);
+                    return ret;
+                });
+            }
+            plan.addCall("nvmlDeviceGetCurrentClocksThrottleReasons", [=](SamplingPlan& plan)
+            {
+                unsigned long long reasons = 0;
+                auto ret = _nvmlDeviceGetCurrentClocksThrottleReasons(device, &reasons);
+                plan.set(throttle, double(reasons & 0xFFFFFFFF));
+                return ret;
+            });
+            for (int j = 0; j < links; j++)
+            {
+                plan.addField(plan.addSlot("NVLK-TX"), NVML_FI_DEV_NVLINK_THROUGHPUT_DATA_TX, j, nullptr, nullptr);
+                plan.addField(plan.addSlot("NVLK-RX"), NVML_FI_DEV_NVLINK_THROUGHPUT_DATA_RX, j, nullptr, nullptr);
+            }
+            plan.build(device, _nvmlDeviceGetFieldValues);
+        }
+
+        // the same queries one call each, as update() made them before the plan
+        double sampleLegacy()
+        {
+            double sum = 0;
+            nvmlUtilization_t util = {};
+            _nvmlDeviceGetUtilizationRates(device, &util);
+            nvmlMemory_t memory = {};
+            _nvmlDeviceGetMemoryInfo(device, &memory);
+            unsigned int value = 0, periodUs = 0;
+            _nvmlDeviceGetTemperature(device, NVML_TEMPERATURE_GPU, &value);
+            sum += value;
+            _nvmlDeviceGetEncoderUtilization(device, &value, &periodUs);
+            sum += value;
+            _nvmlDeviceGetDecoderUtilization(device, &value, &periodUs);
+            sum += value;
+            for (int type = 0; type < NVML_CLOCK_COUNT; type++)
+            {
+                _nvmlDeviceGetClockInfo(device, (nvmlClockType_t)type, &value);
+                sum += value;
+            }
+            unsigned long long reasons = 0;
+            _nvmlDeviceGetCurrentClocksThrottleReasons(device, &reasons);
+            for (int j = 0; j < links; j++)
+            {
+                for (auto fieldId : { NVML_FI_DEV_NVLINK_THROUGHPUT_DATA_TX, NVML_FI_DEV_NVLINK_THROUGHPUT_DATA_RX })
+                {
+                    nvmlFieldValue_t field = {};
+                    field.fieldId = fieldId;
+                    field.scopeId = j;
+                    _nvmlDeviceGetFieldValues(device, 1, &field);
+                    sum += getFieldValue(field);
+                }
+            }
+            return sum + util.gpu + double(memory.used) + double(reasons);
+        }
+    };
+}
+
+BENCH(planTickAgainstPerCallQueries)
+{
+    // two fake devices, four nvlinks each
+    nvml_stub_fake(2);
+    nvml_stub_time();
+    nvml_stub_set_call_hook(spinInDriver);
+    _nvmlInit_v2();
+    PlanBench bench;
+    bench.links = 4;
+    CHECK(_nvmlDeviceGetHandleByIndex_v2(0, &bench.device) == NVML_SUCCESS);
+    bench.build();
+
+    for (int64_t costNs : { 0, 10000 })
+    {
+        simulatedCallNs = costNs;
+        const int ticks = costNs > 0 ? 200 : 5000;
+
+        nvmlCalls = 0;
+        double planUs = measureNsPerOp(ticks, [&]
+        {
+            for (int i = 0; i < ticks; i++)
+                bench.plan.sample(bench.device, _nvmlDeviceGetFieldValues);
+        }) / 1000;
+        int64_t planCalls = nvmlCalls / (5 * ticks);
+
+        nvmlCalls = 0;
+        double legacyUs = measureNsPerOp(ticks, [&]
+        {
+            for (int i = 0; i < ticks; i++)
+                keepResult(bench.sampleLegacy());
+        }) / 1000;
+        int64_t legacyCalls = nvmlCalls / (5 * ticks);
+
+        printf("    %2d us per driver call: plan %.1f us in %d calls, per-call queries %.1f us in %d calls\n",
+            int(costNs / 1000), planUs, int(planCalls), legacyUs, int(legacyCalls));
+        CHECK(planCalls < legacyCalls);
+        if (costNs > 0)
+            CHECK(planUs < legacyUs);
+    }
+    nvml_stub_set_call_hook(nullptr);
+    simulatedCallNs = 0;
+}
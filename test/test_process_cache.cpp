@@ -0,0 +1,171 @@
+#include "test.h"
+#include "../src/process_cache.h"
+#include <stdio.h>
+#include <chrono>
+#include <thread>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+    // a process that does nothing until stopChild()
+#ifdef _WIN32
+    PROCESS_INFORMATION child = {};
+
+    uint32_t currentPid()
+    {
+        return GetCurrentProcessId();
+    }
+
+    uint32_t startChild()
+    {
+        STARTUPINFOA si = { sizeof(si) };
+        char cmd[] = "cmd.exe";
+        if (!CreateProcessA(nullptr, cmd, nullptr, nullptr, FALSE, CREATE_SUSPENDED | CREATE_NO_WINDOW, nullptr, nullptr, &si, &child))
+            return 0;
+        return child.dwProcessId;
+    }
+
+    void stopChild()
+    {
+        TerminateProcess(child.hProcess, 0);
+        WaitForSingleObject(child.hProcess, INFINITE);
+        CloseHandle(child.hThread);
+        CloseHandle(child.hProcess);
+    }
+#else
+    pid_t child = 0;
+
+    uint32_t currentPid()
+    {
+        return (uint32_t)getpid();
+    }
+
+    uint32_t startChild()
+    {
+        child = fork();
+        if (child == 0)
+        {
+            while (true)
+                pause();
+        }
+        return child > 0 ? (uint32_t)child : 0;
+    }
+
+    void stopChild()
+    {
+        kill(child, SIGKILL);
+        waitpid(child, nullptr, 0);
+    }
+#endif
+
+    // a busy host, 1% of the pids reused by a new process at every enumeration
+    const int kSyntheticCount = 5000;
+    const uint32_t kSyntheticBasePid = 100000;
+    uint64_t syntheticGeneration = 0;
+
+    void enumerateSynthetic(vector<ProcessMeta>* processes)
+    {
+        syntheticGeneration++;
+        processes->resize(kSyntheticCount);
+        for (int i = 0; i < kSyntheticCount; i++)
+        {
+            auto& meta = (*processes)[i];
+            meta.pid = kSyntheticBasePid + i * 4;
+            meta.parentPid = kSyntheticBasePid;
+            meta.threadCount = 1 + i % 32;
+            bool isReused = i % 100 == syntheticGeneration % 100;
+            meta.startTime = isReused ? 1000000 + syntheticGeneration * kSyntheticCount + i : 1 + i;
+            if (meta.exeName.empty() || isReused)
+            {
+                char name[32];
+                snprintf(name, sizeof(name), "process_%d.exe", i);
+                meta.exeName = name;
+            }
+        }
+    }
+}
+
+TEST(processCacheFindsItself)
+{
+    CHECK(refreshProcessCache() > 1);
+
+    ProcessMeta self;
+    CHECK(lookupProcess(currentPid(), &self));
+    CHECK(self.pid == currentPid());
+    CHECK(!self.exeName.empty());
+    CHECK(self.threadCount >= 1);
+    CHECK(self.startTime != 0);
+#ifndef _WIN32
+    CHECK(self.parentPid == (uint32_t)getppid());
+#endif
+
+    // the start time is kept across refreshes, it is what tells a reused pid apart
+    refreshProcessCache();
+    ProcessMeta again;
+    CHECK(lookupProcess(currentPid(), &again));
+    CHECK(again.startTime == self.startTime);
+    CHECK(again.exeName == self.exeName);
+}
+
+TEST(processCacheSeesAChildComeAndGo)
+{
+    uint32_t pid = startChild();
+    CHECK(pid != 0);
+    if (pid == 0)
+        return;
+
+    // an unknown pid refreshes the table on its own, at most once every 16 ms
+    this_thread::sleep_for(chrono::milliseconds(20));
+    ProcessMeta meta;
+    CHECK(lookupProcess(pid, &meta));
+    CHECK(meta.parentPid == currentPid());
+    CHECK(meta.startTime != 0);
+
+    stopChild();
+    refreshProcessCache();
+    CHECK(!lookupProcess(pid, &meta));
+}
+
+BENCH(processCacheLookupSweep)
+{
+    // every pid of 5000 synthetic processes looked up once per tick, as the accounting pids are
+    setProcessSource(enumerateSynthetic);
+    refreshProcessCache();
+
+    double refreshNs = measureNsPerOp(1, [] { refreshProcessCache(); });
+    ProcessMeta meta;
+    int found = 0;
+    double lookupNs = measureNsPerOp(kSyntheticCount, [&]
+    {
+        for (int i = 0; i < kSyntheticCount; i++)
+            found += lookupProcess(kSyntheticBasePid + i * 4, &meta);
+    });
+    CHECK(found == 5 * kSyntheticCount);
+
+    // the old getEntryFromPID, a snapshot of every process for each pid
+    const int snapshotLookups = 200;
+    double snapshotNs = measureNsPerOp(snapshotLookups, [&]
+    {
+        for (int i = 0; i < snapshotLookups; i++)
+        {
+            refreshProcessCache();
+            lookupProcess(kSyntheticBasePid + i * 4, &meta);
+        }
+    });
+    setProcessSource(nullptr);
+
+    double cachedTickUs = (refreshNs + lookupNs * kSyntheticCount) / 1000;
+    double snapshotTickUs = snapshotNs * kSyntheticCount / 1000;
+    printf("    refresh %.0f us, lookup %.0f ns, per-pid snapshot %.0f us\n", refreshNs / 1000, lookupNs, snapshotNs / 1000);
+    printf("    tick of %d lookups: cached %.0f us, per-pid snapshots %.0f us\n", kSyntheticCount, cachedTickUs, snapshotTickUs);
+    CHECK(cachedTickUs * 100 < snapshotTickUs);
+}
@@ -0,0 +1,145 @@
+#include "test.h"
+#include "../src/quantile_sketch.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    const float kQuantiles[] = { 0.5f, 0.95f, 0.99f, 0.999f };
+    // the sketch promises 1%, a hair more for the float rounding
+    const double kTolerance = 0.0101;
+
+    // deterministic uniform in (0, 1)
+    struct Random
+    {
+        uint64_t state = 0x9E3779B97F4A7C15ull;
+        double next()
+        {
+            state = state * 6364136223846793005ull + 1442695040888963407ull;
+            return ((state >> 11) + 0.5) / 9007199254740992.0;
+        }
+    };
+
+    // every quantile of values within the relative accuracy of the exact one
+    void checkAccuracy(vector<float> values)
+    {
+        QuantileSketch sketch;
+        for (float v : values)
+            sketch.add(v);
+        sort(values.begin(), values.end());
+        for (float q : kQuantiles)
+        {
+            double exact = values[(size_t)(q * (values.size() - 1))];
+            double estimate = sketch.quantile(q);
+            CHECK(fabs(estimate - exact) <= kTolerance * exact);
+        }
+    }
+}
+
+TEST(sketchAccuracyUniform)
+{
+    Random random;
+    vector<float> values(200000);
+    for (auto& v : values)
+        v = float(1 + 999 * random.next());
+    checkAccuracy(values);
+}
+
+TEST(sketchAccuracyExponential)
+{
+    // long tail, latencies in ms
+    Random random;
+    vector<float> values(200000);
+    for (auto& v : values)
+        v = float(-20 * log(random.next()) + 0.01);
+    checkAccuracy(values);
+}
+
+TEST(sketchAccuracyWideRange)
+{
+    // six decades, from 1e-2 to 1e4
+    Random random;
+    vector<float> values(200000);
+    for (auto& v : values)
+        v = float(pow(10.0, -2 + 6 * random.next()));
+    checkAccuracy(values);
+}
+
+TEST(sketchZeroAndNegativeShareTheZeroBin)
+{
+    QuantileSketch sketch;
+    for (int i = 0; i < 60; i++)
+        sketch.add(i % 2 ? 0.0f : -5.0f);
+    for (int i = 0; i < 40; i++)
+        sketch.add(100);
+    CHECK(sketch.quantile(0.5f) == 0);
+    CHECK_NEAR(sketch.quantile(0.99f), 100, 100 * kTolerance);
+}
+
+TEST(sketchMergeEqualsOneSketch)
+{
+    Random random;
+    QuantileSketch all, a, b;
+    for (int i = 0; i < 50000; i++)
+    {
+        float v = float(1 + 99 * random.next());
+        all.add(v);
+        (i % 3 ? a : b).add(v);
+    }
+    a.merge(b);
+    CHECK(a.count == all.count);
+    for (float q : kQuantiles)
+        CHECK(a.quantile(q) == all.quantile(q));
+}
+
+TEST(sketchWindowForgetsTheOldChunks)
+{
+    MetricSketch sketch;
+    // a minute of 1000, then 20 s of 10
+    for (int64_t t = 0; t < 60000; t += 100)
+        sketch.add(1000, t);
+    for (int64_t t = 60000; t < 80000; t += 100)
+        sketch.add(10, t);
+
+    float q = 0.99f, window, session;
+    sketch.windowQuantiles(&q, &window, 1, 20000);
+    sketch.sessionQuantiles(&q, &session, 1);
+    CHECK_NEAR(window, 10, 10 * kTolerance);
+    CHECK_NEAR(session, 1000, 1000 * kTolerance);
+}
+
+BENCH(sketchUpdateUnder100ns)
+{
+    // six decades of values, the per-sample cost of the bare sketch and of the series one with its window chunks
+    Random random;
+    vector<float> values(4096);
+    for (auto& v : values)
+        v = float(pow(10.0, -2 + 6 * random.next()));
+    const int64_t ops = 4000000;
+
+    QuantileSketch sketch;
+    double sketchNs = measureNsPerOp(ops, [&]
+    {
+        for (int64_t i = 0; i < ops; i++)
+            sketch.add(values[i & 4095]);
+    });
+    keepResult(sketch.quantile(0.99f));
+
+    // 10 samples per ms, every chunk of the window gets rotated in several times
+    MetricSketch series;
+    int64_t timeMs = 0;
+    double seriesNs = measureNsPerOp(ops, [&]
+    {
+        for (int64_t i = 0; i < ops; i++)
+            series.add(values[i & 4095], (timeMs++) / 10);
+    });
+    keepResult(series.session.quantile(0.99f));
+
+    printf("    QuantileSketch::add %.1f ns, MetricSketch::add %.1f ns\n", sketchNs, seriesNs);
+    CHECK(sketchNs < 100);
+    CHECK(seriesNs < 100);
+}
@@ -0,0 +1,130 @@
+#include "test.h"
+#include "../src/recorder.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    vector<string> readLines(const char* path)
+    {
+        vector<string> lines;
+        FILE* file = fopen(path, "r");
+        char line[256];
+        while (file && fgets(line, sizeof(line), file))
+            lines.push_back(string(line, strcspn(line, "\n")));
+        if (file)
+            fclose(file);
+        return lines;
+    }
+
+    // the fields of a record, unquoted
+    vector<string> splitRecord(const string& line)
+    {
+        vector<string> fields(1);
+        bool isQuoted = false;
+        for (size_t i = 0; i < line.size(); i++)
+        {
+            char c = line[i];
+            if (isQuoted && c == '"' && i + 1 < line.size() && line[i + 1] == '"')
+                fields.back() += line[++i];
+            else if (c == '"')
+                isQuoted = !isQuoted;
+            else if (c == ',' && !isQuoted)
+                fields.emplace_back();
+            else
+                fields.back() += c;
+        }
+        return fields;
+    }
+}
+
+TEST(recorderHoldsReleasedHandlesUntilFlushed)
+{
+    const char* path = "test_recorder.csv";
+    CHECK(recorder_setup(path) == 0);
+    auto queue = recorder_add_queue();
+
+    auto old = registerMetric("test", 0, "old", "%");
+    queue->declare(old, getMetricKey(old));
+    queue->push(old, 100, 1);
+    releaseMetric(old);
+
+    // the samples of "old" are still queued, the handle isn't handed out again
+    auto fresh = registerMetric("test", 0, "fresh", "%");
+    CHECK(fresh != old);
+    queue->declare(fresh, getMetricKey(fresh));
+    queue->push(fresh, 200, 2);
+    recorder_update();
+    releaseMetric(fresh);
+
+    // "old" is flushed now, "fresh" is still held until the next flush
+    auto reused = registerMetric("test", 0, "reused", "%");
+    CHECK(reused == old);
+    queue->declare(reused, getMetricKey(reused));
+    queue->push(reused, 300, 3);
+    releaseMetric(reused);
+    recorder_cleanup();
+
+    // every sample follows the declaration of its own series
+    vector<string> names(16);
+    int samples = 0;
+    for (const auto& line : readLines(path))
+    {
+        int id = -1;
+        char name[32];
+        float value;
+        long long timeMs;
+        if (sscanf(line.c_str(), "S,%d,test,0,%31[^,]", &id, name) == 2)
+            names[id] = name;
+        else if (sscanf(line.c_str(), "V,%lld,%d,%g", &timeMs, &id, &value) == 3)
+        {
+            const char* expected[] = { "", "old", "fresh", "reused" };
+            CHECK(names[id] == expected[(int)value]);
+            samples++;
+        }
+    }
+    CHECK(samples == 3);
+    remove(path);
+}
+
+TEST(recorderQuotesNamesWithCommas)
+{
+    const char* path = "test_recorder_names.csv";
+    CHECK(recorder_setup(path) == 0);
+    auto queue = recorder_add_queue();
+
+    // an exe name the way the process timelines use it
+    const string name = "Render, \"Beta\" (1234) SM";
+    auto handle = registerMetric("gpu", 1, name, "%");
+    queue->declare(handle, getMetricKey(handle));
+    queue->push(handle, 100, 42);
+    recorder_cleanup();
+    releaseMetric(handle);
+
+    int declared = 0, samples = 0;
+    for (const auto& line : readLines(path))
+    {
+        auto fields = splitRecord(line);
+        if (fields[0] == "S")
+        {
+            CHECK(fields.size() == 6);
+            CHECK(fields[1] == to_string(handle));
+            CHECK(fields[2] == "gpu" && fields[3] == "1");
+            CHECK(fields[4] == name);
+            CHECK(fields[5] == "%");
+            declared++;
+        }
+        else if (fields[0] == "V")
+        {
+            CHECK(fields.size() == 4);
+            CHECK(fields[2] == to_string(handle) && fields[3] == "42");
+            samples++;
+        }
+    }
+    CHECK(declared == 1 && samples == 1);
+    remove(path);
+}
@@ -0,0 +1,53 @@
+#include "test.h"
+#include "../src/self_profile.h"
+#include <string>
+#include <thread>
+
+using namespace std;
+
+namespace
+{
+    void runNamedThread(const char* name)
+    {
+        thread([name]
+        {
+            setProfileThreadName(name);
+            PROFILE_ZONE("restarted zone");
+        }).join();
+    }
+
+    int countRows(const char* threadName, int64_t* calls)
+    {
+        int rows = 0;
+        *calls = 0;
+        for (const auto& z : getZoneStats())
+        {
+            if (z.thread == threadName && z.zone == "restarted zone")
+            {
+                rows++;
+                *calls += z.calls;
+            }
+        }
+        return rows;
+    }
+}
+
+TEST(profileOfARestartedThreadIsReused)
+{
+    // a worker started again after every restart keeps one ring and one row of stats
+    for (int i = 0; i < 5; i++)
+    {
+        runNamedThread("restarted worker");
+        self_profile_update();
+    }
+    int64_t calls = 0;
+    CHECK(countRows("restarted worker", &calls) == 1);
+    CHECK(calls == 5);
+
+    // a thread of another name gets its own
+    runNamedThread("other worker");
+    self_profile_update();
+    CHECK(countRows("other worker", &calls) == 1);
+    CHECK(calls == 1);
+    CHECK(countRows("restarted worker", &calls) == 1);
+}
@@ -0,0 +1,87 @@
+#include "test.h"
+#include "../src/series_block.h"
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    // appends times with the given delta of delta after a steady 100 ms, reads them back
+    void checkRoundTrip(const vector<int64_t>& dods)
+    {
+        vector<int64_t> times = { 0, 100 };
+        int64_t delta = 100;
+        for (auto dod : dods)
+        {
+            delta += dod;
+            times.push_back(times.back() + delta);
+            // back to steady so the next dod starts from the same place
+            times.push_back(times.back() + delta);
+        }
+
+        SeriesBlock block;
+        for (size_t i = 0; i < times.size(); i++)
+            CHECK(block.append(times[i], float(i) * 0.5f));
+
+        BlockDecoder decoder(block);
+        int64_t t;
+        float v;
+        size_t n = 0;
+        while (decoder.next(&t, &v))
+        {
+            CHECK(n < times.size() && t == times[n]);
+            CHECK(v == float(n) * 0.5f);
+            n++;
+        }
+        CHECK(n == times.size());
+    }
+}
+
+TEST(blockDeltaOfDeltaBucketEdges)
+{
+    // the edges of the 7, 9 and 12 bit buckets and of the 32 bit escape
+    checkRoundTrip({ 63, -64, 64, -65 });
+    checkRoundTrip({ 255, -256, 256, -257 });
+    checkRoundTrip({ 2047, -2048, 2048, -2049 });
+    checkRoundTrip({ 64, 256, 2048, -64, -256, -2048 });
+    checkRoundTrip({ 100000, -100000, 1, -1 });
+}
+
+TEST(blockIrregularTimestamps)
+{
+    // a dod of +64 used to come back as -64 and shift every later time
+    vector<int64_t> times = { 0, 100, 264, 328, 684, 685, 10000, 10100, 10200 };
+    SeriesBlock block;
+    for (auto time : times)
+        block.append(time, 1.0f);
+    BlockDecoder decoder(block);
+    int64_t t;
+    float v;
+    for (auto time : times)
+    {
+        CHECK(decoder.next(&t, &v));
+        CHECK(t == time);
+    }
+    CHECK(!decoder.next(&t, &v));
+}
+
+TEST(historyAcrossSealedBlocks)
+{
+    CompressedHistory history;
+    const int count = 5000;
+    for (int i = 0; i < count; i++)
+        history.append(i * 100 + (i % 7) * 13, float(i % 101));
+    CHECK(!history.sealed.empty());
+    CHECK(history.sampleCount() == count);
+
+    int n = 0;
+    bool isExact = true;
+    history.forEach(0, INT64_MAX, [&](int64_t t, float v)
+    {
+        isExact &= t == n * 100 + (n % 7) * 13 && v == float(n % 101);
+        n++;
+    });
+    CHECK(isExact);
+    CHECK(n == count);
+}
@@ -0,0 +1,58 @@
+#include "test.h"
+#include "../src/simd_reduce.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+using namespace std;
+
+TEST(reduceSpanMatchesScalar)
+{
+    // every tail length of the 4 and 8 wide kernels, and a span longer than a 1024 block
+    vector<float> values(5000);
+    for (size_t i = 0; i < values.size(); i++)
+        values[i] = float((i * 2654435761u) % 1000) * 0.1f - 30;
+    for (size_t count : { 0, 1, 3, 4, 7, 8, 9, 17, 1023, 1024, 1025, 5000 })
+    {
+        auto fast = reduceSpan(values.data(), count);
+        auto scalar = reduceSpanScalar(values.data(), count);
+        CHECK(fast.count == count);
+        CHECK(fast.min == scalar.min && fast.max == scalar.max);
+        CHECK_NEAR(fast.sum, scalar.sum, 1e-6 * (1 + fabs(scalar.sum)) + 0.05);
+        CHECK_NEAR(fast.stddev(), scalar.stddev(), 1e-3);
+    }
+}
+
+TEST(reduceSpanMerge)
+{
+    vector<float> values = { 5, -1, 3, 8, 2, 2, 0, 7, 1 };
+    auto whole = reduceSpan(values.data(), values.size());
+    auto parts = reduceSpan(values.data(), 4);
+    parts.merge(reduceSpan(values.data() + 4, values.size() - 4));
+    CHECK(parts.count == whole.count && parts.min == -1 && parts.max == 8);
+    CHECK_NEAR(parts.mean(), whole.mean(), 1e-6);
+}
+
+BENCH(reduceSpanAgainstScalarOn1MSamples)
+{
+    vector<float> values(1000000);
+    for (size_t i = 0; i < values.size(); i++)
+        values[i] = float((i * 2654435761u) % 1000) * 0.1f - 30;
+    const int passes = 20;
+
+    double fastNs = measureNsPerOp(passes, [&]
+    {
+        for (int i = 0; i < passes; i++)
+            keepResult(reduceSpan(values.data(), values.size()).sum);
+    });
+    double scalarNs = measureNsPerOp(passes, [&]
+    {
+        for (int i = 0; i < passes; i++)
+            keepResult(reduceSpanScalar(values.data(), values.size()).sum);
+    });
+
+    printf("    1M samples: %s %.0f us, scalar %.0f us, %.1fx\n",
+        getReduceKernelName(), fastNs / 1000, scalarNs / 1000, scalarNs / fastNs);
+    if (strcmp(getReduceKernelName(), "scalar") != 0)
+        CHECK(fastNs < scalarNs);
+}
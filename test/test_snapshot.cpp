@@ -0,0 +1,154 @@
+#include "test.h"
+#include "../src/snapshot.h"
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    // every word holds the sequence number, a torn snapshot mixes two of them
+    struct Payload
+    {
+        int64_t seq = -1;
+        vector<int64_t> words;
+    };
+
+    void fill(Payload& payload, int64_t seq)
+    {
+        payload.seq = seq;
+        // the size changes too, a reader looking at a reused buffer would see it
+        payload.words.assign(16 + seq % 48, seq);
+    }
+
+    bool isComplete(const Payload& payload)
+    {
+        if (payload.words.size() != size_t(16 + payload.seq % 48))
+            return false;
+        for (auto word : payload.words)
+        {
+            if (word != payload.seq)
+                return false;
+        }
+        return true;
+    }
+}
+
+TEST(snapshotStressOneWriterOneReader)
+{
+    const int64_t publishCount = 1000000;
+    SnapshotBuffer<Payload> buffer;
+    atomic<bool> isDone(false);
+
+    thread writer([&]
+    {
+        for (int64_t seq = 0; seq < publishCount; seq++)
+        {
+            fill(buffer.writeBuffer(), seq);
+            buffer.publish();
+        }
+        isDone = true;
+    });
+
+    int64_t reads = 0;
+    int64_t torn = 0;
+    int64_t backwards = 0;
+    int64_t last = -1;
+    while (true)
+    {
+        // the last publish is visible once the writer says it is done
+        bool isFinal = isDone;
+        const auto& payload = buffer.read();
+        if (payload.seq >= 0)
+        {
+            torn += !isComplete(payload);
+            backwards += payload.seq < last;
+            last = payload.seq;
+        }
+        reads++;
+        if (isFinal)
+            break;
+    }
+    writer.join();
+
+    CHECK(torn == 0);
+    CHECK(backwards == 0);
+    CHECK(last == publishCount - 1);
+    CHECK(reads > 1);
+}
+
+TEST(snapshotStressFourCollectorsOneRenderer)
+{
+    // the buffer is single producer, every collector thread publishes through a SnapshotBuffer
+    // of its own and the render thread reads all of them, as MetricsInfo does
+    const int kCollectors = 4;
+    const auto kPeriod = chrono::microseconds(100);   // 10 kHz
+    const int64_t publishCount = 5000;
+    SnapshotBuffer<Payload> buffers[kCollectors];
+    atomic<int> running(kCollectors);
+
+    vector<thread> collectors;
+    for (int c = 0; c < kCollectors; c++)
+    {
+        collectors.emplace_back([&, c]
+        {
+            auto next = chrono::steady_clock::now();
+            for (int64_t seq = 0; seq < publishCount; seq++)
+            {
+                fill(buffers[c].writeBuffer(), seq);
+                buffers[c].publish();
+                next += kPeriod;
+                this_thread::sleep_until(next);
+            }
+            running--;
+        });
+    }
+
+    int64_t reads = 0;
+    int64_t torn = 0;
+    int64_t backwards = 0;
+    int64_t last[kCollectors] = { -1, -1, -1, -1 };
+    while (true)
+    {
+        bool isFinal = running == 0;
+        for (int c = 0; c < kCollectors; c++)
+        {
+            const auto& payload = buffers[c].read();
+            if (payload.seq < 0)
+                continue;
+            torn += !isComplete(payload);
+            backwards += payload.seq < last[c];
+            last[c] = payload.seq;
+            reads++;
+        }
+        if (isFinal)
+            break;
+    }
+    for (auto& collector : collectors)
+        collector.join();
+
+    CHECK(torn == 0);
+    CHECK(backwards == 0);
+    for (int c = 0; c < kCollectors; c++)
+        CHECK(last[c] == publishCount - 1);
+    CHECK(reads > kCollectors);
+}
+
+TEST(snapshotReadWithoutPublishKeepsTheLatest)
+{
+    SnapshotBuffer<int> buffer;
+    buffer.writeBuffer() = 1;
+    buffer.publish();
+    CHECK(buffer.read() == 1);
+    CHECK(buffer.read() == 1);
+    buffer.writeBuffer() = 2;
+    buffer.publish();
+    buffer.writeBuffer() = 3;
+    buffer.publish();
+    // the intermediate one is skipped, the reader gets the newest
+    CHECK(buffer.read() == 3);
+    CHECK(buffer.read() == 3);
+}
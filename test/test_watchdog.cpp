@@ -0,0 +1,78 @@
+#include "test.h"
+#include "../src/watchdog.h"
+#include "../src/scheduler.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+using namespace std;
+
+TEST(workerStopDropsAPendingCall)
+{
+    // stop() right after submit() mostly finds the call not started yet
+    int slowStops = 0;
+    int refused = 0;
+    for (int i = 0; i < 50; i++)
+    {
+        SupervisedWorker worker;
+        worker.start("test worker");
+        CHECK(worker.submit("noop", [] {}));
+        auto t0 = chrono::steady_clock::now();
+        refused += !worker.stop(1000);
+        slowStops += chrono::steady_clock::now() - t0 > chrono::milliseconds(500);
+    }
+    CHECK(refused == 0);
+    CHECK(slowStops == 0);
+}
+
+TEST(workerRefusesACallWhileBusy)
+{
+    auto worker = make_shared<SupervisedWorker>();
+    worker->start("test worker");
+    auto isReleased = make_shared<atomic<bool>>(false);
+    CHECK(worker->submit("blocker", [isReleased]
+    {
+        while (!*isReleased)
+            this_thread::sleep_for(chrono::milliseconds(1));
+    }));
+    // refused while the first one runs
+    CHECK(!worker->submit("second", [] {}));
+    CHECK(worker->isBusy());
+
+    *isReleased = true;
+    CHECK(worker->wait(getSchedulerTimeUs() + 1000 * 1000));
+    CHECK(!worker->isBusy());
+    CHECK(worker->stop(1000));
+}
+
+TEST(workerStopLeavesAHungCallBehind)
+{
+    auto isReleased = make_shared<atomic<bool>>(false);
+    auto isDone = make_shared<atomic<bool>>(false);
+    SupervisedWorker worker;
+    worker.start("test worker");
+    CHECK(worker.submit("hung", [isReleased, isDone]
+    {
+        while (!*isReleased)
+            this_thread::sleep_for(chrono::milliseconds(1));
+        *isDone = true;
+    }));
+    this_thread::sleep_for(chrono::milliseconds(20));
+
+    const char* name = nullptr;
+    const char* step = nullptr;
+    int64_t elapsedUs = 0;
+    CHECK(worker.getRunning(&name, &step, &elapsedUs));
+    CHECK(elapsedUs > 0);
+
+    auto t0 = chrono::steady_clock::now();
+    CHECK(!worker.stop(50));
+    CHECK(chrono::steady_clock::now() - t0 < chrono::milliseconds(500));
+
+    // the thread was detached, the call still gets to finish
+    *isReleased = true;
+    for (int i = 0; i < 200 && !*isDone; i++)
+        this_thread::sleep_for(chrono::milliseconds(5));
+    CHECK(*isDone);
+}